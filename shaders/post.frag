@@ -0,0 +1,88 @@
+#version 460 core
+
+// kq_post_effect.
+#define KQ_POST_GRADE     0U
+#define KQ_POST_SCANLINES 1U
+#define KQ_POST_VIGNETTE  2U
+#define KQ_POST_BLUR      3U
+#define KQ_POST_BLOOM     4U
+
+// kq_scale_filter.
+#define KQ_SCALE_NEAREST        0U
+#define KQ_SCALE_SHARP_BILINEAR 1U
+
+#define KQ_POST_STEPS_MAX 7
+
+struct kq_post_step {
+	uint  effect;
+	float params[3];
+};
+
+// Push constants (kq_post_push).
+layout(push_constant) restrict readonly uniform kq_post_push {
+	kq_post_step steps[KQ_POST_STEPS_MAX];
+	uint         count;
+	uint         filter;
+	vec2         src_scale;
+} post;
+
+// The frame as drawn, premultiplied by having been blended over transparent black.
+layout(set = 0, binding = 0) uniform sampler2DArray scene;
+
+// The frame blurred at a fraction of its resolution, for the chain's blurring step.
+layout(set = 1, binding = 0) uniform sampler2DArray blurred;
+
+
+// Inputs.
+layout(location = 0) in vec2 uv; // Across the viewport, which is where the scene goes in the window.
+
+
+// Outputs.
+layout(location = 0) out vec4 out_color;
+
+
+void main(void) {
+	const vec2 scene_size = vec2(textureSize(scene, 0).xy);
+	const vec2 drawn = scene_size * post.src_scale;
+	const vec2 texel = uv * drawn;
+	const vec2 w = min(fwidth(texel), vec2(1.0)); // Scene texels per window pixel.
+
+	vec4 c;
+	if (post.filter == KQ_SCALE_SHARP_BILINEAR) {
+		// Nearest inside each texel, and bilinear over the window pixel at its edges, so texels stay square without
+		// shimmering at scales that are not whole.
+		const vec2 e = fract(texel) - 0.5;
+		const vec2 r = 0.5 - 0.5 * w;
+		const vec2 p = floor(texel) + 0.5 + (e - clamp(e, -r, r)) / w;
+		c = textureLod(scene, vec3(p / scene_size, 0.0), 0.0);
+	} else {
+		c = texelFetch(scene, ivec3(min(ivec2(texel), ivec2(drawn) - 1), 0), 0);
+	}
+
+	// Every step reads only this pixel, or the blur, so the chain runs in order without leaving registers.
+	for (uint i = 0U; i < post.count; ++i) {
+		const float p0 = post.steps[i].params[0];
+		const float p1 = post.steps[i].params[1];
+		const float p2 = post.steps[i].params[2];
+		switch (post.steps[i].effect) {
+		case KQ_POST_GRADE:
+			c.rgb = mix(vec3(dot(c.rgb, vec3(0.2126, 0.7152, 0.0722))), c.rgb, p0);
+			c.rgb = ((c.rgb - 0.5 * c.a) * p1 + 0.5 * c.a) * p2; // Contrast about mid grey, scaled by alpha as the colour is.
+			break;
+		case KQ_POST_SCANLINES:
+			c.rgb *= 1.0 - p0 * step(0.5, fract(texel.y / max(p1, 1.0)));
+			break;
+		case KQ_POST_VIGNETTE:
+			c.rgb *= 1.0 - p0 * smoothstep(p1, p1 + max(p2, 1e-4), length(uv - 0.5) * sqrt(2.0));
+			break;
+		case KQ_POST_BLUR:
+			c = mix(c, textureLod(blurred, vec3(uv * post.src_scale, 0.0), 0.0), p0);
+			break;
+		case KQ_POST_BLOOM:
+			c.rgb += textureLod(blurred, vec3(uv * post.src_scale, 0.0), 0.0).rgb * p0;
+			break;
+		}
+	}
+
+	out_color = clamp(c, 0.0, 1.0);
+}
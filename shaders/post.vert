@@ -0,0 +1,12 @@
+#version 460 core
+
+// Outputs.
+layout(location = 0) out vec2 uv;
+
+
+void main(void) {
+	// One triangle covering the screen, (-1, -1), (3, -1) and (-1, 3), with uv 0 to 1 across the visible part.
+	const vec2 p = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+	gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+	uv = p;
+}
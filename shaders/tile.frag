@@ -1,25 +1,33 @@
 #version 460 core
 
+// kq_tile_instance.flags.
+#define KQ_INSTANCE_GLYPH  (1U << 0)
+#define KQ_INSTANCE_SDF    (1U << 1)
+#define KQ_INSTANCE_TARGET (1U << 2)
+
+// FreeType packs signed distances with the outline at 128.
+#define KQ_SDF_EDGE (128.0 / 255.0)
+
 // Uniforms.
 layout(binding = 0) restrict readonly uniform UniformBufferObject {
 	restrict readonly float time;
 	restrict readonly float time_sin;
 	restrict readonly float time_cos;
+	restrict readonly vec4  camera;
+	restrict readonly vec2  camera_offset;
+	restrict readonly vec2  camera_snap;
 } kq_uniforms;
 
 layout(binding = 1) uniform sampler2DArray tiles_tex;
-
-
-// Push constants.
-layout(push_constant, std430) restrict readonly uniform pc {
-	layout(offset = 0) restrict readonly vec2 position;
-	layout(offset = 8) restrict readonly vec2 scale;
-	layout(offset = 16) restrict readonly float tiles_tex_index;
-};
+layout(binding = 2) uniform sampler2DArray glyph_atlas;
+layout(set = 1, binding = 0) uniform sampler2DArray target_tex;
 
 
 // Inputs.
 layout(location = 0) in vec2 uv;
+layout(location = 1) in vec4 color;
+layout(location = 2) flat in float layer;
+layout(location = 3) flat in uint flags;
 
 
 // Outputs.
@@ -27,5 +35,17 @@ layout(location = 0) out vec4 out_color;
 
 
 void main(void) {
-	out_color = texture(tiles_tex, vec3(uv, tiles_tex_index));
+	if ((flags & KQ_INSTANCE_SDF) != 0U) {
+		// flags is flat, so the whole quad takes this branch and the derivatives are well defined.
+		const float d = texture(glyph_atlas, vec3(uv, layer)).r;
+		const float w = max(fwidth(d) * 0.5, 1e-4); // Half a screen pixel, at whatever scale the glyph is drawn.
+		out_color = vec4(color.rgb, color.a * smoothstep(KQ_SDF_EDGE - w, KQ_SDF_EDGE + w, d));
+	} else if ((flags & KQ_INSTANCE_GLYPH) != 0U) {
+		out_color = vec4(color.rgb, color.a * texture(glyph_atlas, vec3(uv, layer)).r);
+	} else if ((flags & KQ_INSTANCE_TARGET) != 0U) {
+		// Straight alpha blended over transparent black leaves the colour multiplied by alpha; undo it for blending again.
+		const vec4 t = texture(target_tex, vec3(uv, 0.0));
+		out_color = vec4(t.rgb / max(t.a, 1.0 / 255.0), t.a) * color;
+	} else
+		out_color = texture(tiles_tex, vec3(uv, layer)) * color;
 }
@@ -1,31 +1,101 @@
 #version 460 core
 
+// kq_tile_instance.flags.
+#define KQ_INSTANCE_SCREEN     (1U << 3)
+#define KQ_INSTANCE_CLIP_SHIFT 16U
+#define KQ_INSTANCE_CLIP_MASK  (0x3FFFU << KQ_INSTANCE_CLIP_SHIFT)
+
+// kq_anim_mode.
+#define KQ_ANIM_ONCE     1U
+#define KQ_ANIM_PINGPONG 2U
+
+#define KQ_ANIM_CLIPS_MAX 256U
+
 // Uniforms.
 layout(binding = 0) restrict readonly uniform UniformBufferObject {
 	restrict readonly float time;
 	restrict readonly float time_sin;
 	restrict readonly float time_cos;
+	restrict readonly vec4  camera;
+	restrict readonly vec2  camera_offset;
+	restrict readonly vec2  camera_snap;
 } kq_uniforms;
 
-
-// Push constants.
-layout(push_constant, std430) restrict readonly uniform pc {
-	layout(offset = 0) restrict readonly vec2 position;
-	layout(offset = 8) restrict readonly vec2 scale;
-	layout(offset = 16) restrict readonly float tiles_tex_index;
+// Animation clips (kq_anim_clip), in the same buffer past the uniforms.
+struct kq_anim_clip {
+	vec2  uv_step;
+	uint  layer_step;
+	uint  frames;
+	float fps;
+	uint  mode;
 };
+layout(binding = 3) restrict readonly uniform AnimClips {
+	restrict readonly kq_anim_clip clips[KQ_ANIM_CLIPS_MAX];
+} kq_anim;
 
 
 // Inputs.
 layout(location = 0) in vec2 v_position;
 layout(location = 1) in vec2 v_uv;
 
+// Per instance (kq_tile_instance).
+layout(location = 2) in vec2 i_position;
+layout(location = 3) in vec2 i_scale;
+layout(location = 4) in vec4 i_uv_rect;
+layout(location = 5) in vec4 i_color;
+layout(location = 6) in uint i_layer;
+layout(location = 7) in uint i_flags;
+layout(location = 8) in float i_anim_start;
+
 
 // Outputs.
 layout(location = 0) out vec2 uv;
+layout(location = 1) out vec4 color;
+layout(location = 2) flat out float layer;
+layout(location = 3) flat out uint flags;
+
+
+// The frame of the instance's clip showing now, as kqvk_anim_frame() works it out for damage tracking.
+uint anim_frame(const kq_anim_clip clip) {
+	if (clip.frames == 0U)
+		return 0U;
+
+	const uint n = uint(max(kq_uniforms.time - i_anim_start, 0.0) * clip.fps);
+	if (clip.mode == KQ_ANIM_ONCE)
+		return min(n, clip.frames - 1U);
+	if (clip.mode == KQ_ANIM_PINGPONG) {
+		const uint period = clip.frames > 1U ? 2U * clip.frames - 2U : 1U;
+		const uint f = n % period;
+		return f < clip.frames ? f : period - f;
+	}
+	return n % clip.frames;
+}
 
 
 void main(void) {
-	gl_Position = vec4(v_position * scale + position, 0.0, 1.0);
-	uv = v_uv;
+	vec2 centre = i_position;
+	vec2 corner = v_position * i_scale;
+	if ((i_flags & KQ_INSTANCE_SCREEN) == 0U) {
+		const mat2 camera = mat2(kq_uniforms.camera.xy, kq_uniforms.camera.zw);
+		centre = camera * centre + kq_uniforms.camera_offset;
+		corner = camera * corner;
+		if (kq_uniforms.camera_snap.x > 0.0) {
+			const vec2 half_px = 0.5 * kq_uniforms.camera_snap;
+			centre = round((centre + 1.0) * half_px) / half_px - 1.0;
+		}
+	}
+	gl_Position = vec4(corner + centre, 0.0, 1.0);
+	vec4 uv_rect = i_uv_rect;
+	uint tex_layer = i_layer;
+	const uint clip = (i_flags & KQ_INSTANCE_CLIP_MASK) >> KQ_INSTANCE_CLIP_SHIFT;
+	if (clip != 0U && clip <= KQ_ANIM_CLIPS_MAX) {
+		const kq_anim_clip c = kq_anim.clips[clip - 1U];
+		const uint         frame = anim_frame(c);
+		uv_rect += vec4(c.uv_step, c.uv_step) * float(frame);
+		tex_layer += frame * c.layer_step;
+	}
+	uv = mix(uv_rect.xy, uv_rect.zw, v_uv);
+	color = i_color;
+	layer = float(tex_layer); // Texture arrays index with floats, for some ungodly reason.
+	flags = i_flags;
 }
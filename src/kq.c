@@ -1,8 +1,17 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <kq.h>
+#include <kqtxt.h>
 #include <kqvk.h>
+#include <kq_prof.h>
+#include <kq_simd.h>
 
 #include <GLFW/glfw3.h>
 
+#include <hb-ft.h>
+
 #include <libcbase/common.h>
 #include <libcbase/log.h>
 #include <libcbase/vec.h>
@@ -13,6 +22,13 @@
 
 static void kq_callback_glfw_error(int e, const char *desc);
 static void kq_callback_glfw_fb_resize(GLFWwindow *win, int w, int h);
+static void kq_callback_glfw_refresh(GLFWwindow *win);
+static void kq_callback_glfw_focus(GLFWwindow *win, int focused);
+static void kq_callback_glfw_iconify(GLFWwindow *win, int iconified);
+static void kq_callback_glfw_key(GLFWwindow *win, int key, int scancode, int action, int mods);
+static void kq_callback_glfw_mouse_button(GLFWwindow *win, int button, int action, int mods);
+static void kq_callback_glfw_cursor_pos(GLFWwindow *win, double x, double y);
+static void kq_callback_glfw_scroll(GLFWwindow *win, double x, double y);
 
 
 #if KQ_DEBUG
@@ -33,30 +49,62 @@ const kq_vertex quad_vertices[4] = {
 
 
 bool KQinit(kq_data kq[static 1]) {
-	glfwSetErrorCallback(kq_callback_glfw_error);
-
-	// TODO: Don't force this.
-	glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_WAYLAND);
-	if (!glfwInit()) {
-		LOGM_FATAL("GLFW initialization failed.");
-		goto fail_glfwInit;
-	}
-	LOGM_TRACE("GLFW initialized.");
-
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
-	glfwWindowHint(GLFW_DECORATED, GLFW_TRUE);
-	glfwWindowHint(GLFW_FOCUSED, GLFW_TRUE);
-	kq->win = glfwCreateWindow(800, 600, "kq", 0, 0);
-	if (!kq->win) {
-		LOGM_FATAL("GLFW window creation failed.");
-		goto fail_glfwCreateWindow;
+#if KQ_PROFILE
+	kq_prof_init();
+#endif
+	KQ_PROF_FUNC();
+	LOGM_DEBUG("Sprite kernels use %s.", kq_simd_sprites_isa());
+
+	if (kq->headless) {
+		// Nothing is presented: images end the pass ready to be copied out, and no semaphores pair with acquire/present.
+		rend_info.pass_color_attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		rend_info.pass_cinfo.dependencyCount = 2;
+		rend_info.submit_info.waitSemaphoreCount = 0;
+		rend_info.submit_info.signalSemaphoreCount = 0;
+		LOGM_INFO("Running headless.");
+	} else {
+		glfwSetErrorCallback(kq_callback_glfw_error);
+
+		// TODO: Don't force this.
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_WAYLAND);
+		KQ_PROF_BEGIN("glfwInit");
+		const int glfw_ok = glfwInit();
+		KQ_PROF_END();
+		if (!glfw_ok) {
+			LOGM_FATAL("GLFW initialization failed.");
+			goto fail_glfwInit;
+		}
+		LOGM_TRACE("GLFW initialized.");
+
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+		glfwWindowHint(GLFW_DECORATED, GLFW_TRUE);
+		glfwWindowHint(GLFW_FOCUSED, GLFW_TRUE);
+		KQ_PROF_BEGIN("glfwCreateWindow");
+		kq->win = glfwCreateWindow(800, 600, "kq", 0, 0);
+		KQ_PROF_END();
+		if (!kq->win) {
+			LOGM_FATAL("GLFW window creation failed.");
+			goto fail_glfwCreateWindow;
+		}
+		LOGM_TRACE("GLFW window created.");
+
+		glfwSetWindowUserPointer(kq->win, kq);
+		glfwSetFramebufferSizeCallback(kq->win, kq_callback_glfw_fb_resize);
+		glfwSetWindowRefreshCallback(kq->win, kq_callback_glfw_refresh);
+		glfwSetWindowFocusCallback(kq->win, kq_callback_glfw_focus);
+		glfwSetWindowIconifyCallback(kq->win, kq_callback_glfw_iconify);
+		kq->focused = glfwGetWindowAttrib(kq->win, GLFW_FOCUSED);
+		kq->iconified = glfwGetWindowAttrib(kq->win, GLFW_ICONIFIED);
+		glfwSetKeyCallback(kq->win, kq_callback_glfw_key);
+		glfwSetMouseButtonCallback(kq->win, kq_callback_glfw_mouse_button);
+		glfwSetCursorPosCallback(kq->win, kq_callback_glfw_cursor_pos);
+		glfwSetScrollCallback(kq->win, kq_callback_glfw_scroll);
 	}
-	LOGM_TRACE("GLFW window created.");
-
-	glfwSetWindowUserPointer(kq->win, kq);
-	glfwSetFramebufferSizeCallback(kq->win, kq_callback_glfw_fb_resize);
+	kq->redraw = true;
+	kq->background_fps = KQ_BACKGROUND_FPS_DEFAULT;
+	kq->camera = (kq_camera){.zoom = 1.0f};
 
 	kq->vk_ver = kqvk_reload_vulkan(0, 0, 0);
 	if (!kq->vk_ver)
@@ -68,10 +116,13 @@ bool KQinit(kq_data kq[static 1]) {
 		goto fail_add_validation_layers;
 #endif
 
-	if (!kqvk_instance_add_extensions(&rend_info.instance_cinfo))
+	if (!kqvk_instance_add_extensions(&rend_info.instance_cinfo, kq->headless))
 		goto fail_add_instance_extensions;
 
-	if (vkCreateInstance(&rend_info.instance_cinfo, 0, &kq->vk_ins)) {
+	KQ_PROF_BEGIN("vkCreateInstance");
+	const VkResult ins_res = vkCreateInstance(&rend_info.instance_cinfo, 0, &kq->vk_ins);
+	KQ_PROF_END();
+	if (ins_res) {
 		LOGM_FATAL("Creating VkInstance failed.");
 		goto fail_vkCreateInstance;
 	}
@@ -90,12 +141,17 @@ bool KQinit(kq_data kq[static 1]) {
 	LOGM_DEBUG("Created debug messenger.");
 #endif
 
-	if (glfwCreateWindowSurface(kq->vk_ins, kq->win, 0, &kq->vk_surface)) {
-		LOGM_FATAL("Unable to create Vulkan surface.");
-		goto fail_glfwCreateWindowSurface;
+	if (!kq->headless) {
+		KQ_PROF_BEGIN("glfwCreateWindowSurface");
+		const VkResult surface_res = glfwCreateWindowSurface(kq->vk_ins, kq->win, 0, &kq->vk_surface);
+		KQ_PROF_END();
+		if (surface_res) {
+			LOGM_FATAL("Unable to create Vulkan surface.");
+			goto fail_glfwCreateWindowSurface;
+		}
+		rend_info.swapchain_cinfo.surface = kq->vk_surface;
+		LOGM_TRACE("VkSurfaceKHR created.");
 	}
-	rend_info.swapchain_cinfo.surface = kq->vk_surface;
-	LOGM_TRACE("VkSurfaceKHR created.");
 
 	if (!kqvk_choose_pdev(kq))
 		goto fail_choose_pdev;
@@ -109,7 +165,13 @@ bool KQinit(kq_data kq[static 1]) {
 		goto fail_set_up_pdev_queues;
 	LOGM_TRACE("Pysical device queues chosen.");
 
-	if (vkCreateDevice(kq->vk_pdev, &rend_info.ldevice_cinfo, 0, &kq->vk_ldev)) {
+	if (!kqvk_device_add_extensions(kq))
+		goto fail_device_add_extensions;
+
+	KQ_PROF_BEGIN("vkCreateDevice");
+	const VkResult ldev_res = vkCreateDevice(kq->vk_pdev, &rend_info.ldevice_cinfo, 0, &kq->vk_ldev);
+	KQ_PROF_END();
+	if (ldev_res) {
 		LOGM_FATAL("Unable to create VkDevice.");
 		goto fail_vkCreateDevice;
 	}
@@ -124,7 +186,7 @@ bool KQinit(kq_data kq[static 1]) {
 	vkGetDeviceQueue(kq->vk_ldev, kq->q_graphics_index, 0, &kq->q_graphics);
 	vkGetDeviceQueue(kq->vk_ldev, kq->q_present_index, 0, &kq->q_present);
 
-	if (!kqvk_create_swapchain(kq)) {
+	if (!(kq->headless ? kqvk_create_headless_images(kq) : kqvk_create_swapchain(kq))) {
 		LOGM_FATAL("Unable to create swapchain.");
 		goto fail_create_swapchain;
 	}
@@ -152,6 +214,12 @@ bool KQinit(kq_data kq[static 1]) {
 	if (!kqvk_create_cmd_bufs(kq))
 		goto fail_create_cmd_bufs;
 
+	if (!kqvk_create_instance_buffers(kq))
+		goto fail_create_instance_buffers;
+
+	if (!kqvk_create_upload_buffers(kq))
+		goto fail_create_upload_buffers;
+
 	if (!kqvk_create_vertex_buffer(kq))
 		goto fail_create_vertex_buffer;
 
@@ -167,12 +235,26 @@ bool KQinit(kq_data kq[static 1]) {
 	if (!kqvk_create_tiles_tex_sampler(kq))
 		goto fail_create_tiles_tex_sampler;
 
+	if (!kqvk_targets_init(kq))
+		goto fail_targets_init;
+
+	if (!kqvk_post_init(kq))
+		goto fail_post_init;
+
+	if (!kqvk_blur_init(kq))
+		goto fail_blur_init;
+
+	if (!kqtxt_init(kq))
+		goto fail_kqtxt_init;
+
 	if (!kqvk_uniforms_init(kq))
 		goto fail_uniforms_init;
 
 	if (!kqvk_create_sync_primitives(kq))
 		goto fail_create_sync_primitives;
 
+	kqvk_create_timestamp_pool(kq);
+
 	LOGM_INFO("Initialized.");
 	return true;
 
@@ -184,6 +266,14 @@ fail_create_sync_primitives:
 		vkFreeMemory(kq->vk_ldev, kq->uniform_bufs_mem[i], 0);
 	}
 fail_uniforms_init:
+	kqtxt_stop(kq);
+fail_kqtxt_init:
+	kqvk_blur_stop(kq);
+fail_blur_init:
+	kqvk_post_stop(kq);
+fail_post_init:
+	kqvk_targets_stop(kq);
+fail_targets_init:
 	vkDestroySampler(kq->vk_ldev, kq->tiles_tex_sampler, 0);
 fail_create_tiles_tex_sampler:
 	vkDestroyImageView(kq->vk_ldev, kq->tiles_tex_view, 0);
@@ -197,16 +287,21 @@ fail_create_index_buffer:
 	vkDestroyBuffer(kq->vk_ldev, kq->vertex_buf, 0);
 	vkFreeMemory(kq->vk_ldev, kq->vertex_buf_mem, 0);
 fail_create_vertex_buffer:
+	kqvk_destroy_upload_buffers(kq);
+fail_create_upload_buffers:
+	kqvk_destroy_instance_buffers(kq);
+fail_create_instance_buffers:
 fail_create_cmd_bufs:
 	vkDestroyCommandPool(kq->vk_ldev, kq->cmd_pool, 0);
 fail_create_cmd_pool:
-	for (u32 i = 0U; i < kq->swapchain_img_count; ++i)
+	for (u32 i = 0U; kq->fbos && i < kq->swapchain_img_count; ++i)
 		vkDestroyFramebuffer(kq->vk_ldev, kq->fbos[i], 0);
 	free(kq->fbos);
 fail_create_framebuffers:
 	vkDestroyPipeline(kq->vk_ldev, kq->graphics_pipeline, 0);
 	vkDestroyPipelineLayout(kq->vk_ldev, kq->pipeline_layout, 0);
 fail_create_pipeline:
+	vkDestroyDescriptorSetLayout(kq->vk_ldev, kq->target_set_layout, 0);
 	vkDestroyDescriptorSetLayout(kq->vk_ldev, kq->descriptor_set_layout, 0);
 fail_create_descriptor_set_layout:
 	vkDestroyRenderPass(kq->vk_ldev, kq->render_pass, 0);
@@ -216,6 +311,8 @@ fail_create_render_pass:
 fail_init_shaders:
 	for (u32 i = 0U; i < kq->swapchain_img_count; ++i)
 		vkDestroyImageView(kq->vk_ldev, kq->swapchain_img_views[i], 0);
+	if (kq->headless)
+		kqvk_destroy_headless_images(kq, kq->swapchain_img_count);
 	free(kq->swapchain_img_views);
 	free(kq->swapchain_imgs);
 	vkDestroySwapchainKHR(kq->vk_ldev, kq->vk_swapchain, 0);
@@ -223,6 +320,8 @@ fail_create_swapchain:
 fail_glad_load_1_1_1:
 	vkDestroyDevice(kq->vk_ldev, 0);
 fail_vkCreateDevice:
+	vecstr_destroy(kqvk_device_exts_vec);
+fail_device_add_extensions:
 fail_set_up_pdev_queues:
 fail_glad_load_1_1_0:
 fail_choose_pdev:
@@ -244,9 +343,11 @@ fail_add_validation_layers:
 #endif
 	gladLoaderUnloadVulkan();
 fail_glad_load_0_0_0:
-	glfwDestroyWindow(kq->win);
+	if (!kq->headless)
+		glfwDestroyWindow(kq->win);
 fail_glfwCreateWindow:
-	glfwTerminate();
+	if (!kq->headless)
+		glfwTerminate();
 fail_glfwInit:
 	return false;
 }
@@ -255,6 +356,7 @@ void KQstop(kq_data kq[static 1]) {
 	LOGM_INFO("Stopping.");
 	vkDeviceWaitIdle(kq->vk_ldev);
 
+	vkDestroyQueryPool(kq->vk_ldev, kq->timestamp_pool, 0);
 	for (size_t i = 0; i < KQ_FRAMES_IN_FLIGHT; ++i) {
 		vkDestroySemaphore(kq->vk_ldev, kq->render_finished_semaphore[i], 0);
 		vkDestroySemaphore(kq->vk_ldev, kq->img_available_semaphore[i], 0);
@@ -266,6 +368,12 @@ void KQstop(kq_data kq[static 1]) {
 		vkDestroyBuffer(kq->vk_ldev, kq->uniform_bufs[i], 0);
 		vkFreeMemory(kq->vk_ldev, kq->uniform_bufs_mem[i], 0);
 	}
+	kqtxt_stop(kq);
+	kqvk_blur_stop(kq);
+	if (kq->post_scene.image)
+		KQtarget_destroy(kq, &kq->post_scene);
+	kqvk_post_stop(kq);
+	kqvk_targets_stop(kq);
 	vkDestroySampler(kq->vk_ldev, kq->tiles_tex_sampler, 0);
 	vkDestroyImageView(kq->vk_ldev, kq->tiles_tex_view, 0);
 	vkDestroyImage(kq->vk_ldev, kq->tiles_tex_image, 0);
@@ -274,22 +382,28 @@ void KQstop(kq_data kq[static 1]) {
 	vkFreeMemory(kq->vk_ldev, kq->index_buf_mem, 0);
 	vkDestroyBuffer(kq->vk_ldev, kq->vertex_buf, 0);
 	vkFreeMemory(kq->vk_ldev, kq->vertex_buf_mem, 0);
+	kqvk_destroy_upload_buffers(kq);
+	kqvk_destroy_instance_buffers(kq);
 	vkDestroyCommandPool(kq->vk_ldev, kq->cmd_pool, 0);
-	for (u32 i = 0U; i < kq->swapchain_img_count; ++i)
+	for (u32 i = 0U; kq->fbos && i < kq->swapchain_img_count; ++i)
 		vkDestroyFramebuffer(kq->vk_ldev, kq->fbos[i], 0);
 	free(kq->fbos);
 	vkDestroyPipeline(kq->vk_ldev, kq->graphics_pipeline, 0);
 	vkDestroyPipelineLayout(kq->vk_ldev, kq->pipeline_layout, 0);
+	vkDestroyDescriptorSetLayout(kq->vk_ldev, kq->target_set_layout, 0);
 	vkDestroyDescriptorSetLayout(kq->vk_ldev, kq->descriptor_set_layout, 0);
 	vkDestroyRenderPass(kq->vk_ldev, kq->render_pass, 0);
 	vkDestroyShaderModule(kq->vk_ldev, kq->tiles_frag_module, 0);
 	vkDestroyShaderModule(kq->vk_ldev, kq->tiles_vert_module, 0);
 	for (u32 i = 0U; i < kq->swapchain_img_count; ++i)
 		vkDestroyImageView(kq->vk_ldev, kq->swapchain_img_views[i], 0);
+	if (kq->headless)
+		kqvk_destroy_headless_images(kq, kq->swapchain_img_count);
 	free(kq->swapchain_img_views);
 	free(kq->swapchain_imgs);
 	vkDestroySwapchainKHR(kq->vk_ldev, kq->vk_swapchain, 0);
 	vkDestroyDevice(kq->vk_ldev, 0);
+	vecstr_destroy(kqvk_device_exts_vec);
 	vkDestroySurfaceKHR(kq->vk_ins, kq->vk_surface, 0);
 #if KQ_DEBUG
 	vkDestroyDebugUtilsMessengerEXT(kq->vk_ins, kq->dbg_messenger, 0);
@@ -301,16 +415,283 @@ void KQstop(kq_data kq[static 1]) {
 #endif
 	gladUninstallVulkanDebug();
 	gladLoaderUnloadVulkan();
-	glfwDestroyWindow(kq->win);
-	glfwTerminate();
+	if (!kq->headless) {
+		glfwDestroyWindow(kq->win);
+		glfwTerminate();
+	}
+
+#if KQ_PROFILE
+	const char *trace_path = getenv("KQ_PROFILE_OUT");
+	kq_prof_export_chrome(trace_path ? trace_path : KQ_PROF_DEFAULT_PATH);
+	kq_prof_shutdown();
+#endif
+}
+
+// Writes timestamp i of the current frame's KQ_GPU_TIMESTAMPS, if the GPU is being timed.
+static void kq_timestamp(kq_data kq[static 1], u32 i, VkPipelineStageFlagBits stage) {
+	if (kq->timestamp_pool)
+		vkCmdWriteTimestamp(kq->cmd_buf[kq->current_frame], stage, kq->timestamp_pool, (u32)(KQ_GPU_TIMESTAMPS * kq->current_frame) + i);
+}
+
+// Moves the internal resolution's scale towards the GPU frame time budget, on each GPU time measured since it last moved.
+// Fill cost goes with the pixel count, so the scale moves by the square root of how far off the GPU was, aiming a little
+// under budget; it only moves outside of a band around it, so it settles instead of hunting.
+static void kq_internal_res_control(kq_data kq[static 1]) {
+	if (!kq->internal_budget_ns || !kq->stats.gpu_frame_ns || kq->stats.gpu_frame <= kq->internal_changed)
+		return;
+
+	const double load = (double)kq->stats.gpu_frame_ns / (double)kq->internal_budget_ns;
+	if (load <= 1.0 && (load >= 0.7 || kq->internal_scale >= 1.0f))
+		return;
+
+	float scale = kq->internal_scale * (float)sqrt(0.85 / load);
+	scale = floorf(scale * 64.0f + 0.5f) / 64.0f; // In steps, so sub-pixel changes don't count as moving.
+	scale = scale < kq->internal_scale_min ? kq->internal_scale_min : scale > 1.0f ? 1.0f : scale;
+	if (scale != kq->internal_scale) {
+		kq->internal_scale = scale;
+		kq->internal_changed = kq->stats.frames;
+	}
+}
+
+// Where the scene's base_w x base_h pixels go in a window of window_w x window_h: whole multiples centred for nearest,
+// filling it at the same aspect ratio otherwise, or if not even one multiple fits.
+static VkViewport kq_internal_dst(u32 base_w, u32 base_h, float window_w, float window_h, u32 filter) {
+	float k = fminf(window_w / (float)base_w, window_h / (float)base_h);
+	if (filter == KQ_SCALE_NEAREST && k >= 1.0f)
+		k = floorf(k);
+	const float w = floorf((float)base_w * k + 0.5f);
+	const float h = floorf((float)base_h * k + 0.5f);
+	return (VkViewport){
+		.x = floorf((window_w - w) * 0.5f),
+		.y = floorf((window_h - h) * 0.5f),
+		.width = w,
+		.height = h,
+		.maxDepth = 1.0f,
+	};
+}
+
+// Latches the post chain and damage tracking for the frame, and gives them a scene image the size of the swapchain's,
+// or of the internal resolution, and the blur it needs, or frees them when both are off.
+static bool kq_post_latch(kq_data kq[static 1]) {
+	kq->post_push = kq->post_chain;
+	kq->post_blur_step = KQ_POST_STEPS_MAX;
+	for (u32 i = 0U; i < kq->post_push.count; ++i) {
+		if (kq->post_push.steps[i].effect == KQ_POST_BLUR || kq->post_push.steps[i].effect == KQ_POST_BLOOM)
+			kq->post_blur_step = i;
+	}
+
+	const bool damage_was_on = kq->damage_on;
+	kq->damage_on = kq->damage_tracking;
+	kq->internal_on = kq->internal_base.width || kq->internal_budget_ns;
+	kq->post_on = kq->post_push.count || kq->internal_on || kq->damage_on;
+	const VkExtent2D extent = kq->internal_base.width ? kq->internal_base : kq->scissor.extent;
+
+	// The part drawn keeps at least a pixel, and the nearest whole pixel to the scale.
+	const float      scale = kq->internal_budget_ns ? kq->internal_scale : 1.0f;
+	const VkExtent2D drawn = {
+		.width = (u32)fmaxf(floorf((float)extent.width * scale + 0.5f), 1.0f),
+		.height = (u32)fmaxf(floorf((float)extent.height * scale + 0.5f), 1.0f),
+	};
+	kq->internal_viewport = (VkViewport){.width = (float)drawn.width, .height = (float)drawn.height, .maxDepth = 1.0f};
+	kq->internal_scissor = (VkRect2D){.extent = drawn};
+	kq->internal_dst = kq_internal_dst(extent.width, extent.height, kq->viewport.width, kq->viewport.height, kq->internal_filter);
+	kq->post_push.filter = kq->internal_on ? kq->internal_filter : KQ_SCALE_NEAREST;
+	kq->post_push.src_scale[0] = (float)drawn.width / (float)extent.width;
+	kq->post_push.src_scale[1] = (float)drawn.height / (float)extent.height;
+	kq->stats.scene_width = drawn.width;
+	kq->stats.scene_height = drawn.height;
+	kq->stats.damage_px = 0;
+
+	// Each step changes every pixel it touches, and a blur spreads the scene's damage further than is worth tracking.
+	kq->damage_window |= kq->post_blur_step < KQ_POST_STEPS_MAX || memcmp(&kq->post_push, &kq->damage_post_last, sizeof kq->post_push);
+	kq->damage_post_last = kq->post_push;
+
+	bool fresh = !damage_was_on;
+	if (kq->post_scene.image && (!kq->post_on || kq->post_scene.width != extent.width || kq->post_scene.height != extent.height)) {
+		kqvk_blur_fit(kq, false);
+		KQtarget_destroy(kq, &kq->post_scene);
+	}
+	if (kq->post_on && !kq->post_scene.image) {
+		if (!KQtarget_create(kq, &kq->post_scene, extent.width, extent.height)) {
+			LOGM_ERROR("Unable to create the post chain's scene image.");
+			return false;
+		}
+		fresh = true;
+	}
+	return kqvk_damage_begin(kq, fresh) && kqvk_blur_fit(kq, kq->post_blur_step < KQ_POST_STEPS_MAX);
+}
+
+// Points the present regions at the parts of the window the frame changed, if it is worth telling the presentation
+// engine about them: they are the scene's damage, through the internal resolution's scaling.
+static bool kq_damage_present(kq_data kq[static 1]) {
+	const bool whole = kq->damage_window || kq->damage_full;
+	kq->damage_window = false;
+	if (!kq->damage_on || !kq->has_incremental_present || whole)
+		return false;
+
+	const VkViewport dst = kq->internal_on ? kq->internal_dst : kq->viewport;
+	const float      kx = dst.width / (float)kq->damage_extent.width;
+	const float      ky = dst.height / (float)kq->damage_extent.height;
+	const float      w = (float)kq->scissor.extent.width;
+	const float      h = (float)kq->scissor.extent.height;
+	for (u32 i = 0U; i < kq->damage_rects_count; ++i) {
+		// A pixel more around them, as scaling up blends in the texels next to them.
+		const VkRect2D r = kq->damage_rects[i];
+		const float    x0 = fmaxf(floorf(dst.x + (float)r.offset.x * kx) - 1.0f, 0.0f);
+		const float    y0 = fmaxf(floorf(dst.y + (float)r.offset.y * ky) - 1.0f, 0.0f);
+		const float    x1 = fminf(ceilf(dst.x + (float)(r.offset.x + (s32)r.extent.width) * kx) + 1.0f, w);
+		const float    y1 = fminf(ceilf(dst.y + (float)(r.offset.y + (s32)r.extent.height) * ky) + 1.0f, h);
+		kq->damage_present[i] = (VkRectLayerKHR){.offset = {(s32)x0, (s32)y0}, .extent = {(u32)(x1 - x0), (u32)(y1 - y0)}};
+	}
+
+	// No rectangles would mean all of the image changed.
+	rend_info.present_region.rectangleCount = kq->damage_rects_count ? kq->damage_rects_count : 1U;
+	if (!kq->damage_rects_count)
+		kq->damage_present[0] = (VkRectLayerKHR){.extent = {1U, 1U}};
+	rend_info.present_region.pRectangles = kq->damage_present;
+	return true;
+}
+
+// Holds the next frame back while the window is iconified, and to background_fps since the last one began while it is
+// unfocused, handling events meanwhile. Stops holding it once the window should close.
+static void kq_throttle(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
+	while (!kq->headless && !glfwWindowShouldClose(kq->win)) {
+		if (kq->iconified || (!kq->focused && kq->background_fps == 0.0f)) {
+			glfwWaitEvents();
+			continue;
+		}
+		if (kq->focused || kq->background_fps < 0.0f)
+			return;
+
+		const u64 due_ns = kq->frame_begin_ns + (u64)(1e9 / (double)kq->background_fps);
+		const u64 now_ns = kqvk_now_ns();
+		if (now_ns >= due_ns)
+			return;
+		glfwWaitEventsTimeout((double)(due_ns - now_ns) * 1e-9);
+	}
+}
+
+// Holds the next frame back until just in time for the display's next refresh, with pacing on. With present wait, that is
+// one refresh after the last present was shown, less the time recent frames took and KQ_PACE_MARGIN_NS; without, frames
+// are held to pacing_fps, or to refresh_ns.
+static void kq_pace(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
+	if (!kq->pacing || kq->headless)
+		return;
+
+	const u64 work_ns = kq->stats.cpu_frame_ns - kq->stats.cpu_wait_ns + kq->stats.gpu_frame_ns;
+	kq->pace_work_ns = kq->pace_work_ns ? (kq->pace_work_ns * 7U + work_ns) / 8U : work_ns;
+
+	if (kq->has_present_wait && kq->present_id) {
+		KQ_PROF_BEGIN("vkWaitForPresentKHR");
+		const VkResult wait_res = vkWaitForPresentKHR(kq->vk_ldev, kq->vk_swapchain, kq->present_id, KQ_PACE_WAIT_TIMEOUT_NS);
+		KQ_PROF_END();
+		if (wait_res != VK_SUCCESS) {
+			kq->present_shown_ns = 0;
+			return;
+		}
+
+		// Back-to-back presents are shown a refresh apart; longer gaps are missed refreshes, shorter ones noise.
+		const u64 now_ns = kqvk_now_ns();
+		if (kq->present_shown_ns) {
+			const u64 interval_ns = now_ns - kq->present_shown_ns;
+			if (!kq->refresh_ns)
+				kq->refresh_ns = interval_ns;
+			else if (interval_ns * 2U > kq->refresh_ns && interval_ns * 2U < kq->refresh_ns * 3U)
+				kq->refresh_ns = (kq->refresh_ns * 7U + interval_ns) / 8U;
+		}
+		kq->present_shown_ns = now_ns;
+
+		const u64 due_ns = now_ns + kq->refresh_ns;
+		if (due_ns > now_ns + kq->pace_work_ns + KQ_PACE_MARGIN_NS)
+			kqvk_sleep_until_ns(due_ns - kq->pace_work_ns - KQ_PACE_MARGIN_NS);
+		return;
+	}
+
+	const u64 interval_ns = kq->pacing_fps > 0.0f ? (u64)(1e9 / (double)kq->pacing_fps) : kq->refresh_ns;
+	if (!interval_ns)
+		return;
+	const u64 now_ns = kqvk_now_ns();
+	if (now_ns > kq->pace_next_ns + interval_ns) // Fell behind; start over rather than rush to catch up.
+		kq->pace_next_ns = now_ns;
+	kqvk_sleep_until_ns(kq->pace_next_ns);
+	kq->pace_next_ns += interval_ns;
+}
+
+// Completes the records of presented frames whose display times have come back.
+static void kq_latency_collect(kq_data kq[static 1]) {
+	if (!kq->has_display_timing)
+		return;
+
+	VkPastPresentationTimingGOOGLE timings[KQ_LATENCY_PENDING];
+	VkResult                       res;
+	do {
+		u32 count = KQ_LATENCY_PENDING;
+		res = vkGetPastPresentationTimingGOOGLE(kq->vk_ldev, kq->vk_swapchain, &count, timings);
+		if (res != VK_SUCCESS && res != VK_INCOMPLETE)
+			return;
+		for (u32 i = 0; i < count; ++i) {
+			kq_latency *l = &kq->latency_pending[timings[i].presentID % KQ_LATENCY_PENDING];
+			if ((u32)l->frame != timings[i].presentID || l->display_ns)
+				continue;
+			l->display_ns = timings[i].actualPresentTime;
+			if (l->frame > kq->stats.latency.frame)
+				kq->stats.latency = *l;
+		}
+	} while (res == VK_INCOMPLETE);
 }
 
 bool KQrender_begin(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	if (kq->rendering)
 		return false;
 
+	// Input delivered up to here is this frame's to act on.
+	kq->latency_cur = (kq_latency){.frame = kq->stats.frames + 1U, .input_ns = kq->input_ns, .begin_ns = kqvk_now_ns()};
+	kq->input_ns = 0;
+
+	kq_throttle(kq);
+	kq_pace(kq);
+	kq->frame_begin_ns = kqvk_now_ns();
+
 	// Wait for previous frame (of the same index) to finish.
+	KQ_PROF_BEGIN("vkWaitForFences");
 	vkWaitForFences(kq->vk_ldev, 1, &kq->in_flight_fence[kq->current_frame], VK_TRUE, UINT64_MAX);
+	KQ_PROF_END();
+	kq->stats.cpu_wait_ns = kqvk_now_ns() - kq->frame_begin_ns;
+	kq_latency_collect(kq);
+
+	// The fence covers the timestamps this slot wrote last time around, so they can be read without waiting.
+	if (kq->timestamp_pool && kq->timestamp_frame[kq->current_frame]) {
+		u64 ts[KQ_GPU_TIMESTAMPS];
+		if (vkGetQueryPoolResults(kq->vk_ldev,
+		                          kq->timestamp_pool,
+		                          (u32)(KQ_GPU_TIMESTAMPS * kq->current_frame),
+		                          KQ_GPU_TIMESTAMPS,
+		                          sizeof ts,
+		                          ts,
+		                          sizeof ts[0],
+		                          VK_QUERY_RESULT_64_BIT)
+		    == VK_SUCCESS) {
+			kq->stats.gpu_frame_ns = (u64)((double)((ts[KQ_GPU_TIMESTAMPS - 1] - ts[0]) & kq->timestamp_mask) * kq->timestamp_period);
+			for (size_t p = 0; p < KQ_GPU_PASSES; ++p)
+				kq->stats.gpu_pass_ns[p] = (u64)((double)((ts[p + 1] - ts[p]) & kq->timestamp_mask) * kq->timestamp_period);
+			kq->stats.gpu_frame = kq->timestamp_frame[kq->current_frame];
+		}
+	}
+	kq_internal_res_control(kq);
+	kq->stats.draw_calls = 0;
+	kq->stats.quads = 0;
+	kq->stats.glyph_uploads = 0;
+	kq->stats.shape_hits = 0;
+	kq->stats.shape_misses = 0;
+	kq->stats.text_lines = 0;
+	kq->stats.atlas_repacks = 0;
+	kq->atlas_repacked = false;
+
+	if (kq->atlas_grow_pending && !kqtxt_atlas_grow(kq))
+		LOGM_WARN("Unable to grow the glyph atlas; new glyphs will be dropped.");
 
 	if (kq->fb_resized) {
 		if (!kqvk_swapchain_recreate(kq))
@@ -318,72 +699,187 @@ bool KQrender_begin(kq_data kq[static 1]) {
 		kq->fb_resized = false;
 	}
 
-retry_acquire:
-	switch (vkAcquireNextImageKHR(kq->vk_ldev, kq->vk_swapchain, UINT64_MAX, kq->img_available_semaphore[kq->current_frame], 0, &kq->img_index)) {
-	case VK_ERROR_OUT_OF_DATE_KHR:
-		if (!kqvk_swapchain_recreate(kq))
+	if (kq->headless) {
+		// Each frame in flight owns one offscreen image, which is free again once its fence has signalled.
+		kq->img_index = (u32)kq->current_frame;
+	} else {
+	retry_acquire:
+		KQ_PROF_BEGIN("vkAcquireNextImageKHR");
+		const VkResult acquire_res =
+			vkAcquireNextImageKHR(kq->vk_ldev, kq->vk_swapchain, UINT64_MAX, kq->img_available_semaphore[kq->current_frame], 0, &kq->img_index);
+		KQ_PROF_END();
+		switch (acquire_res) {
+		case VK_ERROR_OUT_OF_DATE_KHR:
+			if (!kqvk_swapchain_recreate(kq))
+				return false;
+			goto retry_acquire;
+		case VK_SUBOPTIMAL_KHR:
+		case VK_SUCCESS:
+			break;
+		default:
 			return false;
-		goto retry_acquire;
-	case VK_SUBOPTIMAL_KHR:
-	case VK_SUCCESS:
-		break;
-	default:
-		return false;
+		}
+		kq->latency_cur.acquire_ns = kqvk_now_ns();
 	}
 
+	kq->anim_time = kq->headless ? kq->headless_time : glfwGetTime();
+	if (!kq_post_latch(kq))
+		return false;
+	kqvk_uniforms_camera(kq);
+
 	vkResetFences(kq->vk_ldev, 1, &kq->in_flight_fence[kq->current_frame]);
 	vkResetCommandBuffer(kq->cmd_buf[kq->current_frame], 0);
-	rend_info.submit_info.pCommandBuffers = &kq->cmd_buf[kq->current_frame];
+	kq->instance_chunk = 0;
+	kq->instance_count = 0;
+	kq->batch_first = 0;
+	kq->upload_used = 0;
+	kq->targets_recorded = false;
+	kq->target_active = 0;
 
 	rend_info.submit_info.pWaitSemaphores = &kq->img_available_semaphore[kq->current_frame];
 	rend_info.submit_info.pSignalSemaphores = &kq->render_finished_semaphore[kq->current_frame];
-	rend_info.pass_begin_info.framebuffer = kq->fbos[kq->img_index];
-
-	kqvk_uniforms_update_time(kq);
-	kqvk_uniforms_push(kq);
 
 	if (vkBeginCommandBuffer(kq->cmd_buf[kq->current_frame], &rend_info.cmd_buf_begin_info))
 		return false;
 
-	vkCmdBeginRenderPass(kq->cmd_buf[kq->current_frame], &rend_info.pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-
-	vkCmdBindPipeline(kq->cmd_buf[kq->current_frame], VK_PIPELINE_BIND_POINT_GRAPHICS, kq->graphics_pipeline);
-	vkCmdSetViewport(kq->cmd_buf[kq->current_frame], 0, 1, &kq->viewport);
-	vkCmdSetScissor(kq->cmd_buf[kq->current_frame], 0, 1, &kq->scissor);
-
-	VkDeviceSize vertex_buf_offset = 0;
-	vkCmdBindVertexBuffers(kq->cmd_buf[kq->current_frame], 0, 1, &kq->vertex_buf, &vertex_buf_offset);
-	vkCmdBindIndexBuffer(kq->cmd_buf[kq->current_frame], kq->index_buf, 0, VK_INDEX_TYPE_UINT16);
-	vkCmdBindDescriptorSets(kq->cmd_buf[kq->current_frame],
-	                        VK_PIPELINE_BIND_POINT_GRAPHICS,
-	                        kq->pipeline_layout,
-	                        0,
-	                        1,
-	                        &kq->desc_sets[kq->current_frame],
-	                        0,
-	                        0);
-
+	if (kq->timestamp_pool)
+		vkCmdResetQueryPool(kq->cmd_buf[kq->current_frame], kq->timestamp_pool, (u32)(KQ_GPU_TIMESTAMPS * kq->current_frame), KQ_GPU_TIMESTAMPS);
+	kq_timestamp(kq, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+	// Under damage tracking, the scene's pass is recorded at KQrender_end(), once its damage is known.
+	if (!kq->damage_on)
+		kqvk_pass_begin(kq, kq->cmd_buf[kq->current_frame], kq->post_on ? &kq->post_scene : 0, false);
+	// Laid out at the internal resolution; only the viewport the scene is drawn with is scaled.
+	if (kq->internal_on) {
+		kq->window_viewport = kq->viewport;
+		kq->window_scissor = kq->scissor;
+		kq->viewport = (VkViewport){.width = (float)kq->post_scene.width, .height = (float)kq->post_scene.height, .maxDepth = 1.0f};
+		kq->scissor = (VkRect2D){.extent = {.width = kq->post_scene.width, .height = kq->post_scene.height}};
+	}
+	kq->draw_cmd_buf = kq->cmd_buf[kq->current_frame];
+	if (kq->damage_on)
+		kq->target_set_bound = kq->target_default_set;
+	else
+		kqvk_pass_bind(kq, kq->draw_cmd_buf);
 
 	kq->rendering = true;
 	return true;
 }
 
 bool KQrender_end(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	if (!kq->rendering)
 		return false;
 
-	vkCmdEndRenderPass(kq->cmd_buf[kq->current_frame]);
+	if (kq->target_active) {
+		LOGM_WARN("Render target still active at the end of the frame; ending it.");
+		KQtarget_end(kq);
+	}
+
+	kqvk_batch_flush(kq);
+	if (kq->damage_on) {
+		kqvk_damage_end(kq);
+		kqvk_scene_record(kq, kq->cmd_buf[kq->current_frame]);
+	} else {
+		kqvk_pass_end(kq, kq->cmd_buf[kq->current_frame], kq->post_on ? &kq->post_scene : 0);
+	}
+	kq_timestamp(kq, 1 + KQ_GPU_PASS_SCENE, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+	if (kq->internal_on) {
+		kq->viewport = kq->window_viewport;
+		kq->scissor = kq->window_scissor;
+	}
+
+	if (kq->post_blur_step < KQ_POST_STEPS_MAX)
+		kqvk_blur_record(kq, kq->cmd_buf[kq->current_frame], &kq->post_push.steps[kq->post_blur_step]);
+	kq_timestamp(kq, 1 + KQ_GPU_PASS_BLUR, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+	if (kq->post_on)
+		kqvk_post_record(kq, kq->cmd_buf[kq->current_frame]);
+	kq_timestamp(kq, 1 + KQ_GPU_PASS_POST, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+	if (kq->headless) {
+		const VkBufferImageCopy region = {
+			.imageSubresource = (VkImageSubresourceLayers){.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1},
+			.imageExtent = (VkExtent3D){.width = kq->headless_extent.width, .height = kq->headless_extent.height, .depth = 1},
+		};
+		vkCmdCopyImageToBuffer(kq->cmd_buf[kq->current_frame],
+		                       kq->swapchain_imgs[kq->img_index],
+		                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		                       kq->readback_bufs[kq->current_frame],
+		                       1,
+		                       &region);
+
+		const VkMemoryBarrier to_host = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+		};
+		vkCmdPipelineBarrier(kq->cmd_buf[kq->current_frame], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &to_host, 0, 0, 0, 0);
+	}
+
+	kq_timestamp(kq, KQ_GPU_TIMESTAMPS - 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
 
 	if (vkEndCommandBuffer(kq->cmd_buf[kq->current_frame]))
 		return false;
 
-	if (vkQueueSubmit(kq->q_graphics, 1, &rend_info.submit_info, kq->in_flight_fence[kq->current_frame]))
+	if (!kqvk_uploads_end(kq))
+		return false;
+
+	// Uniforms are latched as late as they can be; the buffer is coherent, so the submit makes the writes visible.
+	kqvk_uniforms_update_time(kq);
+	if (kq->uniforms_latch) {
+		// The grids culled and the damage was worked out under the camera as it was drawn with, so it stays as it was.
+		const kq_uniforms drawn = kq->uniforms;
+		kq->uniforms_latch(&kq->uniforms, kq->uniforms_latch_user);
+#if KQ_DEBUG
+		if (memcmp(drawn.camera, kq->uniforms.camera, sizeof drawn.camera) ||
+		    memcmp(drawn.camera_offset, kq->uniforms.camera_offset, sizeof drawn.camera_offset) ||
+		    memcmp(drawn.camera_snap, kq->uniforms.camera_snap, sizeof drawn.camera_snap))
+			LOGM_ERROR("The uniforms latch moved the camera; set it with KQcamera_set() before drawing instead.");
+#endif
+		memcpy(kq->uniforms.camera, drawn.camera, sizeof drawn.camera);
+		memcpy(kq->uniforms.camera_offset, drawn.camera_offset, sizeof drawn.camera_offset);
+		memcpy(kq->uniforms.camera_snap, drawn.camera_snap, sizeof drawn.camera_snap);
+	}
+	kqvk_uniforms_push(kq);
+
+	KQ_PROF_BEGIN("vkQueueSubmit");
+	const VkResult submit_res = vkQueueSubmit(kq->q_graphics, 1, &rend_info.submit_info, kq->in_flight_fence[kq->current_frame]);
+	KQ_PROF_END();
+	if (submit_res)
 		return false;
+	kq->timestamp_frame[kq->current_frame] = ++kq->stats.frames;
+	kq->latency_cur.submit_ns = kqvk_now_ns();
+
+	if (kq->headless) {
+		kq->stats.latency = kq->latency_cur;
+		kq->readback_frame = kq->current_frame;
+		kq->readback_ready = true;
+		kq->current_frame = (kq->current_frame + 1) % KQ_FRAMES_IN_FLIGHT;
+		kq->rendering = false;
+		kq->stats.cpu_frame_ns = kqvk_now_ns() - kq->frame_begin_ns;
+		return true;
+	}
 
 	rend_info.present_info.pImageIndices = &kq->img_index;
 	rend_info.present_info.pWaitSemaphores = &kq->render_finished_semaphore[kq->current_frame];
+	rend_info.present_info.pNext = kq_damage_present(kq) ? &rend_info.present_regions : 0;
+	if (kq->has_present_wait) {
+		++kq->present_id;
+		rend_info.present_ids.pNext = rend_info.present_info.pNext;
+		rend_info.present_info.pNext = &rend_info.present_ids;
+	}
+	if (kq->has_display_timing) {
+		rend_info.present_time = (VkPresentTimeGOOGLE){.presentID = (u32)kq->stats.frames};
+		rend_info.present_times.pNext = rend_info.present_info.pNext;
+		rend_info.present_info.pNext = &rend_info.present_times;
+	}
 
-	switch (vkQueuePresentKHR(kq->q_present, &rend_info.present_info)) {
+	KQ_PROF_BEGIN("vkQueuePresentKHR");
+	const VkResult present_res = vkQueuePresentKHR(kq->q_present, &rend_info.present_info);
+	KQ_PROF_END();
+	kq->latency_cur.present_ns = kqvk_now_ns();
+	switch (present_res) {
 	case VK_SUBOPTIMAL_KHR:
 	case VK_ERROR_OUT_OF_DATE_KHR:
 		if (!kqvk_swapchain_recreate(kq))
@@ -393,10 +889,15 @@ bool KQrender_end(kq_data kq[static 1]) {
 	default:
 		return false;
 	}
+	if (kq->has_display_timing)
+		kq->latency_pending[kq->latency_cur.frame % KQ_LATENCY_PENDING] = kq->latency_cur;
+	else
+		kq->stats.latency = kq->latency_cur;
 
 	kq->current_frame = (kq->current_frame + 1) % KQ_FRAMES_IN_FLIGHT;
 
 	kq->rendering = false;
+	kq->stats.cpu_frame_ns = kqvk_now_ns() - kq->frame_begin_ns;
 	return true;
 }
 
@@ -404,22 +905,1095 @@ bool KQdraw_quad(kq_data kq[static 1], const float pos[restrict static 2], const
 	if (!kq->rendering)
 		return false;
 
-	kq->tiles_pcs.position[0] = pos[0];
-	kq->tiles_pcs.position[1] = pos[1];
-	kq->tiles_pcs.scale[0] = scale[0];
-	kq->tiles_pcs.scale[1] = scale[1];
-	kq->tiles_pcs.tiles_tex_index = (float)tiles_tex_index;
+	kq_tile_instance *inst = kqvk_batch_push(kq);
+	if (!inst)
+		return false;
+	*inst = (kq_tile_instance){
+		.position = {pos[0], pos[1]},
+		.scale = {scale[0], scale[1]},
+		.uv_rect = {0.0f, 0.0f, 1.0f, 1.0f},
+		.color = KQ_RGBA(255, 255, 255, 255),
+		.layer = tiles_tex_index,
+	};
+	kqvk_damage_add(kq, 1, inst, 0);
+	++kq->stats.quads;
+	return true;
+}
+
+bool KQdraw_quad_animated(kq_data     kq[static 1],
+                          const float pos[restrict static 2],
+                          const float scale[restrict static 2],
+                          u32         tiles_tex_index,
+                          u32         clip,
+                          float       start) {
+	if (!kq->rendering)
+		return false;
+
+	kq_tile_instance *inst = kqvk_batch_push(kq);
+	if (!inst)
+		return false;
+	*inst = (kq_tile_instance){
+		.position = {pos[0], pos[1]},
+		.scale = {scale[0], scale[1]},
+		.uv_rect = {0.0f, 0.0f, 1.0f, 1.0f},
+		.color = KQ_RGBA(255, 255, 255, 255),
+		.layer = tiles_tex_index,
+		.flags = KQ_INSTANCE_CLIP(clip),
+		.anim_start = start,
+	};
+	kqvk_damage_add(kq, 1, inst, 0);
+	++kq->stats.quads;
+	return true;
+}
+
+static bool kq_font_open(kq_data kq[restrict static 1], kq_font font[restrict static 1], const char path[restrict static 1], float raster_px) {
+	FT_Error e = FT_New_Face(kq->ft_lib, path, 0, &font->face);
+	if (e) {
+		LOGM_ERROR("Failed loading font \"%s\": %s.", path, FT_Error_String(e));
+		return false;
+	}
+
+	// At 72 dpi, points are pixels.
+	font->size = (u32)(raster_px * 64.0f + 0.5f);
+	e = FT_Set_Char_Size(font->face, 0, (FT_F26Dot6)font->size, 72, 72);
+	if (e) {
+		LOGM_ERROR("Unable to set font size %.1f px: %s.", (double)raster_px, FT_Error_String(e));
+		FT_Done_Face(font->face);
+		return false;
+	}
+
+	font->hb_font = hb_ft_font_create_referenced(font->face);
+	font->id = ++kq->fonts_loaded;
+	font->scale = 1.0f;
+	font->sdf = false;
+	font->sdf_count = 0;
+	font->sdf_glyphs = 0;
+	return true;
+}
+
+bool KQfont_load(kq_data kq[restrict static 1], kq_font font[restrict static 1], const char path[restrict static 1], float px_size) {
+	KQ_PROF_FUNC();
+	return kq_font_open(kq, font, path, px_size);
+}
+
+bool KQfont_load_sdf(kq_data kq[restrict static 1], kq_font font[restrict static 1], const char path[restrict static 1], float px_size) {
+	KQ_PROF_FUNC();
+	if (!kq_font_open(kq, font, path, (float)KQ_SDF_BASE_PX))
+		return false;
+
+	font->sdf = true;
+	if (!KQfont_set_size(font, px_size) || !kqtxt_sdf_prebake(font, path)) {
+		KQfont_destroy(font);
+		return false;
+	}
+	return true;
+}
+
+bool KQfont_set_size(kq_font font[static 1], float px_size) {
+	if (!font->sdf || !(px_size > 0.0f)) {
+		LOGM_ERROR("Only SDF fonts can change size, and only to a positive one.");
+		return false;
+	}
+
+	font->scale = px_size / (float)KQ_SDF_BASE_PX;
+	return true;
+}
+
+void KQfont_destroy(kq_font font[static 1]) {
+	kqtxt_sdf_free(font);
+	hb_font_destroy(font->hb_font);
+	FT_Done_Face(font->face);
+}
+
+bool KQdraw_text(kq_data     kq[restrict static 1],
+                 kq_font     font[restrict static 1],
+                 const char  text[restrict static 1],
+                 const float pos[restrict static 2],
+                 u32         rgba) {
+	KQ_PROF_FUNC();
+	if (!kq->rendering)
+		return false;
+
+	u32                        count;
+	const hb_glyph_info_t     *infos;
+	const hb_glyph_position_t *positions;
+	if (!kqtxt_shape(kq, font, strlen(text), text, HB_DIRECTION_INVALID, HB_SCRIPT_INVALID, HB_LANGUAGE_INVALID, &count, &infos, &positions))
+		return false;
+
+	// NDC to pixels, in 26.6.
+	s64 pen[2] = {
+		(s64)((pos[0] + 1.0f) * 0.5f * kq->viewport.width * 64.0f),
+		(s64)((pos[1] + 1.0f) * 0.5f * kq->viewport.height * 64.0f),
+	};
+	return kqtxt_draw_run(kq, font, count, infos, positions, pen, rgba, 0);
+}
+
+bool KQtext_box_create(kq_text_box box[restrict static 1], const float origin[restrict static 2], float width, float line_height, kq_text_align align) {
+	*box = (kq_text_box){
+		.origin = {origin[0], origin[1]},
+		.width = width,
+		.line_height = line_height,
+		.align = align,
+		.dirty_line = KQ_TEXT_CLEAN,
+	};
+
+	box->text = vecchar_create(0);
+	if (!box->text)
+		goto fail_text;
+	box->text_styles = vecu8_create(0);
+	if (!box->text_styles)
+		goto fail_text_styles;
+	box->lines = vecline_create(0);
+	if (!box->lines)
+		goto fail_lines;
+	box->instances = vecinst_create(0);
+	if (!box->instances)
+		goto fail_instances;
+	box->scratch_lines = vecline_create(0);
+	if (!box->scratch_lines)
+		goto fail_scratch_lines;
+	box->scratch_instances = vecinst_create(0);
+	if (!box->scratch_instances)
+		goto fail_scratch_instances;
+	return true;
+
+fail_scratch_instances:
+	vecline_destroy(box->scratch_lines);
+fail_scratch_lines:
+	vecinst_destroy(box->instances);
+fail_instances:
+	vecline_destroy(box->lines);
+fail_lines:
+	vecu8_destroy(box->text_styles);
+fail_text_styles:
+	vecchar_destroy(box->text);
+fail_text:
+	KQ_OOM_MSG();
+	return false;
+}
+
+void KQtext_box_destroy(kq_data kq[restrict static 1], kq_text_box box[restrict static 1]) {
+	vkDeviceWaitIdle(kq->vk_ldev);
+	vkDestroyBuffer(kq->vk_ldev, box->retired_buf, 0);
+	vkFreeMemory(kq->vk_ldev, box->retired_mem, 0);
+	vkDestroyBuffer(kq->vk_ldev, box->buf, 0);
+	vkFreeMemory(kq->vk_ldev, box->buf_mem, 0);
+	vecinst_destroy(box->scratch_instances);
+	vecline_destroy(box->scratch_lines);
+	vecinst_destroy(box->instances);
+	vecline_destroy(box->lines);
+	vecu8_destroy(box->text_styles);
+	vecchar_destroy(box->text);
+}
+
+bool KQtext_box_add_style(kq_text_box box[restrict static 1], kq_font font[restrict static 1], u32 rgba, u32 style[restrict static 1]) {
+	if (box->styles_count == KQ_TEXT_STYLES_MAX) {
+		LOGM_ERROR("Text box already has the maximum of %d styles.", KQ_TEXT_STYLES_MAX);
+		return false;
+	}
+
+	box->styles[box->styles_count] = (kq_text_style){.font = font, .rgba = rgba};
+	*style = box->styles_count++;
+	return true;
+}
+
+bool KQtext_box_insert(kq_text_box box[restrict static 1], u32 at, const char text[restrict static 1], u32 style) {
+	return kqtxt_box_splice_text(box, at, 0, (u32)strlen(text), text, style);
+}
+
+bool KQtext_box_append(kq_text_box box[restrict static 1], const char text[restrict static 1], u32 style) {
+	return KQtext_box_insert(box, (u32)box->text->size, text, style);
+}
+
+bool KQtext_box_erase(kq_text_box box[restrict static 1], u32 at, u32 len) {
+	return kqtxt_box_splice_text(box, at, len, 0, 0, 0);
+}
+
+bool KQtext_box_draw(kq_data kq[restrict static 1], kq_text_box box[restrict static 1]) {
+	KQ_PROF_FUNC();
+	if (!kq->rendering)
+		return false;
+
+	if (!kqtxt_box_layout(kq, box) || !kqtxt_box_upload(kq, box))
+		return false;
+
+	// Skip the frame rather than draw a buffer that is only partly up to date; staging was full.
+	if (box->upload_first < box->upload_end) {
+		kq->redraw = true;
+		return true;
+	}
+	if (!box->instances->size)
+		return true;
+
+	// Keeps the pages the box samples from being evicted this frame.
+	for (u32 l = 0U; l < kq->atlas_layers; ++l) {
+		if (box->atlas_layers_used & 1U << l)
+			kq->atlas_layer_used[l] = kq->stats.frames;
+	}
+	kqvk_damage_add(kq, (u32)box->instances->size, box->instances->p, 0);
+	kqvk_draw_instances(kq, box->buf, 0, (u32)box->instances->size);
+	return true;
+}
+
+// Grows the store by KQ_SPRITE_GROW slots. Arrays that did grow are kept if another fails, but cap stays as it was.
+static bool kq_sprites_grow(kq_sprite_store store[static 1]) {
+	const u32 cap = store->cap + KQ_SPRITE_GROW;
+	const u32 words = cap / KQ_SPRITE_GROW;
+	vec2     *positions = realloc(store->positions, sizeof(vec2) * cap);
+	if (positions)
+		store->positions = positions;
+	vec2 *scales = realloc(store->scales, sizeof(vec2) * cap);
+	if (scales)
+		store->scales = scales;
+	u32 *colors = realloc(store->colors, sizeof(u32) * cap);
+	if (colors)
+		store->colors = colors;
+	u32 *layers = realloc(store->layers, sizeof(u32) * cap);
+	if (layers)
+		store->layers = layers;
+	u32 *flags = realloc(store->flags, sizeof(u32) * cap);
+	if (flags)
+		store->flags = flags;
+	float *anim_starts = realloc(store->anim_starts, sizeof(float) * cap);
+	if (anim_starts)
+		store->anim_starts = anim_starts;
+	u32 *free_slots = realloc(store->free, sizeof(u32) * cap);
+	if (free_slots)
+		store->free = free_slots;
+	u64 *grid_keys = realloc(store->grid_keys, sizeof(u64) * cap);
+	if (grid_keys) {
+		store->grid_keys = grid_keys;
+		for (u32 i = store->cap; i < cap; ++i)
+			store->grid_keys[i] = KQ_SPRITE_GRID_NONE;
+	}
+	u32 *grid_next = realloc(store->grid_next, sizeof(u32) * cap);
+	if (grid_next)
+		store->grid_next = grid_next;
+	u32 *grid_prev = realloc(store->grid_prev, sizeof(u32) * cap);
+	if (grid_prev)
+		store->grid_prev = grid_prev;
+	u64 *dirty = realloc(store->dirty, sizeof(u64) * words);
+	if (dirty) {
+		store->dirty = dirty;
+		store->dirty[words - 1U] = 0;
+	}
+	u64 *blank = realloc(store->blank, sizeof(u64) * words);
+	if (blank) {
+		store->blank = blank;
+		store->blank[words - 1U] = UINT64_MAX;
+	}
+	kq_damage_entry *damage = realloc(store->damage, sizeof(kq_damage_entry) * cap);
+	if (damage)
+		store->damage = damage;
+	u8 *damage_counts = realloc(store->damage_counts, cap / KQ_SPRITE_BLOCK);
+	if (damage_counts)
+		store->damage_counts = damage_counts;
+	u64 *damage_stale = realloc(store->damage_stale, sizeof(u64) * words);
+	if (damage_stale) {
+		store->damage_stale = damage_stale;
+		store->damage_stale[words - 1U] = UINT64_MAX;
+	}
+	u64 *visible = realloc(store->visible, sizeof(u64) * words);
+	if (visible)
+		store->visible = visible;
+	if (!positions || !scales || !colors || !layers || !flags || !anim_starts || !free_slots || !grid_keys || !grid_next || !grid_prev || !dirty ||
+	    !blank || !damage || !damage_counts || !damage_stale || !visible) {
+		KQ_OOM_MSG();
+		return false;
+	}
+	store->cap = cap;
+	return true;
+}
+
+static inline void kq_sprite_dirty(kq_sprite_store store[static 1], u32 handle) {
+	store->dirty[handle / KQ_SPRITE_GROW] |= 1ULL << (handle / KQ_SPRITE_BLOCK % 64U);
+}
+
+// A cell coordinate along one axis, clamped so that far-off sprites share the outermost cells.
+static inline s32 kq_grid_coord(float v, float cell) {
+	const double c = floor((double)v / (double)cell);
+	return c < (double)INT32_MIN ? INT32_MIN : c > (double)INT32_MAX ? INT32_MAX : (s32)c;
+}
+
+static inline u64 kq_grid_key(s32 x, s32 y) {
+	return (u64)(u32)x << 32 | (u32)y;
+}
+
+static inline u64 kq_grid_key_of(const kq_sprite_grid grid[static 1], const float pos[static 2]) {
+	return kq_grid_key(kq_grid_coord(pos[0], grid->cell), kq_grid_coord(pos[1], grid->cell));
+}
+
+static inline u32 kq_grid_bucket(const kq_sprite_grid grid[static 1], u64 key) {
+	return (u32)(key * 0x9E3779B97F4A7C15ULL >> 32) & (grid->buckets - 1U);
+}
+
+static inline void kq_grid_push(kq_sprite_store store[static 1], kq_sprite_grid grid[static 1], u32 i) {
+	u32 *head = &grid->heads[kq_grid_bucket(grid, store->grid_keys[i])];
+	store->grid_prev[i] = KQ_SPRITE_NONE;
+	store->grid_next[i] = *head;
+	if (*head != KQ_SPRITE_NONE)
+		store->grid_prev[*head] = i;
+	*head = i;
+}
 
-	vkCmdPushConstants(kq->cmd_buf[kq->current_frame],
-	                   kq->pipeline_layout,
-	                   VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-	                   0,
-	                   sizeof(kq_tiles_pcs),
-	                   &kq->tiles_pcs);
-	vkCmdDrawIndexed(kq->cmd_buf[kq->current_frame], KQ_QUAD_NUM_INDICES, 1, 0, 0, 0);
+// Moves a layer's sprites into buckets new ones, rekeying them for the grid's cell size. The grid stays as it was if
+// out of memory.
+static bool kq_grid_rebuild(kq_sprite_store store[static 1], kq_sprite_grid grid[static 1], u32 buckets) {
+	u32 *heads = malloc(sizeof(u32) * buckets);
+	if (!heads) {
+		KQ_OOM_MSG();
+		return false;
+	}
+	for (u32 b = 0U; b < buckets; ++b)
+		heads[b] = KQ_SPRITE_NONE;
+
+	u32 *old_heads = grid->heads;
+	u32  old_buckets = grid->buckets;
+	grid->heads = heads;
+	grid->buckets = buckets;
+	for (u32 b = 0U; b < old_buckets; ++b) {
+		for (u32 i = old_heads[b], next; i != KQ_SPRITE_NONE; i = next) {
+			next = store->grid_next[i];
+			store->grid_keys[i] = kq_grid_key_of(grid, store->positions[i]);
+			kq_grid_push(store, grid, i);
+		}
+	}
+	free(old_heads);
+	return true;
+}
+
+// Makes sure the store has a grid, maybe without buckets yet, for layers below count.
+static bool kq_grids_reserve(kq_sprite_store store[static 1], u32 count) {
+	if (count <= store->grids_count)
+		return true;
+
+	kq_sprite_grid *grids = realloc(store->grids, sizeof(kq_sprite_grid) * count);
+	if (!grids) {
+		KQ_OOM_MSG();
+		return false;
+	}
+	for (u32 l = store->grids_count; l < count; ++l)
+		grids[l] = (kq_sprite_grid){.cell = store->grid_cell};
+	store->grids = grids;
+	store->grids_count = count;
+	return true;
+}
+
+static void kq_grid_unlink(kq_sprite_store store[static 1], u32 i) {
+	if (store->grid_keys[i] == KQ_SPRITE_GRID_NONE)
+		return;
+
+	kq_sprite_grid *grid = &store->grids[store->layers[i]];
+	const u32       next = store->grid_next[i];
+	const u32       prev = store->grid_prev[i];
+	if (prev == KQ_SPRITE_NONE)
+		grid->heads[kq_grid_bucket(grid, store->grid_keys[i])] = next;
+	else
+		store->grid_next[prev] = next;
+	if (next != KQ_SPRITE_NONE)
+		store->grid_prev[next] = prev;
+	store->grid_keys[i] = KQ_SPRITE_GRID_NONE;
+	--grid->count;
+}
+
+// Indexes a slot in its layer's grid, making the grid first if the layer has none.
+static bool kq_grid_link(kq_sprite_store store[static 1], u32 i) {
+	const u32 layer = store->layers[i];
+	if (!kq_grids_reserve(store, layer + 1U))
+		return false;
+	kq_sprite_grid *grid = &store->grids[layer];
+	if (!grid->heads && !kq_grid_rebuild(store, grid, KQ_SPRITE_GRID_BUCKETS))
+		return false;
+	if (grid->count >= grid->buckets * 2U)
+		kq_grid_rebuild(store, grid, grid->buckets * 2U); // Only slower for failing.
+
+	store->grid_keys[i] = kq_grid_key_of(grid, store->positions[i]);
+	kq_grid_push(store, grid, i);
+	++grid->count;
+	for (size_t a = 0; a < 2; ++a) {
+		if (fabsf(store->scales[i][a]) > grid->reach[a])
+			grid->reach[a] = fabsf(store->scales[i][a]);
+	}
 	return true;
 }
 
+static inline bool kq_sprite_overlaps(const kq_sprite_store store[static 1], u32 i, const float min[static 2], const float max[static 2]) {
+	if (store->flags[i] & (KQ_SPRITE_HIDDEN | KQ_SPRITE_FREE))
+		return false;
+	for (size_t a = 0; a < 2; ++a) {
+		const float extent = fabsf(store->scales[i][a]);
+		if (store->positions[i][a] - extent > max[a] || store->positions[i][a] + extent < min[a])
+			return false;
+	}
+	return true;
+}
+
+typedef void kq_sprite_visit_fn(u32 handle, void *ctx);
+
+// Calls fn for every visible sprite overlapping the rectangle from min to max, through the grids if there are any.
+static void kq_sprites_visit(const kq_sprite_store store[static 1],
+                             const float           min[static 2],
+                             const float           max[static 2],
+                             kq_sprite_visit_fn   *fn,
+                             void                 *ctx) {
+	if (!store->grid_cell) {
+		for (u32 i = 0U; i < store->count; ++i) {
+			if (kq_sprite_overlaps(store, i, min, max))
+				fn(i, ctx);
+		}
+		return;
+	}
+
+	for (u32 l = 0U; l < store->grids_count; ++l) {
+		const kq_sprite_grid *grid = &store->grids[l];
+		if (!grid->count)
+			continue;
+
+		const s32 x0 = kq_grid_coord(min[0] - grid->reach[0], grid->cell);
+		const s32 x1 = kq_grid_coord(max[0] + grid->reach[0], grid->cell);
+		const s32 y0 = kq_grid_coord(min[1] - grid->reach[1], grid->cell);
+		const s32 y1 = kq_grid_coord(max[1] + grid->reach[1], grid->cell);
+
+		// Past as many cells as the grid has sprites, going through the sprites is cheaper.
+		if (((double)x1 - x0 + 1.0) * ((double)y1 - y0 + 1.0) > (double)grid->count) {
+			for (u32 i = 0U; i < store->count; ++i) {
+				if (store->grid_keys[i] != KQ_SPRITE_GRID_NONE && store->layers[i] == l && kq_sprite_overlaps(store, i, min, max))
+					fn(i, ctx);
+			}
+			continue;
+		}
+
+		for (s64 y = y0; y <= y1; ++y) {
+			for (s64 x = x0; x <= x1; ++x) {
+				const u64 key = kq_grid_key((s32)x, (s32)y);
+				for (u32 i = grid->heads[kq_grid_bucket(grid, key)]; i != KQ_SPRITE_NONE; i = store->grid_next[i]) {
+					if (store->grid_keys[i] == key && kq_sprite_overlaps(store, i, min, max))
+						fn(i, ctx);
+				}
+			}
+		}
+	}
+}
+
+bool KQsprites_create(kq_sprite_store store[static 1]) {
+	*store = (kq_sprite_store){0};
+	return kq_sprites_grow(store);
+}
+
+void KQsprites_destroy(kq_data kq[restrict static 1], kq_sprite_store store[restrict static 1]) {
+	vkDeviceWaitIdle(kq->vk_ldev);
+	vkDestroyBuffer(kq->vk_ldev, store->retired_buf, 0);
+	vkFreeMemory(kq->vk_ldev, store->retired_mem, 0);
+	vkDestroyBuffer(kq->vk_ldev, store->buf, 0);
+	vkFreeMemory(kq->vk_ldev, store->buf_mem, 0);
+	for (u32 l = 0U; l < store->grids_count; ++l)
+		free(store->grids[l].heads);
+	free(store->grids);
+	free(store->positions);
+	free(store->scales);
+	free(store->colors);
+	free(store->layers);
+	free(store->flags);
+	free(store->anim_starts);
+	free(store->free);
+	free(store->grid_keys);
+	free(store->grid_next);
+	free(store->grid_prev);
+	free(store->dirty);
+	free(store->blank);
+	free(store->damage);
+	free(store->damage_counts);
+	free(store->damage_stale);
+	free(store->visible);
+	*store = (kq_sprite_store){0};
+}
+
+bool KQsprite_add(kq_sprite_store store[restrict static 1],
+                  const float     pos[restrict static 2],
+                  const float     scale[restrict static 2],
+                  u32             layer,
+                  u32             handle[restrict static 1]) {
+	u32 i;
+	if (store->free_count) {
+		i = store->free[--store->free_count];
+	} else {
+		if (store->count == store->cap && !kq_sprites_grow(store))
+			return false;
+		i = store->count++;
+	}
+	store->anim_starts[i] = 0.0f;
+	if (!KQsprite_set(store, i, pos, scale, KQ_RGBA(255, 255, 255, 255), layer, 0)) {
+		store->flags[i] = KQ_SPRITE_FREE;
+		store->free[store->free_count++] = i;
+		return false;
+	}
+	*handle = i;
+	return true;
+}
+
+void KQsprite_remove(kq_sprite_store store[static 1], u32 handle) {
+	if (store->flags[handle] & KQ_SPRITE_FREE)
+		return;
+
+	kq_grid_unlink(store, handle);
+	store->flags[handle] = KQ_SPRITE_FREE;
+	store->free[store->free_count++] = handle;
+	kq_sprite_dirty(store, handle);
+}
+
+void KQsprite_move(kq_sprite_store store[restrict static 1], u32 handle, const float pos[restrict static 2]) {
+	store->positions[handle][0] = pos[0];
+	store->positions[handle][1] = pos[1];
+	kq_sprite_dirty(store, handle);
+
+	// Only crossing into another cell touches the index; the layer's grid exists, so linking can't fail.
+	if (store->grid_keys[handle] != KQ_SPRITE_GRID_NONE && store->grid_keys[handle] != kq_grid_key_of(&store->grids[store->layers[handle]], pos)) {
+		kq_grid_unlink(store, handle);
+		kq_grid_link(store, handle);
+	}
+}
+
+bool KQsprite_set(kq_sprite_store store[restrict static 1],
+                  u32             handle,
+                  const float     pos[restrict static 2],
+                  const float     scale[restrict static 2],
+                  u32             rgba,
+                  u32             layer,
+                  u32             flags) {
+	kq_grid_unlink(store, handle);
+	store->positions[handle][0] = pos[0];
+	store->positions[handle][1] = pos[1];
+	store->scales[handle][0] = scale[0];
+	store->scales[handle][1] = scale[1];
+	store->colors[handle] = rgba;
+	store->layers[handle] = layer;
+	store->flags[handle] = flags & ~KQ_SPRITE_FREE;
+	store->animated |= (flags & KQ_INSTANCE_CLIP_MASK) != 0U;
+	kq_sprite_dirty(store, handle);
+	return !store->grid_cell || kq_grid_link(store, handle);
+}
+
+void KQsprite_animate(kq_sprite_store store[static 1], u32 handle, u32 clip, float start) {
+	store->flags[handle] &= ~KQ_INSTANCE_CLIP_MASK;
+	if (clip != KQ_SPRITE_NONE) {
+		store->flags[handle] |= KQ_INSTANCE_CLIP(clip);
+		store->animated = true;
+	}
+	store->anim_starts[handle] = start;
+	kq_sprite_dirty(store, handle);
+}
+
+// The world rectangle the viewport shows through the camera, or false if the camera shows no area.
+static bool kq_camera_view(const kq_data kq[static 1], float min[static 2], float max[static 2]) {
+	const float *m = kq->uniforms.camera;
+	const float  det = m[0] * m[3] - m[2] * m[1];
+	if (!(fabsf(det) > 0.0f))
+		return false;
+
+	// From the first corner on, as -ffinite-math-only leaves no infinity to start from.
+	for (u32 k = 0U; k < 4U; ++k) {
+		const float x = (k & 1U ? 1.0f : -1.0f) - kq->uniforms.camera_offset[0];
+		const float y = (k & 2U ? 1.0f : -1.0f) - kq->uniforms.camera_offset[1];
+		const float corner[2] = {(m[3] * x - m[2] * y) / det, (m[0] * y - m[1] * x) / det};
+		for (size_t a = 0; a < 2; ++a) {
+			min[a] = !k || corner[a] < min[a] ? corner[a] : min[a];
+			max[a] = !k || corner[a] > max[a] ? corner[a] : max[a];
+		}
+	}
+	return true;
+}
+
+static void kq_sprite_mark_visible(u32 handle, void *ctx) {
+	u64 *visible = ctx;
+	visible[handle / KQ_SPRITE_GROW] |= 1ULL << (handle / KQ_SPRITE_BLOCK % 64U);
+}
+
+bool KQsprites_draw(kq_data kq[restrict static 1], kq_sprite_store store[restrict static 1]) {
+	KQ_PROF_FUNC();
+	if (!kq->rendering)
+		return false;
+
+	if (!kqvk_sprites_upload(kq, store))
+		return false;
+
+	// Blocks staging had no room for are drawn as they last went up, and finish going up over the next frames.
+	const u32 words = store->cap / KQ_SPRITE_GROW;
+	for (u32 w = 0U; w < words; ++w) {
+		if (store->dirty[w]) {
+			kq->redraw = true;
+			break;
+		}
+	}
+	if (!store->count)
+		return true;
+
+	kqvk_sprites_damage(kq, store);
+
+	// Culls by block with a spatial index. Each run of blocks holding a sprite in the viewport, and anything uploaded yet,
+	// is one draw.
+	vec2 view_min, view_max;
+	if (store->grid_cell && kq_camera_view(kq, view_min, view_max)) {
+		memset(store->visible, 0, sizeof(u64) * words);
+		kq_sprites_visit(store, view_min, view_max, kq_sprite_mark_visible, store->visible);
+	} else {
+		memset(store->visible, 0xFF, sizeof(u64) * words);
+	}
+	for (u32 w = 0U; w < words; ++w)
+		store->visible[w] &= ~store->blank[w];
+
+	const u32 blocks = (store->count + KQ_SPRITE_BLOCK - 1U) / KQ_SPRITE_BLOCK;
+	for (u32 b = 0U; b < blocks;) {
+		if (!store->visible[b / 64U]) {
+			b = (b / 64U + 1U) * 64U;
+			continue;
+		}
+		if (!(store->visible[b / 64U] >> b % 64U & 1U)) {
+			++b;
+			continue;
+		}
+		u32 end = b + 1U;
+		while (end < blocks && store->visible[end / 64U] >> end % 64U & 1U)
+			++end;
+		const u32 first = b * KQ_SPRITE_BLOCK;
+		const u32 last = end * KQ_SPRITE_BLOCK < store->count ? end * KQ_SPRITE_BLOCK : store->count;
+		kqvk_draw_instances(kq, store->buf, first, last - first);
+		b = end;
+	}
+	return true;
+}
+
+bool KQsprites_draw_transformed(kq_data               kq[restrict static 1],
+                                const kq_sprite_store store[restrict static 1],
+                                const kq_sprite_xform xf[restrict static 1]) {
+	KQ_PROF_FUNC();
+	if (!kq->rendering)
+		return false;
+
+	// A chunk at a time, as the batch's instance memory is.
+	for (u32 first = 0U; first < store->count;) {
+		u32               room;
+		kq_tile_instance *dst = kqvk_batch_reserve(kq, &room);
+		if (!dst)
+			return false;
+
+		const u32 n = store->count - first < room ? store->count - first : room;
+		const u32 visible = kq_simd_sprites_cull(store, first, n, xf, dst);
+		kqvk_damage_add(kq, visible, dst, 0);
+		kqvk_batch_commit(kq, visible);
+		kq->stats.quads += visible;
+		first += n;
+	}
+	return true;
+}
+
+bool KQsprites_grid_enable(kq_sprite_store store[static 1], float cell) {
+	if (store->grid_cell)
+		return true;
+
+	store->grid_cell = cell;
+	for (u32 l = 0U; l < store->grids_count; ++l) {
+		if (!store->grids[l].cell)
+			store->grids[l].cell = cell;
+	}
+	for (u32 i = 0U; i < store->count; ++i) {
+		if (!(store->flags[i] & KQ_SPRITE_FREE) && !kq_grid_link(store, i))
+			return false;
+	}
+	return true;
+}
+
+bool KQsprites_grid_cell_set(kq_sprite_store store[static 1], u32 layer, float cell) {
+	if (!kq_grids_reserve(store, layer + 1U))
+		return false;
+
+	kq_sprite_grid *grid = &store->grids[layer];
+	grid->cell = cell;
+	return !grid->heads || kq_grid_rebuild(store, grid, grid->buckets);
+}
+
+typedef struct kq_sprite_rect_query {
+	u32  cap;
+	u32  found;
+	u32 *handles;
+} kq_sprite_rect_query;
+
+static void kq_sprite_collect(u32 handle, void *ctx) {
+	kq_sprite_rect_query *q = ctx;
+	if (q->found < q->cap)
+		q->handles[q->found] = handle;
+	++q->found;
+}
+
+u32 KQsprites_query_rect(const kq_sprite_store store[restrict static 1],
+                         const float           min[restrict static 2],
+                         const float           max[restrict static 2],
+                         u32                   cap,
+                         u32                   handles[restrict cap]) {
+	kq_sprite_rect_query q = {.cap = cap, .handles = handles};
+	kq_sprites_visit(store, min, max, kq_sprite_collect, &q);
+	return q.found;
+}
+
+// Later slots are drawn over earlier ones.
+static void kq_sprite_topmost(u32 handle, void *ctx) {
+	u32 *top = ctx;
+	if (*top == KQ_SPRITE_NONE || handle > *top)
+		*top = handle;
+}
+
+u32 KQsprites_query_point(const kq_sprite_store store[restrict static 1], const float pos[restrict static 2]) {
+	u32 top = KQ_SPRITE_NONE;
+	kq_sprites_visit(store, pos, pos, kq_sprite_topmost, &top);
+	return top;
+}
+
+bool KQtarget_create(kq_data kq[restrict static 1], kq_render_target target[restrict static 1], u32 width, u32 height) {
+	KQ_PROF_FUNC();
+	*target = (kq_render_target){.width = width, .height = height, .generation = ++kq->targets_drawn};
+	if (!kqvk_image_create(kq,
+	                       width,
+	                       height,
+	                       1,
+	                       rend_info.target_color_attachment.format,
+	                       VK_IMAGE_TILING_OPTIMAL,
+	                       VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+	                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	                       &target->image,
+	                       &target->mem)) {
+		LOGM_ERROR("Unable to create a %ux%u render target.", width, height);
+		goto fail_image_create;
+	}
+	// Drawable as a sprite before anything is rendered into it.
+	kqvk_image_clear(kq, target->image);
+
+	VkImageViewCreateInfo view_cinfo = rend_info.target_view_cinfo;
+	view_cinfo.image = target->image;
+	if (vkCreateImageView(kq->vk_ldev, &view_cinfo, 0, &target->view)) {
+		LOGM_ERROR("Unable to create render target view.");
+		goto fail_vkCreateImageView;
+	}
+
+	// Dynamic rendering names the view when the pass begins.
+	const VkFramebufferCreateInfo fbo_cinfo = {
+		.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+		.renderPass = kq->target_pass,
+		.attachmentCount = 1,
+		.pAttachments = &target->view,
+		.width = width,
+		.height = height,
+		.layers = 1,
+	};
+	if (!kq->dynamic_rendering && vkCreateFramebuffer(kq->vk_ldev, &fbo_cinfo, 0, &target->fbo)) {
+		LOGM_ERROR("Unable to create render target framebuffer.");
+		goto fail_vkCreateFramebuffer;
+	}
+
+	const VkDescriptorSetAllocateInfo ainfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = kq->target_desc_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &kq->target_set_layout,
+	};
+	if (vkAllocateDescriptorSets(kq->vk_ldev, &ainfo, &target->desc_set)) {
+		LOGM_ERROR("Unable to allocate a render target descriptor set; at most %d targets can exist.", KQ_RENDER_TARGETS_MAX);
+		goto fail_vkAllocateDescriptorSets;
+	}
+	kqvk_target_set_write(kq, target->desc_set, target->view);
+	return true;
+
+fail_vkAllocateDescriptorSets:
+	vkDestroyFramebuffer(kq->vk_ldev, target->fbo, 0);
+fail_vkCreateFramebuffer:
+	vkDestroyImageView(kq->vk_ldev, target->view, 0);
+fail_vkCreateImageView:
+	vkDestroyImage(kq->vk_ldev, target->image, 0);
+	vkFreeMemory(kq->vk_ldev, target->mem, 0);
+fail_image_create:
+	return false;
+}
+
+void KQtarget_destroy(kq_data kq[restrict static 1], kq_render_target target[restrict static 1]) {
+	vkDeviceWaitIdle(kq->vk_ldev);
+	vkFreeDescriptorSets(kq->vk_ldev, kq->target_desc_pool, 1, &target->desc_set);
+	vkDestroyFramebuffer(kq->vk_ldev, target->fbo, 0);
+	vkDestroyImageView(kq->vk_ldev, target->view, 0);
+	vkDestroyImage(kq->vk_ldev, target->image, 0);
+	vkFreeMemory(kq->vk_ldev, target->mem, 0);
+	*target = (kq_render_target){0};
+}
+
+bool KQtarget_begin(kq_data kq[restrict static 1], kq_render_target target[restrict static 1]) {
+	KQ_PROF_FUNC();
+	if (!kq->rendering || kq->target_active)
+		return false;
+
+	// The frame's draws so far, into the frame's command buffer or its log.
+	kqvk_batch_flush(kq);
+	// Sprites of the target drawn already were hashed with the contents it is about to lose.
+	for (size_t i = 0; kq->damage_on && i < kq->scene_draws->size; ++i)
+		kq->damage_full |= kq->scene_draws->p[i].set == target->desc_set;
+
+	const VkCommandBuffer cmd_buf = kq->target_cmd_buf[kq->current_frame];
+	if (!kq->targets_recorded) {
+		vkResetCommandBuffer(cmd_buf, 0);
+		if (vkBeginCommandBuffer(cmd_buf, &rend_info.cmd_buf_begin_info))
+			return false;
+		kq->targets_recorded = true;
+	}
+
+	kqvk_pass_begin(kq, cmd_buf, target, false);
+
+	// Text converts between NDC and pixels with the viewport, so it has to be the target's while drawing into it.
+	kq->outer_viewport = kq->viewport;
+	kq->outer_scissor = kq->scissor;
+	kq->target_set_outer = kq->target_set_bound;
+	kq->viewport = (VkViewport){.width = (float)target->width, .height = (float)target->height, .maxDepth = 1.0f};
+	kq->scissor = (VkRect2D){.extent = {.width = target->width, .height = target->height}};
+
+	kq->draw_cmd_buf = cmd_buf;
+	kq->target_active = target;
+	kqvk_pass_bind(kq, cmd_buf);
+	return true;
+}
+
+bool KQtarget_end(kq_data kq[static 1]) {
+	if (!kq->target_active)
+		return false;
+
+	kqvk_batch_flush(kq);
+	kqvk_pass_end(kq, kq->draw_cmd_buf, kq->target_active);
+	kq->target_active->valid = true;
+	kq->target_active->generation = ++kq->targets_drawn;
+	kq->target_active = 0;
+
+	kq->viewport = kq->outer_viewport;
+	kq->scissor = kq->outer_scissor;
+	kq->target_set_bound = kq->target_set_outer;
+	kq->draw_cmd_buf = kq->cmd_buf[kq->current_frame];
+	return true;
+}
+
+void KQtarget_invalidate(kq_render_target target[static 1]) {
+	target->valid = false;
+}
+
+bool KQdraw_target(kq_data                kq[restrict static 1],
+                   const kq_render_target target[restrict static 1],
+                   const float            pos[restrict static 2],
+                   const float            scale[restrict static 2],
+                   u32                    rgba) {
+	if (!kq->rendering || kq->target_active == target)
+		return false;
+
+	kqvk_target_bind(kq, target->desc_set);
+	kq_tile_instance *inst = kqvk_batch_push(kq);
+	if (!inst)
+		return false;
+	*inst = (kq_tile_instance){
+		.position = {pos[0], pos[1]},
+		.scale = {scale[0], scale[1]},
+		.uv_rect = {0.0f, 0.0f, 1.0f, 1.0f},
+		.color = rgba,
+		.flags = KQ_INSTANCE_TARGET,
+	};
+	kqvk_damage_add(kq, 1, inst, target->generation);
+	++kq->stats.quads;
+	return true;
+}
+
+bool KQpost_set(kq_data kq[static 1], u32 count, const kq_post_step steps[count]) {
+	if (count > KQ_POST_STEPS_MAX) {
+		LOGM_ERROR("Post chain of %u steps; at most %d fit.", count, KQ_POST_STEPS_MAX);
+		return false;
+	}
+
+	u32 blurs = 0U;
+	for (u32 i = 0U; i < count; ++i)
+		blurs += steps[i].effect == KQ_POST_BLUR || steps[i].effect == KQ_POST_BLOOM;
+	if (blurs > 1U) {
+		LOGM_ERROR("Post chain with %u blurring steps; it can have one.", blurs);
+		return false;
+	}
+
+	for (u32 i = 0U; i < count; ++i)
+		kq->post_chain.steps[i] = steps[i];
+	kq->post_chain.count = count;
+	return true;
+}
+
+bool KQinternal_res_set(kq_data kq[static 1], u32 width, u32 height, kq_scale_filter filter) {
+	if (!width != !height || width > kq->vk_surface_capabilities.maxImageExtent.width
+	    || height > kq->vk_surface_capabilities.maxImageExtent.height || filter > KQ_SCALE_SHARP_BILINEAR) {
+		LOGM_ERROR("Bad internal resolution %ux%u, or scale filter %d.", width, height, (int)filter);
+		return false;
+	}
+
+	kq->internal_base = (VkExtent2D){.width = width, .height = height};
+	kq->internal_filter = filter;
+	return true;
+}
+
+bool KQinternal_res_budget(kq_data kq[static 1], u64 budget_ns, float min_scale) {
+	if (budget_ns && !kq->timestamp_pool) {
+		LOGM_ERROR("Dynamic internal resolution needs GPU timestamps, which the graphics queue lacks.");
+		return false;
+	}
+	if (budget_ns && !(min_scale > 0.0f && min_scale <= 1.0f)) {
+		LOGM_ERROR("Minimum internal resolution scale %f is not in (0, 1].", (double)min_scale);
+		return false;
+	}
+
+	kq->internal_budget_ns = budget_ns;
+	kq->internal_scale_min = min_scale;
+	kq->internal_scale = 1.0f;
+	kq->internal_changed = kq->stats.frames;
+	return true;
+}
+
+void KQdamage_tracking_set(kq_data kq[static 1], bool on) {
+	kq->damage_tracking = on;
+}
+
+VkDeviceSize KQdevice_mem_usage(kq_data kq[static 1]) {
+	if (!kq->has_memory_budget)
+		return 0;
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+	VkPhysicalDeviceMemoryProperties2         props = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2, .pNext = &budget};
+	vkGetPhysicalDeviceMemoryProperties2(kq->vk_pdev, &props);
+
+	VkDeviceSize usage = 0;
+	for (u32 i = 0U; i < props.memoryProperties.memoryHeapCount; ++i)
+		usage += budget.heapUsage[i];
+	return usage;
+}
+
+void KQredraw(kq_data kq[static 1]) {
+	kq->redraw = true;
+}
+
+void KQredraw_at(kq_data kq[static 1], double time) {
+	if (!kq->has_redraw_deadline || time < kq->redraw_deadline) {
+		kq->redraw_deadline = time;
+		kq->has_redraw_deadline = true;
+	}
+}
+
+bool KQframe_wait(kq_data kq[static 1]) {
+	if (kq->headless)
+		return false;
+
+	glfwPollEvents();
+	while (!kq->redraw && !glfwWindowShouldClose(kq->win)) {
+		const double now = glfwGetTime();
+		if (kq->has_redraw_deadline && now >= kq->redraw_deadline)
+			break;
+		KQ_PROF_BEGIN("glfwWaitEvents");
+		if (kq->has_redraw_deadline)
+			glfwWaitEventsTimeout(kq->redraw_deadline - now);
+		else
+			glfwWaitEvents();
+		KQ_PROF_END();
+	}
+
+	kq->redraw = false;
+	kq->has_redraw_deadline = false;
+	return !glfwWindowShouldClose(kq->win);
+}
+
+void KQbackground_fps_set(kq_data kq[static 1], float fps) {
+	kq->background_fps = fps;
+}
+
+void KQpacing_set(kq_data kq[static 1], bool on, float fps) {
+	if (kq->headless)
+		return;
+
+	kq->pacing = on;
+	kq->pacing_fps = fps;
+	kq->pace_work_ns = 0;
+	kq->pace_next_ns = kqvk_now_ns();
+	const GLFWvidmode *mode = on ? glfwGetVideoMode(glfwGetPrimaryMonitor()) : 0;
+	if (mode && mode->refreshRate > 0)
+		kq->refresh_ns = 1000000000U / (u32)mode->refreshRate;
+	LOGM_DEBUG("Frame pacing %s%s.", on ? "on, " : "off", on ? (kq->has_present_wait ? "waiting for presents" : "sleeping") : "");
+}
+
+void KQcamera_set(kq_data kq[static 1], const kq_camera camera[static 1]) {
+	kq->camera = *camera;
+	kqvk_uniforms_camera(kq);
+}
+
+void KQuniforms_latch_set(kq_data kq[static 1], kq_uniforms_latch_fn *fn, void *user) {
+	kq->uniforms_latch = fn;
+	kq->uniforms_latch_user = user;
+}
+
+bool KQanim_clip_set(kq_data kq[restrict static 1], u32 clip, const kq_anim_clip c[restrict static 1]) {
+	if (clip >= KQ_ANIM_CLIPS_MAX) {
+		LOGM_ERROR("Clip %u; there are %u.", clip, KQ_ANIM_CLIPS_MAX);
+		return false;
+	}
+
+	// Field by field over zeroes, as damage tracking hashes the clip padding and all.
+	kq_anim_clip *dst = &kq->anim_clips[clip];
+	memset(dst, 0, sizeof *dst);
+	dst->uv_step[0] = c->uv_step[0];
+	dst->uv_step[1] = c->uv_step[1];
+	dst->layer_step = c->layer_step;
+	dst->frames = c->frames;
+	dst->fps = c->fps;
+	dst->mode = c->mode;
+	kq->anim_stale = (1U << KQ_FRAMES_IN_FLIGHT) - 1U;
+	KQredraw(kq);
+	return true;
+}
+
+void KQresize(kq_data kq[static 1], u32 w, u32 h) {
+	kq->fb_resized = true;
+	kq->redraw = true;
+	kqvk_ready_new_resolution(kq, (int)w, (int)h);
+}
+
+bool KQframe_read(kq_data kq[restrict static 1], size_t size, u8 rgba[restrict size]) {
+	if (!kq->headless || !kq->readback_ready)
+		return false;
+
+	const size_t px_count = (size_t)kq->headless_extent.width * kq->headless_extent.height;
+	if (size != px_count * 4) {
+		LOGM_ERROR("Frame readback needs %zu bytes, but was given %zu.", px_count * 4, size);
+		return false;
+	}
+
+	KQ_PROF_BEGIN("vkWaitForFences");
+	vkWaitForFences(kq->vk_ldev, 1, &kq->in_flight_fence[kq->readback_frame], VK_TRUE, UINT64_MAX);
+	KQ_PROF_END();
+
+	// The images are B8G8R8A8, like the swapchain's.
+	const u8 *bgra = kq->readback_bufs_mapped[kq->readback_frame];
+	for (size_t i = 0; i < px_count * 4; i += 4) {
+		rgba[i + 0] = bgra[i + 2];
+		rgba[i + 1] = bgra[i + 1];
+		rgba[i + 2] = bgra[i + 0];
+		rgba[i + 3] = bgra[i + 3];
+	}
+
+	return true;
+}
+
+bool KQframe_save_png(kq_data kq[restrict static 1], const char path[restrict static 1]) {
+	const size_t size = (size_t)kq->headless_extent.width * kq->headless_extent.height * 4;
+	u8          *rgba = malloc(size);
+	if (!rgba) {
+		KQ_OOM_MSG();
+		return false;
+	}
+
+	const bool ok = KQframe_read(kq, size, rgba) && kqvk_png_write(path, kq->headless_extent.width, kq->headless_extent.height, rgba);
+	free(rgba);
+	return ok;
+}
+
 
 #undef CB_LOG_MODULE
 #define CB_LOG_MODULE "GLFW"
@@ -429,13 +2003,75 @@ static void kq_callback_glfw_error(int e, const char *desc) {
 }
 
 static void kq_callback_glfw_fb_resize(GLFWwindow *win, int w, int h) {
+	kq_data *kq = (kq_data *)glfwGetWindowUserPointer(win);
+	if (kq)
+		KQresize(kq, (u32)w, (u32)h);
+}
+
+// The window's contents were damaged, and need drawing again.
+static void kq_glfw_redraw(GLFWwindow *win) {
+	kq_data *kq = (kq_data *)glfwGetWindowUserPointer(win);
+	if (kq)
+		KQredraw(kq);
+}
+
+// Input also starts the clock on stats.latency, for the frame that consumes it.
+static void kq_glfw_input(GLFWwindow *win) {
+	kq_data *kq = (kq_data *)glfwGetWindowUserPointer(win);
+	if (!kq)
+		return;
+	if (!kq->input_ns)
+		kq->input_ns = kqvk_now_ns();
+	KQredraw(kq);
+}
+
+static void kq_callback_glfw_refresh(GLFWwindow *win) {
+	kq_glfw_redraw(win);
+}
+
+static void kq_callback_glfw_focus(GLFWwindow *win, int focused) {
 	kq_data *kq = (kq_data *)glfwGetWindowUserPointer(win);
 	if (kq) {
-		kq->fb_resized = true;
-		kqvk_ready_new_resolution(kq, w, h);
+		kq->focused = focused;
+		KQredraw(kq);
 	}
 }
 
+static void kq_callback_glfw_iconify(GLFWwindow *win, int iconified) {
+	kq_data *kq = (kq_data *)glfwGetWindowUserPointer(win);
+	if (kq) {
+		kq->iconified = iconified;
+		KQredraw(kq);
+	}
+}
+
+static void kq_callback_glfw_key(GLFWwindow *win, int key, int scancode, int action, int mods) {
+	CB_UNUSED(key);
+	CB_UNUSED(scancode);
+	CB_UNUSED(action);
+	CB_UNUSED(mods);
+	kq_glfw_input(win);
+}
+
+static void kq_callback_glfw_mouse_button(GLFWwindow *win, int button, int action, int mods) {
+	CB_UNUSED(button);
+	CB_UNUSED(action);
+	CB_UNUSED(mods);
+	kq_glfw_input(win);
+}
+
+static void kq_callback_glfw_cursor_pos(GLFWwindow *win, double x, double y) {
+	CB_UNUSED(x);
+	CB_UNUSED(y);
+	kq_glfw_input(win);
+}
+
+static void kq_callback_glfw_scroll(GLFWwindow *win, double x, double y) {
+	CB_UNUSED(x);
+	CB_UNUSED(y);
+	kq_glfw_input(win);
+}
+
 
 #if KQ_DEBUG
 	#undef CB_LOG_MODULE
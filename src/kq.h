@@ -28,35 +28,507 @@
 #define KQ_TILES_IMAGE_HEIGHT 64
 #define KQ_TILES_IMAGE_SIZE   (KQ_TILES_IMAGE_WIDTH * KQ_TILES_IMAGE_HEIGHT * 4)
 
-#define KQ_TILES_VERTEX_INPUT_ATTRIBUTES_NUM 2
+#define KQ_TILES_VERTEX_INPUT_BINDINGS_NUM   2
+#define KQ_TILES_VERTEX_INPUT_ATTRIBUTES_NUM 9
 
 #define KQ_QUAD_NUM_VERTICES 4
 #define KQ_QUAD_NUM_INDICES  6
 
 #define KQTXT_FONT "EBGaramond12-Regular.otf"
 
+// Instances per instance buffer chunk. A frame allocates further chunks as it fills them, up to KQ_INSTANCE_CHUNKS_MAX.
+#define KQ_INSTANCE_CHUNK_SIZE 16384
+#define KQ_INSTANCE_CHUNKS_MAX 16
+
+// Staging memory per frame in flight, for uploads recorded while rendering (new glyphs).
+#define KQ_UPLOAD_STAGING_SIZE MiB_v(1)
+
+// The glyph atlas is repacked and grown on the render thread, not in the background. Evicting a page happens inside the
+// draw that ran out of room: a pass over the glyph cache, a sort of the page's hot glyphs, and GPU copies recorded into
+// the frame, with no wait. Growing happens at the next KQrender_begin() and waits for the device to go idle, as every
+// frame in flight samples the old image; it doubles the pages, so from KQ_GLYPH_ATLAS_LAYERS_INIT to the max that is at
+// most three stalls in a run.
+#define KQ_GLYPH_ATLAS_SIZE        1024
+#define KQ_GLYPH_ATLAS_LAYERS_INIT 2 // One page of glyphs, and the spare layer pages are repacked into.
+#define KQ_GLYPH_ATLAS_LAYERS_MAX  9 // Bounds text memory to this many KQ_GLYPH_ATLAS_SIZE^2 layers; past it, pages are evicted.
+#define KQ_GLYPH_HOT_FRAMES        120 // Glyphs used this recently are moved, not dropped, when their page is evicted.
+#define KQ_GLYPH_PADDING           1 // Empty texels around each glyph, so linear filtering never bleeds in a neighbour.
+#define KQ_GLYPH_SUBPIXEL_BUCKETS  4 // Horizontal pen positions rasterised per glyph, in fractions of a pixel.
+#define KQ_GLYPH_CACHE_INITIAL_CAP 1024
+#define KQ_SDF_BASE_PX             48 // SDF fonts generate their fields at this size, and are scaled from it when drawn.
+#define KQ_SDF_SPREAD              8 // Distance range of the fields either side of the outline, in base pixels.
+#define KQ_SDF_WORKERS_MAX         8
+#define KQ_SDF_PREBAKE_FIRST       0x20 // Codepoints whose fields are generated when an SDF font is loaded.
+#define KQ_SDF_PREBAKE_LAST        0x7E
+#define KQ_SHAPE_CACHE_ENTRIES     1024 // Shaped runs kept; a power of two, also used as the bucket count.
+#define KQ_SHAPE_CACHE_BYTES       MiB_v(1) // Cap on the text and glyph data of cached runs. Bigger runs aren't cached.
+#define KQ_SHAPE_NONE              UINT32_MAX
+#define KQ_TEXT_STYLES_MAX         16
+#define KQ_TEXT_CLEAN              UINT32_MAX
+
+// Packs a colour for kq_tile_instance.color and KQdraw_text().
+#define KQ_RGBA(r, g, b, a) ((u32)(r) | (u32)(g) << 8 | (u32)(b) << 16 | (u32)(a) << 24)
+
+// kq_tile_instance.flags; mirrored in tile.frag.
+#define KQ_INSTANCE_GLYPH  (1U << 0) // Sample the glyph atlas as coverage for color, instead of the tiles texture.
+#define KQ_INSTANCE_SDF    (1U << 1) // With KQ_INSTANCE_GLYPH: the atlas texels are signed distances, not coverage.
+#define KQ_INSTANCE_TARGET (1U << 2) // Sample the bound render target, whose texels have premultiplied alpha.
+#define KQ_INSTANCE_SCREEN (1U << 3) // Position in NDC of the viewport, ignoring the camera; also mirrored in tile.vert.
+
+// kq_tile_instance.flags from bit 16 up to the store's own: the animation clip the instance plays, plus one, so 0 plays
+// none; mirrored in tile.vert.
+#define KQ_INSTANCE_CLIP_SHIFT 16U
+#define KQ_INSTANCE_CLIP_MASK  (0x3FFFU << KQ_INSTANCE_CLIP_SHIFT)
+#define KQ_INSTANCE_CLIP(clip) (((u32)(clip) + 1U) << KQ_INSTANCE_CLIP_SHIFT)
+
+// Animation clips in the table tile.vert reads, which sits in each frame's uniform buffer past the uniforms, at an offset
+// any device's uniform buffer alignment divides; mirrored in tile.vert.
+#define KQ_ANIM_CLIPS_MAX    256U
+#define KQ_ANIM_TABLE_OFFSET 256U
+
+// Sprite store slots per dirty bit, and the slots its storage grows by: a 64-bit word of dirty bits.
+#define KQ_SPRITE_BLOCK 64U
+#define KQ_SPRITE_GROW  (KQ_SPRITE_BLOCK * 64U)
+#define KQ_SPRITE_NONE  UINT32_MAX
+
+// Staging sprite stores leave to the glyphs and text boxes drawn after them, however much of theirs is waiting to go up.
+#define KQ_SPRITE_UPLOAD_SPARE (KQ_UPLOAD_STAGING_SIZE / 4U)
+
+// Buckets a layer's spatial grid starts with; it doubles them past two sprites a bucket.
+#define KQ_SPRITE_GRID_BUCKETS 1024U
+#define KQ_SPRITE_GRID_NONE    UINT64_MAX // kq_sprite_store.grid_keys of slots in no grid.
+
+// kq_sprite_store.flags of the store's own, above the KQ_INSTANCE_* ones passed on to the instances.
+#define KQ_SPRITE_HIDDEN (1U << 30)
+#define KQ_SPRITE_FREE   (1U << 31)
+
+// Render targets alive at once; each holds one descriptor set.
+#define KQ_RENDER_TARGETS_MAX 64
+
+// Steps in the post chain. They have to fit the 128 bytes of push constants every device has, with the count and the
+// scene's scaling.
+#define KQ_POST_STEPS_MAX 7
+
+// Blurs for the post chain run in compute at 1/2 to 1/KQ_BLUR_FACTOR_MAX of the frame's resolution, the smallest
+// factor keeping them at most KQ_BLUR_HEIGHT_MAX texels tall, so their cost stays about the same at any resolution.
+#define KQ_BLUR_HEIGHT_MAX 540
+#define KQ_BLUR_FACTOR_MAX 8
+#define KQ_BLUR_RADIUS_MAX 16  // Taps either side of a texel, at the blur's resolution; mirrored in blur.comp.
+#define KQ_BLUR_GROUP      128 // Texels of a row or column each blur workgroup covers; mirrored in blur.comp.
+
+// Damage tracking compares the scene with the last frame's in cells of KQ_DAMAGE_TILE pixels, and draws again only the
+// cells that changed, merged into at most KQ_DAMAGE_RECTS_MAX rectangles.
+#define KQ_DAMAGE_TILE      32
+#define KQ_DAMAGE_RECTS_MAX 8
+#define KQ_DAMAGE_RUNS_MAX  64 // Runs of changed cells merged down to those; past it, the damage is their bounds.
+
+// Frame pacing: the slack left before the display's refresh, on top of the time recent frames took, and how long to
+// wait at most for a present to be shown, as a hidden window's may never be.
+#define KQ_PACE_MARGIN_NS       1000000ULL
+#define KQ_PACE_WAIT_TIMEOUT_NS 100000000ULL
+#define KQ_SLEEP_SPIN_NS        1000000ULL // The end of a precise sleep is spun out, as the scheduler oversleeps.
+
+// Presented frames whose latency records are kept while their display times come back with VK_GOOGLE_display_timing.
+#define KQ_LATENCY_PENDING 8
+
+// Frame rate cap while the window is unfocused, until KQbackground_fps_set() changes it.
+#define KQ_BACKGROUND_FPS_DEFAULT 10.0f
+// KQbackground_fps_set()'s fps for no cap; any negative does.
+#define KQ_BACKGROUND_FPS_UNCAPPED -1.0f
+
+// Default offscreen resolution of headless mode, if none is set before KQinit().
+#define KQ_HEADLESS_DEFAULT_WIDTH  800
+#define KQ_HEADLESS_DEFAULT_HEIGHT 600
+
+// Effects of the post chain; mirrored in post.frag. Apart from the blur they read, the effects only read the pixel they
+// write, so the whole chain runs as one fullscreen pass however long it is, without intermediate images. A chain has at
+// most one blurring effect, whose blur is computed from the frame as drawn, before any of the chain.
+typedef enum kq_post_effect {
+	KQ_POST_GRADE,     // params: saturation, contrast, brightness; 1, 1, 1 leaves the colour as it is.
+	KQ_POST_SCANLINES, // params: darkening of the dark lines from 0 to 1, and the period of the lines in scene pixels.
+	KQ_POST_VIGNETTE,  // params: darkening at the corners from 0 to 1, the radius it starts at (1 is the corners), and softness.
+	KQ_POST_BLUR,      // params: mix towards the blurred frame from 0 to 1, and the blur radius in pixels.
+	KQ_POST_BLOOM,     // params: intensity, the blur radius in pixels, and the luma threshold brightness blooms above.
+} kq_post_effect;
+
+typedef struct kq_post_step {
+	u32   effect; // kq_post_effect.
+	float params[3];
+} kq_post_step;
+
+// How the scene drawn at an internal resolution is scaled up to the window; mirrored in post.frag.
+typedef enum kq_scale_filter {
+	KQ_SCALE_NEAREST,        // By the largest whole factor that fits, centred, so every texel is the same size.
+	KQ_SCALE_SHARP_BILINEAR, // To fill the window at the same aspect ratio, blending texel edges over one pixel.
+} kq_scale_filter;
+
+// The post chain, as pushed to post.frag.
+typedef struct kq_post_push {
+	kq_post_step steps[KQ_POST_STEPS_MAX];
+	u32          count;
+	u32          filter;       // kq_scale_filter.
+	float        src_scale[2]; // Part of the scene image drawn this frame, for dynamic resolution.
+} kq_post_push;
+
+// Push constants of blur_down.comp and blur.comp, which use the fields they need.
+typedef struct kq_blur_push {
+	s32   dir[2];    // blur.comp: 1, 0 across rows, or 0, 1 down columns.
+	s32   radius;    // blur.comp: taps either side, at most KQ_BLUR_RADIUS_MAX.
+	float sigma;     // blur.comp.
+	float threshold; // blur_down.comp: luma below which texels are dropped; 0 keeps them all.
+	u32   factor;    // blur_down.comp: scene texels per blur texel, along each axis.
+} kq_blur_push;
+
+// GPU passes timed every frame, indexing kq_stats.gpu_pass_ns.
+typedef enum kq_gpu_pass {
+	KQ_GPU_PASS_SCENE, // The frame's draws, into the swapchain image or, with a post chain, the scene image.
+	KQ_GPU_PASS_BLUR,  // The post chain's compute blur; 0 without a blurring effect.
+	KQ_GPU_PASS_POST,  // The post chain's fullscreen pass; 0 without a chain.
+	KQ_GPU_PASSES,
+} kq_gpu_pass;
+
+// Timestamps per frame in flight: the start of the frame, the end of each pass, and the end of the frame.
+#define KQ_GPU_TIMESTAMPS (KQ_GPU_PASSES + 2)
+
 // Constants for the entire frame.
 typedef struct kq_uniforms {
 	alignas(4) float time;
 	alignas(4) float time_sin;
 	alignas(4) float time_cos;
+	alignas(16) vec4 camera;       // The camera as a 2x2 matrix, column-major, taking world positions to NDC...
+	alignas(8) vec2 camera_offset; // ...before this is added.
+	alignas(8) vec2 camera_snap;   // Scene size in pixels, whose grid instance centres are rounded to; 0 not to snap.
 } kq_uniforms;
 
-// Push constants for tiles.
-typedef struct kq_tiles_pcs {
+// A 2D camera over everything drawn without KQ_INSTANCE_SCREEN. Positions are in world units, which are NDC under the
+// default camera: pos lands at the centre of the viewport, zoomed by zoom and turned by rotation radians about it.
+typedef struct kq_camera {
+	float pos[2];
+	float zoom;
+	float rotation;
+	bool  snap; // Rounds each instance's centre to whole scene pixels, so scrolling and zooming don't shimmer.
+} kq_camera;
+
+// How a clip carries on past its last frame; mirrored in tile.vert.
+typedef enum kq_anim_mode {
+	KQ_ANIM_LOOP,     // From the first frame again.
+	KQ_ANIM_ONCE,     // Holds the last frame.
+	KQ_ANIM_PINGPONG, // Back down to the first frame, and up again.
+} kq_anim_mode;
+
+// An animation clip, in std140 layout for tile.vert's table. Frames step on from the instance's own layer and uv_rect:
+// frame n samples layer + n * layer_step, its uv_rect moved by n * uv_step, so one clip serves runs of layers in the
+// texture array and strips in an atlas alike, and every tile drawing a run of the same length.
+typedef struct kq_anim_clip {
+	alignas(16) vec2 uv_step;
+	alignas(4) u32 layer_step;
+	alignas(4) u32 frames; // 0 plays none, as an unset clip does.
+	alignas(4) float fps;
+	alignas(4) u32 mode; // kq_anim_mode.
+} kq_anim_clip;
+
+// Fills in the frame's uniforms at the last moment, just before the frame is submitted; see KQuniforms_latch_set().
+typedef void kq_uniforms_latch_fn(kq_uniforms u[static 1], void *user);
+
+// One quad of the batched tile pipeline, read as per-instance vertex input by tile.vert.
+typedef struct kq_tile_instance {
 	alignas(8) vec2 position;
 	alignas(8) vec2 scale;
-	alignas(4) float tiles_tex_index; // Texture arrays index with floats, for some ungodly reason.
-} kq_tiles_pcs;
+	alignas(16) vec4 uv_rect; // u0, v0, u1, v1.
+	u32   color;              // KQ_RGBA(); multiplies the sampled texel.
+	u32   layer;              // Array layer of the sampled texture.
+	u32   flags;              // KQ_INSTANCE_*.
+	float anim_start;         // With KQ_INSTANCE_CLIP(), the time its first frame shows, on kq_uniforms.time's clock.
+} kq_tile_instance;
+
+// A cached glyph bitmap in the atlas, keyed by (font, glyph id, size, subpixel bucket).
+typedef struct kq_glyph {
+	u64  key;
+	bool used;
+	u16  x, y, w, h; // Atlas texels, excluding padding. w and h are 0 for glyphs without pixels (spaces).
+	u16  layer;
+	s16  left, top; // Bitmap offset from the pen position in pixels; top points up.
+	u64  last_used; // kq_stats.frames when last drawn, for the LRU.
+} kq_glyph;
+
+// A row of the glyph atlas, filled left to right.
+typedef struct kq_atlas_shelf {
+	u16 layer;
+	u16 y, h;
+	u16 x; // Start of the free space.
+} kq_atlas_shelf;
+
+// A distance field generated off the main thread, waiting for its first use to be uploaded.
+typedef struct kq_sdf_glyph {
+	u32 glyph_id;
+	u16 w, h;
+	s16 left, top;
+	u8 *pixels; // w * h bytes, tightly packed; 0 if generation failed.
+} kq_sdf_glyph;
+
+typedef struct kq_font {
+	FT_Face       face;
+	hb_font_t    *hb_font;
+	u32           id;
+	u32           size;  // Raster size in pixels, 26.6 fixed point. KQ_SDF_BASE_PX for SDF fonts.
+	float         scale; // Drawn size over raster size; always 1 for bitmap fonts.
+	bool          sdf;
+	u32           sdf_count;
+	kq_sdf_glyph *sdf_glyphs; // Sorted by glyph_id.
+} kq_font;
+
+// A run as HarfBuzz shaped it, keyed by everything that affects shaping. Chained per hash bucket and kept in LRU order.
+typedef struct kq_shape_run {
+	u64                  hash;
+	u32                  font_id;
+	u32                  size;
+	hb_direction_t       direction; // As requested; HB_DIRECTION_INVALID (and the script and language equivalents) mean guessed.
+	hb_script_t          script;
+	hb_language_t        language;
+	u32                  text_len;
+	u32                  count;
+	hb_glyph_info_t     *infos; // Owns the run's one allocation: infos, then positions, then the text.
+	hb_glyph_position_t *positions;
+	const char          *text;
+	size_t               bytes;
+	u32                  chain;      // Next run in the bucket, or the free list; KQ_SHAPE_NONE ends either.
+	u32                  prev, next; // LRU neighbours, towards shape_lru_head (most recent) and tail.
+} kq_shape_run;
+
+// A copy into a device-local buffer, out of the frame's staging buffer or another device-local buffer.
+typedef struct kq_buffer_upload {
+	VkBuffer     src; // The frame's staging if 0.
+	VkBuffer     dst;
+	VkBufferCopy region;
+} kq_buffer_upload;
+
+typedef enum kq_text_align {
+	KQ_TEXT_ALIGN_LEFT,
+	KQ_TEXT_ALIGN_CENTER,
+	KQ_TEXT_ALIGN_RIGHT,
+} kq_text_align;
+
+typedef struct kq_text_style {
+	kq_font *font;
+	u32      rgba;
+} kq_text_style;
+
+typedef struct kq_text_line {
+	u32 start, end;             // Bytes of the box's text; end is exclusive, and includes trailing spaces or the newline.
+	u32 inst_first, inst_count; // The line's glyph instances.
+} kq_text_line;
+
+cb_mk_vec(vecshelf, kq_atlas_shelf);
+cb_mk_vec(vecregion, VkBufferImageCopy);
+cb_mk_vec(vecimgcopy, VkImageCopy);
+cb_mk_vec(vecbufupload, kq_buffer_upload);
+cb_mk_vec(vecchar, char);
+cb_mk_vec(vecu8, u8);
+cb_mk_vec(vecline, kq_text_line);
+cb_mk_vec(vecinst, kq_tile_instance);
+
+// A draw of the scene under damage tracking, recorded once the frame's damage is known.
+typedef struct kq_scene_draw {
+	VkBuffer        buf;
+	u32             first, count; // Instances of buf.
+	VkDescriptorSet set;          // Set 1.
+} kq_scene_draw;
+
+cb_mk_vec(vecscenedraw, kq_scene_draw);
+
+// An offscreen image quads and text can be drawn into, and which is then drawn as a sprite. Its contents persist across
+// frames until it is drawn into again.
+typedef struct kq_render_target {
+	VkImage         image;
+	VkDeviceMemory  mem;
+	VkImageView     view;
+	VkFramebuffer   fbo;
+	VkDescriptorSet desc_set; // Set 1 of the tile pipeline, sampling the image.
+	u32             width, height;
+	bool            valid;      // Holds a finished render; cleared by KQtarget_invalidate().
+	u64             generation; // Changes whenever the contents do, so damage tracking sees sprites of it change.
+} kq_render_target;
+
+// Retained, word-wrapped text in several styles. Edits lay out again only the lines they affect, and only the changed
+// glyph instances are uploaded to the box's own device-local instance buffer.
+typedef struct kq_text_box {
+	vecchar       *text;
+	vecu8         *text_styles; // Style index of every byte of text.
+	kq_text_style  styles[KQ_TEXT_STYLES_MAX];
+	u32            styles_count;
+	float          origin[2];   // Top left, in pixels.
+	float          width;       // Wrap width, in pixels. Words wider than this overflow.
+	float          line_height; // In pixels.
+	kq_text_align  align;
+	vecline       *lines;
+	vecinst       *instances;   // CPU copy of buf, in line order.
+	vecline       *scratch_lines;
+	vecinst       *scratch_instances;
+	u32            dirty_line;  // First line to lay out again, or KQ_TEXT_CLEAN.
+	u32            dirty_end;   // Text offset all edits lie before; layout stops at the first unchanged line boundary past it.
+	u32            upload_first, upload_end; // Instances changed since they were last uploaded.
+	float          viewport[2]; // Size the instances were laid out for, as their positions are in NDC.
+	u64            atlas_epoch;       // Of the glyph atlas the instances were laid out against.
+	u32            atlas_layers_used; // Bitmask of the atlas layers the instances sample.
+	VkBuffer       buf;
+	VkDeviceMemory buf_mem;
+	u32            buf_cap;
+	VkBuffer       retired_buf; // Outgrown buf, destroyed once the frames in flight are done with it.
+	VkDeviceMemory retired_mem;
+	u64            retired_frame;
+} kq_text_box;
+
+// One layer's spatial hash grid. Sprites are kept in the cell their centre is in, and queries look as far past a cell as
+// the largest sprite the grid has held reaches.
+typedef struct kq_sprite_grid {
+	float cell;     // Cell size, in NDC.
+	float reach[2]; // Largest half extent of its sprites.
+	u32  *heads;    // First slot of each bucket's list, or KQ_SPRITE_NONE.
+	u32   buckets;  // A power of two.
+	u32   count;
+} kq_sprite_grid;
+
+// A 2D camera transform for KQsprites_draw_transformed(): positions map to pos * scale + offset, and extents to
+// extent * scale, in NDC of the viewport. It is the whole transform: the kq_camera doesn't apply on top of it.
+typedef struct kq_sprite_xform {
+	float scale[2];
+	float offset[2];
+} kq_sprite_xform;
+
+// An instance's part in damage tracking: its hash, and the cells it covers. An animated instance's frame is mixed in as
+// it is added to the cells, so the entry holds for as long as the instance does.
+typedef struct kq_damage_entry {
+	u64   hash;
+	u16   cells[4]; // First and last column, first and last row.
+	u32   clip;     // As in KQ_INSTANCE_CLIP(); 0 for none.
+	float anim_start;
+} kq_damage_entry;
+
+// Retained sprites in structure-of-arrays storage. A sprite's handle is its slot, which keeps its place in the draw order
+// until it is removed; freed slots are reused. Only the blocks of KQ_SPRITE_BLOCK slots changed since they were last
+// uploaded are converted to instances and uploaded, to the store's own device-local instance buffer. Blocks that don't
+// fit in a frame's staging are drawn as last uploaded, and go up over the next frames in turn.
+typedef struct kq_sprite_store {
+	vec2          *positions;   // NDC, as with KQdraw_quad().
+	vec2          *scales;
+	u32           *colors;      // KQ_RGBA().
+	u32           *layers;      // Tiles texture layer.
+	u32           *flags;       // KQ_INSTANCE_* and KQ_SPRITE_*.
+	float         *anim_starts; // Of the clips in flags, as set by KQsprite_animate().
+	u32            count;       // Slots handed out, free ones included; all of them are drawn, hidden and free ones empty.
+	u32            cap;         // A multiple of KQ_SPRITE_GROW.
+	u32           *free;        // Freed slots, the last freed reused first.
+	u32            free_count;
+	u64           *dirty;       // A bit per block of slots changed since it was last uploaded.
+	u64           *blank;       // A bit per block buf holds nothing of yet, which isn't drawn.
+	u32            upload_next; // The block the next upload starts from, so a backlog goes up in turn.
+
+	// Spatial index, from KQsprites_grid_enable() on: a grid per layer, each slot in its layer's grid.
+	float           grid_cell; // Cell size of layers not given their own; 0 without an index.
+	kq_sprite_grid *grids;     // By layer.
+	u32             grids_count;
+	u64            *grid_keys; // Cell of each slot, or KQ_SPRITE_GRID_NONE.
+	u32            *grid_next; // Each slot's neighbours in its bucket's list, or KQ_SPRITE_NONE.
+	u32            *grid_prev;
+	u64            *visible;   // A bit per block to draw, while drawing: uploaded, and with culling, in the viewport.
+
+	// Damage tracking's view of buf, so a frame costs only what was uploaded since.
+	kq_damage_entry *damage;        // KQ_SPRITE_BLOCK per block, the first damage_counts of each in use.
+	u8              *damage_counts; // Per block.
+	u64             *damage_stale;  // A bit per block whose entries need working out again.
+	u64              damage_key;    // The camera and scene size the entries were worked out under.
+	bool             animated;      // Some sprite may be playing a clip.
+	VkBuffer       buf;
+	VkDeviceMemory buf_mem;
+	u32            buf_cap;
+	VkBuffer       retired_buf; // Outgrown buf, destroyed once the frames in flight are done with it.
+	VkDeviceMemory retired_mem;
+	u64            retired_frame;
+} kq_sprite_store;
+
+// When each stage of a frame happened, in kqvk_now_ns() nanoseconds; subtract input_ns for the latency up to it. 0 for
+// stages the frame did not reach or that could not be measured.
+typedef struct kq_latency {
+	u64 frame;      // The frames value the record belongs to.
+	u64 input_ns;   // The oldest input the frame consumed, as GLFW delivered it; 0 if it consumed none.
+	u64 begin_ns;   // KQrender_begin() entry, before throttling and pacing.
+	u64 acquire_ns; // Swapchain image acquired.
+	u64 submit_ns;  // Frame submitted.
+	u64 present_ns; // vkQueuePresentKHR() returned.
+	u64 display_ns; // The image was shown, with VK_GOOGLE_display_timing, whose clock is CLOCK_MONOTONIC on Linux drivers.
+} kq_latency;
+
+// Per-frame counters, updated by KQrender_begin()/KQrender_end(). Read-only for users.
+typedef struct kq_stats {
+	u64 frames;        // Frames submitted since KQinit().
+	u32 draw_calls;    // Draw calls recorded in the last frame.
+	u32 quads;         // Quads drawn in the last frame, glyphs included.
+	u32 glyph_uploads; // Glyphs rasterised into the atlas in the last frame.
+	u32 shape_hits;    // KQdraw_text() calls in the last frame served from the shaped-run cache...
+	u32 shape_misses;  // ...and those that had to run HarfBuzz.
+	u32 text_lines;    // Text box lines laid out in the last frame.
+	u32 atlas_repacks; // Glyph atlas pages evicted in the last frame.
+	u64 cpu_frame_ns;  // KQrender_begin() entry to KQrender_end() exit, for the last frame.
+	u64 cpu_wait_ns;   // Part of cpu_frame_ns spent waiting on the frame's fence.
+	u64 gpu_frame_ns;  // GPU time between the first and last command of frame gpu_frame; 0 without timestamp support.
+	u64 gpu_pass_ns[KQ_GPU_PASSES]; // Part of gpu_frame_ns spent in each kq_gpu_pass.
+	u64 gpu_frame;     // The frames value gpu_frame_ns belongs to; results lag by KQ_FRAMES_IN_FLIGHT.
+	u32 scene_width;   // Resolution the last frame's scene was drawn at.
+	u32 scene_height;
+	u32 damage_px;     // Scene pixels drawn again in the last frame under damage tracking; 0 when nothing changed.
+	kq_latency latency; // Of the latest frame whose record is complete: submitted headless, presented, or shown with display timing.
+} kq_stats;
 
 typedef struct kq_data {
 	bool   rendering;
 	size_t current_frame;
 	u32    img_index;
 
+	kq_stats stats;
+	u64      frame_begin_ns;
+	bool     present_immediate; // Set before KQinit() to present uncapped (VK_PRESENT_MODE_IMMEDIATE_KHR), if supported.
+	bool     render_passes;     // Set before KQinit() to use render passes and framebuffers even where dynamic rendering works.
+
 	GLFWwindow *win;
 	bool        fb_resized;
 
+	// Event-driven scheduling: KQframe_wait() lets a frame be drawn only once something asked for one.
+	bool   redraw;              // Set by KQredraw(), input, the window changing, and frames that had to drop something.
+	double redraw_deadline;     // glfwGetTime() of the earliest KQredraw_at() pending...
+	bool   has_redraw_deadline; // ...if there is one. A flag rather than INFINITY, which -ffinite-math-only can't compare.
+
+	// Throttling: KQrender_begin() holds frames back while the window is iconified, or to background_fps unfocused.
+	bool  focused;
+	bool  iconified;
+	float background_fps; // As set by KQbackground_fps_set().
+
+	// Frame pacing: KQrender_begin() waits to start each frame just in time for the display's next refresh.
+	bool  pacing;
+	float pacing_fps;       // Rate of the sleeping fallback; 0 is the monitor's refresh rate.
+	u64   refresh_ns;       // Display refresh period, as measured from presents being shown.
+	u64   pace_work_ns;     // Smoothed CPU and GPU time of recent frames.
+	u64   pace_next_ns;     // kqvk_now_ns() the sleeping fallback starts the next frame at.
+	u64   present_id;       // Of the last present to the swapchain, with VK_KHR_present_id.
+	u64   present_shown_ns; // kqvk_now_ns() when the last present waited on was seen shown; 0 if none was.
+
+	// Input-to-photon latency, for stats.latency.
+	u64        input_ns;                            // kqvk_now_ns() of the oldest input no frame has consumed yet; 0 if none.
+	kq_latency latency_cur;                         // Of the frame being rendered.
+	kq_latency latency_pending[KQ_LATENCY_PENDING]; // Presented frames awaiting display times, by frame % KQ_LATENCY_PENDING.
+
+	// Headless mode: set before KQinit() to render into offscreen images, without GLFW, a window, or a surface.
+	bool           headless;
+	u32            headless_width;  // 0 means KQ_HEADLESS_DEFAULT_WIDTH.
+	u32            headless_height; // 0 means KQ_HEADLESS_DEFAULT_HEIGHT.
+	double         headless_time;   // Fed to the uniforms instead of glfwGetTime(), so frames are reproducible.
+	VkExtent2D     headless_extent;
+	VkDeviceMemory headless_imgs_mem[KQ_FRAMES_IN_FLIGHT];
+	VkBuffer       readback_bufs[KQ_FRAMES_IN_FLIGHT];
+	VkDeviceMemory readback_bufs_mem[KQ_FRAMES_IN_FLIGHT];
+	void          *readback_bufs_mapped[KQ_FRAMES_IN_FLIGHT];
+	size_t         readback_frame; // Frame whose readback buffer holds the last finished image.
+	bool           readback_ready;
+
 	// Vulkan.
 	VkInstance               vk_ins;
 	VkSurfaceKHR             vk_surface;
@@ -69,7 +541,7 @@ typedef struct kq_data {
 	u32            swapchain_img_count;
 	VkImage       *swapchain_imgs;
 	VkImageView   *swapchain_img_views;
-	VkFramebuffer *fbos;
+	VkFramebuffer *fbos; // Null with dynamic rendering.
 
 	// Queues.
 	VkQueue q_graphics;
@@ -103,7 +575,13 @@ typedef struct kq_data {
 	VkDeviceMemory uniform_bufs_mem[KQ_FRAMES_IN_FLIGHT];
 	void          *uniform_bufs_mapped[KQ_FRAMES_IN_FLIGHT];
 
-	kq_uniforms uniforms;
+	kq_uniforms           uniforms;            // Written to the frame's uniform buffer as it is submitted, so may change until then.
+	kq_camera             camera;              // As set by KQcamera_set(); uniforms.camera* follow it.
+	kq_uniforms_latch_fn *uniforms_latch;      // As set by KQuniforms_latch_set().
+	void                 *uniforms_latch_user;
+	kq_anim_clip          anim_clips[KQ_ANIM_CLIPS_MAX]; // As set by KQanim_clip_set().
+	u32                   anim_stale;                    // A bit per frame in flight whose copy of anim_clips is out of date.
+	double                anim_time;                     // The frame's start, which its animations are worked out at on the CPU.
 
 	// Tiles.
 	VkShaderModule tiles_vert_module;
@@ -112,13 +590,149 @@ typedef struct kq_data {
 	VkDeviceMemory tiles_tex_mem;
 	VkImageView    tiles_tex_view;
 	VkSampler      tiles_tex_sampler;
-	kq_tiles_pcs   tiles_pcs;
+
+	// Batched quads: instances are written straight into host-visible chunks and drawn with one call per flush.
+	VkBuffer          instance_bufs[KQ_FRAMES_IN_FLIGHT][KQ_INSTANCE_CHUNKS_MAX];
+	VkDeviceMemory    instance_bufs_mem[KQ_FRAMES_IN_FLIGHT][KQ_INSTANCE_CHUNKS_MAX];
+	kq_tile_instance *instance_bufs_mapped[KQ_FRAMES_IN_FLIGHT][KQ_INSTANCE_CHUNKS_MAX];
+	u32               instance_chunks_count[KQ_FRAMES_IN_FLIGHT]; // Chunks allocated for each frame in flight.
+	u32               instance_chunk;                             // Chunk being filled this frame.
+	u32               instance_count;                             // Instances written to it.
+	u32               batch_first;                                // First of those not drawn yet.
+
+	// Uploads recorded while rendering, submitted ahead of the frame's own command buffer.
+	VkCommandBuffer upload_cmd_buf[KQ_FRAMES_IN_FLIGHT];
+	VkBuffer        upload_bufs[KQ_FRAMES_IN_FLIGHT];
+	VkDeviceMemory  upload_bufs_mem[KQ_FRAMES_IN_FLIGHT];
+	u8             *upload_bufs_mapped[KQ_FRAMES_IN_FLIGHT];
+	VkDeviceSize    upload_used;
+	vecbufupload   *buffer_uploads; // Copies out of this frame's staging buffer into device-local buffers.
+	VkCommandBuffer submit_cmd_bufs[3];
+
+	// Where draws are recorded: the frame's command buffer, or target_cmd_buf between KQtarget_begin() and KQtarget_end().
+	VkCommandBuffer draw_cmd_buf;
+
+	// Render targets. Their passes are recorded into a command buffer of their own, submitted ahead of the frame's.
+	VkRenderPass          target_pass;
+	VkRenderPass          target_load_pass; // target_pass, keeping the contents; for post_scene under damage tracking.
+	VkDescriptorSetLayout target_set_layout;
+	VkDescriptorPool      target_desc_pool;
+	VkDescriptorSet       target_default_set; // Bound when no target is, as the pipeline layout always has set 1.
+	VkSampler             target_sampler;
+	VkCommandBuffer       target_cmd_buf[KQ_FRAMES_IN_FLIGHT];
+	bool                  targets_recorded; // target_cmd_buf was begun this frame.
+	kq_render_target     *target_active;
+	VkDescriptorSet       target_set_bound; // Set 1 as bound in draw_cmd_buf.
+	VkDescriptorSet       target_set_outer; // ...and in the frame's command buffer, while a target is active.
+	VkViewport            outer_viewport;
+	VkRect2D              outer_scissor;
+
+	// Post chain: with one set, the frame is drawn into post_scene, which a fullscreen triangle draws to the swapchain image.
+	kq_post_push     post_chain; // As last set by KQpost_set().
+	kq_post_push     post_push;  // The chain for this frame, latched from post_chain by KQrender_begin().
+	bool             post_on;
+	u32              post_blur_step; // Index of the frame's blurring step, or KQ_POST_STEPS_MAX without one.
+	kq_render_target post_scene;
+	VkShaderModule   post_vert_module;
+	VkShaderModule   post_frag_module;
+	VkPipelineLayout post_pipeline_layout;
+	VkPipeline       post_pipeline;
+
+	// Internal resolution: the scene is laid out at internal_base and drawn at internal_scale of it into post_scene, which
+	// the post pass scales up into internal_dst of the window.
+	VkExtent2D internal_base;      // As set by KQinternal_res_set(); 0 x 0 is the window's resolution.
+	u32        internal_filter;    // kq_scale_filter.
+	u64        internal_budget_ns; // GPU frame time internal_scale is controlled towards; 0 keeps it at 1.
+	float      internal_scale_min;
+	float      internal_scale;
+	u64        internal_changed;  // stats.frames when internal_scale last changed; older GPU times predate it.
+	bool       internal_on;       // For this frame.
+	VkViewport internal_viewport; // The drawn part of post_scene...
+	VkRect2D   internal_scissor;
+	VkViewport internal_dst;    // ...and where it goes in the window.
+	VkViewport window_viewport; // The window's, while viewport is internal_base's during the scene.
+	VkRect2D   window_scissor;
+
+	// Damage tracking: the scene is kept in post_scene between frames. Its draws are logged rather than recorded, while
+	// every instance is hashed into the cells it covers; once they are all in, the log is replayed only over the cells
+	// whose hash differs from the last frame's.
+	bool           damage_tracking; // As set by KQdamage_tracking_set().
+	bool           damage_on;       // For this frame.
+	bool           damage_full;     // post_scene holds nothing to keep; draw all of it.
+	bool           damage_window;   // The next present changes the whole window, whatever the scene's damage.
+	VkExtent2D     damage_extent;   // Of the scene the cells cover.
+	u32            damage_cols, damage_rows;
+	u64           *damage_cells; // This frame's hashes, then the last frame's, damage_cols * damage_rows of each.
+	u32            damage_rects_count;
+	VkRect2D       damage_rects[KQ_DAMAGE_RECTS_MAX];   // In post_scene's pixels.
+	VkRectLayerKHR damage_present[KQ_DAMAGE_RECTS_MAX]; // The same in the window's, for VK_KHR_incremental_present.
+	kq_post_push   damage_post_last;                    // The last frame's chain; changing it changes the whole window.
+	vecscenedraw  *scene_draws;
+	u64            targets_drawn; // Render target generations handed out.
+
+	// The post chain's blur: post_scene downsampled into blur_imgs[0], then blurred across into [1] and back down into [0].
+	VkDescriptorSetLayout blur_set_layout;
+	VkDescriptorPool      blur_desc_pool;
+	VkDescriptorSet       blur_sets[3]; // Source and destination of each of those three dispatches.
+	VkDescriptorSet       blur_post_set; // blur_imgs[0] as set 1 of the post pipeline; target_default_set without a blur.
+	VkPipelineLayout      blur_pipeline_layout;
+	VkShaderModule        blur_down_module;
+	VkShaderModule        blur_module;
+	VkPipeline            blur_down_pipeline;
+	VkPipeline            blur_pipeline;
+	VkImage               blur_imgs[2];
+	VkDeviceMemory        blur_imgs_mem[2];
+	VkImageView           blur_views[2];
+	VkExtent2D            blur_extent;
+	u32                   blur_factor;
+
+	// Text.
+	FT_Library      ft_lib;
+	hb_buffer_t    *hb_buf;
+	u32             fonts_loaded;
+	VkImage         glyph_atlas_image;
+	VkDeviceMemory  glyph_atlas_mem;
+	VkImageView     glyph_atlas_view;
+	VkSampler       glyph_atlas_sampler;
+	kq_glyph       *glyphs; // Open addressing, glyphs_cap (a power of two) slots.
+	size_t          glyphs_cap;
+	size_t          glyphs_count;
+	vecshelf       *atlas_shelves;
+	vecimgcopy     *atlas_moves; // Hot glyphs being moved into atlas_spare this frame.
+	u32             atlas_layers; // Pages, plus the spare.
+	u32             atlas_spare; // The layer that holds no glyphs, and is repacked into.
+	u32             atlas_next_y[KQ_GLYPH_ATLAS_LAYERS_MAX]; // Top of each layer's unshelved space.
+	u64             atlas_layer_used[KQ_GLYPH_ATLAS_LAYERS_MAX]; // kq_stats.frames when last sampled, for the LRU.
+	u64             atlas_epoch; // Bumped whenever glyphs move or leave the atlas.
+	bool            atlas_grow_pending; // Full; grow at the next KQrender_begin().
+	bool            atlas_repacked; // At most one page is evicted per frame.
+	u32             atlas_repack_layer; // The layer cleared and moved into this frame, if atlas_repacked.
+	vecregion      *atlas_regions; // Copies out of this frame's staging buffer into the atlas.
+	kq_shape_run   *shape_runs;    // KQ_SHAPE_CACHE_ENTRIES of them.
+	u32             shape_buckets[KQ_SHAPE_CACHE_ENTRIES];
+	u32             shape_free;
+	u32             shape_lru_head, shape_lru_tail;
+	u32             shape_count;
+	size_t          shape_bytes;
 
 	// Synchronization primitives.
 	VkSemaphore img_available_semaphore[KQ_FRAMES_IN_FLIGHT];
 	VkSemaphore render_finished_semaphore[KQ_FRAMES_IN_FLIGHT];
 	VkFence     in_flight_fence[KQ_FRAMES_IN_FLIGHT];
 
+	// GPU frame timing: KQ_GPU_TIMESTAMPS timestamps per frame in flight.
+	VkQueryPool timestamp_pool;
+	double      timestamp_period; // Nanoseconds per tick.
+	u64         timestamp_mask;   // Valid bits of the graphics queue's timestamps.
+	u64         timestamp_frame[KQ_FRAMES_IN_FLIGHT]; // stats.frames value written by each set, 0 if unused.
+
+	// Optional device extensions and features.
+	bool has_memory_budget;
+	bool has_incremental_present;
+	bool has_present_wait;  // VK_KHR_present_id and VK_KHR_present_wait, with their features.
+	bool has_display_timing;
+	bool dynamic_rendering; // Passes begin with vkCmdBeginRendering(); there are no render passes or framebuffers.
+
 #if KQ_DEBUG
 	VkDebugUtilsMessengerEXT dbg_messenger;
 #endif
@@ -152,6 +766,12 @@ typedef struct kq_info {
 	VkRenderPassCreateInfo                 pass_cinfo;
 	VkGraphicsPipelineCreateInfo           graphics_pipeline_cinfo;
 	VkFramebufferCreateInfo                fbo_cinfo;
+	VkPhysicalDeviceVulkan13Features       pdev_feats13;
+	VkPipelineRenderingCreateInfo          pipeline_rendering_cinfo;
+	VkRenderingAttachmentInfo              rendering_attachment;
+	VkRenderingInfo                        rendering_info;
+	VkPhysicalDevicePresentWaitFeaturesKHR pdev_present_wait_feats;
+	VkPhysicalDevicePresentIdFeaturesKHR   pdev_present_id_feats;
 #if KQ_DEBUG
 	VkDebugUtilsMessengerCreateInfoEXT debug_messenger_cinfo;
 #endif
@@ -164,15 +784,28 @@ typedef struct kq_info {
 	VkFenceCreateInfo                 fence_cinfo;
 	VkSubmitInfo                      submit_info;
 	VkPipelineStageFlagBits           submit_dst_stage_mask;
-	VkSubpassDependency               subpass_dep;
+	union {
+		VkSubpassDependency subpass_deps[2];
+		struct {
+			VkSubpassDependency subpass_dep;
+			VkSubpassDependency subpass_dep_readback; // Headless only: orders the readback copy after rendering.
+		};
+	};
 	VkPresentInfoKHR                  present_info;
-	VkVertexInputBindingDescription   tiles_vertex_input_binding_desc;
+	VkPresentRegionKHR                present_region;
+	VkPresentRegionsKHR               present_regions;
+	VkPresentIdKHR                    present_ids;
+	VkPresentTimeGOOGLE               present_time;
+	VkPresentTimesInfoGOOGLE          present_times;
+	VkVertexInputBindingDescription   tiles_vertex_input_binding_descs[KQ_TILES_VERTEX_INPUT_BINDINGS_NUM];
 	VkVertexInputAttributeDescription tiles_vertex_input_attrib_descs[KQ_TILES_VERTEX_INPUT_ATTRIBUTES_NUM];
 	union {
-		VkDescriptorSetLayoutBinding layout_bindings[2];
+		VkDescriptorSetLayoutBinding layout_bindings[4];
 		struct {
 			VkDescriptorSetLayoutBinding ubo_layout_binding;
 			VkDescriptorSetLayoutBinding sampler_layout_binding;
+			VkDescriptorSetLayoutBinding glyph_atlas_layout_binding;
+			VkDescriptorSetLayoutBinding anim_layout_binding;
 		};
 	};
 	VkDescriptorSetLayoutCreateInfo descriptor_set_layout_cinfo;
@@ -180,13 +813,44 @@ typedef struct kq_info {
 	VkDescriptorPoolCreateInfo      desc_pool_cinfo;
 	VkDescriptorSetAllocateInfo     desc_sets_ainfo;
 	VkDescriptorBufferInfo          desc_binfo;
-	VkWriteDescriptorSet            desc_write[2];
+	VkDescriptorBufferInfo          anim_binfo;
+	VkWriteDescriptorSet            desc_write[4];
 	VkDescriptorImageInfo           sampler_write;
+	VkDescriptorImageInfo           glyph_atlas_sampler_write;
 	VkPhysicalDeviceFeatures        pdev_feats;
-	VkPushConstantRange             tiles_pc_range;
 	VkImageCreateInfo               tiles_tex_image_cinfo;
 	VkImageViewCreateInfo           tiles_tex_view_cinfo;
 	VkSamplerCreateInfo             tiles_tex_sampler_cinfo;
+	VkImageViewCreateInfo           glyph_atlas_view_cinfo;
+	VkSamplerCreateInfo             glyph_atlas_sampler_cinfo;
+	VkAttachmentDescription         target_color_attachment;
+	VkSubpassDependency             target_subpass_deps[2];
+	VkRenderPassCreateInfo          target_pass_cinfo;
+	VkAttachmentDescription         target_load_color_attachment;
+	VkRenderPassCreateInfo          target_load_pass_cinfo;
+	VkRenderPassBeginInfo           target_pass_begin_info;
+	VkDescriptorSetLayoutBinding    target_layout_binding;
+	VkDescriptorSetLayoutCreateInfo target_set_layout_cinfo;
+	VkDescriptorPoolSize            target_desc_pool_size;
+	VkDescriptorPoolCreateInfo      target_desc_pool_cinfo;
+	VkImageViewCreateInfo           target_view_cinfo;
+	VkSamplerCreateInfo             target_sampler_cinfo;
+
+	VkPipelineShaderStageCreateInfo      post_shader_stages_cinfo[2];
+	VkPipelineVertexInputStateCreateInfo post_vertex_input_state_cinfo;
+	VkPipelineColorBlendAttachmentState  post_color_blend_attachment_state;
+	VkPipelineColorBlendStateCreateInfo  post_color_blend_cinfo;
+	VkPushConstantRange                  post_push_range;
+	VkPipelineLayoutCreateInfo           post_pipeline_layout_cinfo;
+	VkGraphicsPipelineCreateInfo         post_pipeline_cinfo;
+	VkDescriptorSetLayoutBinding         blur_layout_bindings[2];
+	VkDescriptorSetLayoutCreateInfo      blur_set_layout_cinfo;
+	VkDescriptorPoolSize                 blur_desc_pool_sizes[2];
+	VkDescriptorPoolCreateInfo           blur_desc_pool_cinfo;
+	VkPushConstantRange                  blur_push_range;
+	VkPipelineLayoutCreateInfo           blur_pipeline_layout_cinfo;
+	VkComputePipelineCreateInfo          blur_pipeline_cinfo;
+	VkImageViewCreateInfo                blur_view_cinfo;
 } kq_info;
 
 typedef struct kq_vertex {
@@ -213,4 +877,212 @@ extern bool KQrender_end(kq_data kq[static 1]);
 
 extern bool KQdraw_quad(kq_data kq[static 1], const float pos[restrict static 2], const float scale[restrict static 2], u32 tiles_tex_index);
 
+// Draws a quad playing clip from its tiles_tex_index on, as if started at start on kq_uniforms.time's clock; see
+// KQanim_clip_set().
+extern bool KQdraw_quad_animated(kq_data     kq[static 1],
+                                 const float pos[restrict static 2],
+                                 const float scale[restrict static 2],
+                                 u32         tiles_tex_index,
+                                 u32         clip,
+                                 float       start);
+
+// Loads a font at a pixel size. Fonts must be destroyed before KQstop().
+extern bool KQfont_load(kq_data kq[restrict static 1], kq_font font[restrict static 1], const char path[restrict static 1], float px_size);
+
+// Loads a font as signed distance fields, generated once on worker threads and drawable at any size from the same atlas
+// entries. Glyphs outside KQ_SDF_PREBAKE_FIRST..LAST are generated on the calling thread on first use.
+extern bool KQfont_load_sdf(kq_data kq[restrict static 1], kq_font font[restrict static 1], const char path[restrict static 1], float px_size);
+
+// Changes the drawn size of an SDF font; nothing is rasterised again.
+extern bool KQfont_set_size(kq_font font[static 1], float px_size);
+
+extern void KQfont_destroy(kq_font font[static 1]);
+
+// Shapes and draws one line of UTF-8 text, with the baseline starting at pos (NDC). Glyphs are rasterised once and cached.
+extern bool KQdraw_text(kq_data     kq[restrict static 1],
+                        kq_font     font[restrict static 1],
+                        const char  text[restrict static 1],
+                        const float pos[restrict static 2],
+                        u32         rgba);
+
+// An empty text box with its top left corner at origin (pixels), wrapping at width pixels.
+extern bool KQtext_box_create(kq_text_box   box[restrict static 1],
+                              const float   origin[restrict static 2],
+                              float         width,
+                              float         line_height,
+                              kq_text_align align);
+
+// Waits for the device, as frames in flight may still be drawing the box.
+extern void KQtext_box_destroy(kq_data kq[restrict static 1], kq_text_box box[restrict static 1]);
+
+// Registers a style for the box's text, returning its index in style.
+extern bool KQtext_box_add_style(kq_text_box box[restrict static 1], kq_font font[restrict static 1], u32 rgba, u32 style[restrict static 1]);
+
+// Inserts UTF-8 text before byte at, in the given style. '\n' breaks lines.
+extern bool KQtext_box_insert(kq_text_box box[restrict static 1], u32 at, const char text[restrict static 1], u32 style);
+
+extern bool KQtext_box_append(kq_text_box box[restrict static 1], const char text[restrict static 1], u32 style);
+
+// Removes len bytes starting at byte at.
+extern bool KQtext_box_erase(kq_text_box box[restrict static 1], u32 at, u32 len);
+
+// Lays out the lines edits affected, uploads their instances, and draws the whole box in one draw call.
+extern bool KQtext_box_draw(kq_data kq[restrict static 1], kq_text_box box[restrict static 1]);
+
+extern bool KQsprites_create(kq_sprite_store store[static 1]);
+
+// Waits for the device, as frames in flight may still be drawing the store's instances.
+extern void KQsprites_destroy(kq_data kq[restrict static 1], kq_sprite_store store[restrict static 1]);
+
+// Adds a visible, white sprite, drawn after those added before it unless it reuses a removed one's slot.
+extern bool KQsprite_add(kq_sprite_store store[restrict static 1],
+                         const float     pos[restrict static 2],
+                         const float     scale[restrict static 2],
+                         u32             layer,
+                         u32             handle[restrict static 1]);
+
+extern void KQsprite_remove(kq_sprite_store store[static 1], u32 handle);
+
+extern void KQsprite_move(kq_sprite_store store[restrict static 1], u32 handle, const float pos[restrict static 2]);
+
+// Sets all of a sprite's state but its clip's start time; flags are KQ_INSTANCE_*, KQ_INSTANCE_CLIP() and
+// KQ_SPRITE_HIDDEN. Fails only if a new layer's grid can't be made.
+extern bool KQsprite_set(kq_sprite_store store[restrict static 1],
+                         u32             handle,
+                         const float     pos[restrict static 2],
+                         const float     scale[restrict static 2],
+                         u32             rgba,
+                         u32             layer,
+                         u32             flags);
+
+// Plays clip on the sprite from its layer on, as if started at start on kq_uniforms.time's clock, or stops it with
+// KQ_SPRITE_NONE. The GPU picks each frame from then on; the sprite doesn't change again until set again.
+extern void KQsprite_animate(kq_sprite_store store[static 1], u32 handle, u32 clip, float start);
+
+// Uploads the blocks changed since the last draw, as far as the frame's staging goes, and draws every slot in one draw
+// call, or with a spatial index, each run of blocks holding sprites in the viewport. Blocks still waiting to go up are drawn
+// as they were, or not at all if they never went up.
+extern bool KQsprites_draw(kq_data kq[restrict static 1], kq_sprite_store store[restrict static 1]);
+
+// Transforms every sprite by xf, culls it to the viewport, and writes the visible ones straight into the frame's instance
+// memory as KQ_INSTANCE_SCREEN, with AVX2, SSE2 or scalar code as the CPU allows. For stores whose sprites mostly move
+// every frame: it uploads nothing, and ignores the store's grid and the camera.
+extern bool KQsprites_draw_transformed(kq_data               kq[restrict static 1],
+                                       const kq_sprite_store store[restrict static 1],
+                                       const kq_sprite_xform xf[restrict static 1]);
+
+// Indexes the sprites in a spatial hash grid per layer, of cells cell wide in NDC unless KQsprites_grid_cell_set() gave
+// the layer its own size. Moves then update the index in O(1), draws cull, and queries skip what is far away.
+extern bool KQsprites_grid_enable(kq_sprite_store store[static 1], float cell);
+
+// Sets a layer's cell size, best about the size of its sprites, and indexes its sprites again.
+extern bool KQsprites_grid_cell_set(kq_sprite_store store[static 1], u32 layer, float cell);
+
+// Writes up to cap handles of the visible sprites whose bounds overlap the rectangle from min to max, in no particular
+// order, and returns how many there are. Bounds span scale either side of the position, as the quads do.
+extern u32 KQsprites_query_rect(const kq_sprite_store store[restrict static 1],
+                                const float           min[restrict static 2],
+                                const float           max[restrict static 2],
+                                u32                   cap,
+                                u32                   handles[restrict cap]);
+
+// The topmost visible sprite over pos, or KQ_SPRITE_NONE; for hover and click.
+extern u32 KQsprites_query_point(const kq_sprite_store store[restrict static 1], const float pos[restrict static 2]);
+
+// An offscreen render target of width x height pixels, cleared to transparent. Targets must be destroyed before KQstop().
+extern bool KQtarget_create(kq_data kq[restrict static 1], kq_render_target target[restrict static 1], u32 width, u32 height);
+
+// Waits for the device, as frames in flight may still be drawing into or from the target.
+extern void KQtarget_destroy(kq_data kq[restrict static 1], kq_render_target target[restrict static 1]);
+
+// Between KQrender_begin() and KQrender_end(), sends further draws into the target, cleared first, instead of the frame.
+// Positions are NDC of the target. Targets don't nest, and one can't be drawn from while it is drawn into.
+extern bool KQtarget_begin(kq_data kq[restrict static 1], kq_render_target target[restrict static 1]);
+
+// Sends draws back to the frame, and marks the target valid.
+extern bool KQtarget_end(kq_data kq[static 1]);
+
+// Marks the contents stale, for callers that only render a target again when !target->valid.
+extern void KQtarget_invalidate(kq_render_target target[static 1]);
+
+// Draws the target as a sprite, like KQdraw_quad(), tinted by rgba. Consecutive draws of the same target share a batch.
+extern bool KQdraw_target(kq_data                kq[restrict static 1],
+                          const kq_render_target target[restrict static 1],
+                          const float            pos[restrict static 2],
+                          const float            scale[restrict static 2],
+                          u32                    rgba);
+
+// Sets the post chain, applied in order to the whole frame from the next KQrender_begin(); count 0 turns it off.
+extern bool KQpost_set(kq_data kq[static 1], u32 count, const kq_post_step steps[count]);
+
+// Draws the scene at width x height from the next KQrender_begin(), scaling it up to the window with filter. Everything
+// is laid out in that resolution's pixels, including text. 0 x 0 is the window's resolution, and without a budget turns
+// internal resolution off.
+extern bool KQinternal_res_set(kq_data kq[static 1], u32 width, u32 height, kq_scale_filter filter);
+
+// Lowers the resolution the scene is actually drawn at, down to min_scale of KQinternal_res_set()'s on each axis, while
+// the GPU takes longer than budget_ns a frame, and raises it back when there is room; 0 turns this off. Layout keeps
+// the set resolution. Needs GPU timestamps.
+extern bool KQinternal_res_budget(kq_data kq[static 1], u64 budget_ns, float min_scale);
+
+// With on, from the next KQrender_begin(), only the parts of the scene that changed since the last frame are drawn
+// again, and only those are presented where VK_KHR_incremental_present is available. Draws are compared by what they
+// draw, not by what they sample, except for render targets, so the tiles texture must not change while it is on.
+extern void KQdamage_tracking_set(kq_data kq[static 1], bool on);
+
+// Device memory in use by this process across all heaps, or 0 without VK_EXT_memory_budget.
+extern VkDeviceSize KQdevice_mem_usage(kq_data kq[static 1]);
+
+// Asks KQframe_wait() for a frame as soon as possible, for state the frame shows having changed.
+extern void KQredraw(kq_data kq[static 1]);
+
+// Asks KQframe_wait() for a frame at time, in glfwGetTime() seconds, for animations and timers; the earliest time wins.
+extern void KQredraw_at(kq_data kq[static 1], double time);
+
+// Windowed only. Handles window events, blocking in glfwWaitEventsTimeout() until a frame is asked for: by KQredraw(),
+// KQredraw_at()'s time coming, input, or the window being resized or exposed. Returns false once the window should
+// close. Returning consumes the requests, so running animations ask again every frame. Apps that replace GLFW's input
+// callbacks call KQredraw() from theirs.
+extern bool KQframe_wait(kq_data kq[static 1]);
+
+// Caps the frame rate while the window is unfocused to fps frames a second, KQ_BACKGROUND_FPS_DEFAULT until set; 0
+// pauses rendering until focus returns, and KQ_BACKGROUND_FPS_UNCAPPED lifts the cap. KQrender_begin() waits the cap
+// out, handling events meanwhile, and while the window is iconified waits for it to be restored. GLFW reports no
+// occlusion, so a covered window is throttled only as far as the window system takes its focus.
+extern void KQbackground_fps_set(kq_data kq[static 1], float fps);
+
+// Windowed only. With on, KQrender_begin() starts each frame just in time for the display's next refresh, rather than
+// as soon as a frame in flight is done, so frames come at an even rate and show fresher input. With VK_KHR_present_wait
+// it waits for the last frame to be shown, then for the refresh after it less the time recent frames took; without, a
+// precise sleep holds frames to fps, or to the monitor's refresh rate if fps is 0.
+extern void KQpacing_set(kq_data kq[static 1], bool on, float fps);
+
+// Moves the camera, for the whole of the frame being drawn, or of the next one if none is. Scrolling a static world thus
+// changes one uniform rather than every instance. Draws into render targets go through the camera too. Under damage
+// tracking, the camera must be set before anything is drawn, as the damage is worked out as the draws come in.
+extern void KQcamera_set(kq_data kq[static 1], const kq_camera camera[static 1]);
+
+// KQrender_end() calls fn, if not null, after recording the frame and just before submitting it, with the frame's
+// uniforms as they stand, time already updated. What it writes is what the GPU renders with; sampling input there rather
+// than before drawing keeps it as fresh as the frame can show. The camera is the exception: sprite grids cull and damage
+// tracking hashes under it as things are drawn, so it must be set with KQcamera_set() before then, and the camera* fields
+// are put back as they were after fn returns (debug builds log the attempt).
+extern void KQuniforms_latch_set(kq_data kq[static 1], kq_uniforms_latch_fn *fn, void *user);
+
+// Sets animation clip number clip, below KQ_ANIM_CLIPS_MAX, for instances drawn with KQ_INSTANCE_CLIP(clip) from the next
+// frame submitted on; instances already drawn with it change too. Their frames are worked out by tile.vert from the
+// frame's time, so animating costs no CPU time per frame. Drawing them asks KQframe_wait() for a frame as the next of
+// them turns over. Under damage tracking, only cells whose frame turned over are drawn, and only instances on the scene
+// ask for frames.
+extern bool KQanim_clip_set(kq_data kq[restrict static 1], u32 clip, const kq_anim_clip c[restrict static 1]);
+
+// Takes effect at the next KQrender_begin(). Windowed mode calls this itself on framebuffer resize.
+extern void KQresize(kq_data kq[static 1], u32 w, u32 h);
+
+// Headless only. Copies the last rendered frame as tightly packed RGBA8; size must be width * height * 4.
+extern bool KQframe_read(kq_data kq[restrict static 1], size_t size, u8 rgba[restrict size]);
+
+// Headless only. Writes the last rendered frame to a PNG file.
+extern bool KQframe_save_png(kq_data kq[restrict static 1], const char path[restrict static 1]);
+
 #endif /* KQ_H_ */
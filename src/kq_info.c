@@ -22,8 +22,6 @@ kq_info
 			.ldevice_cinfo = (VkDeviceCreateInfo){.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
                                                         .queueCreateInfoCount = 2,
                                                         .pQueueCreateInfos = rend_info.q_cinfo,
-                                                        .enabledExtensionCount = 1,
-                                                        .ppEnabledExtensionNames = (const char *[]){VK_KHR_SWAPCHAIN_EXTENSION_NAME},
                                                         .pEnabledFeatures = &rend_info.pdev_feats},
 			.swapchain_cinfo = (VkSwapchainCreateInfoKHR){.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
                                                         .imageArrayLayers = 1,
@@ -60,9 +58,9 @@ kq_info
                                                         .pDynamicStates = rend_info.pipeline_dynamic_states},
 			.tiles_vertex_input_state_cinfo =
 				(VkPipelineVertexInputStateCreateInfo){.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-                                                        .vertexBindingDescriptionCount = 1,
+                                                        .vertexBindingDescriptionCount = KQ_TILES_VERTEX_INPUT_BINDINGS_NUM,
                                                         .vertexAttributeDescriptionCount = KQ_TILES_VERTEX_INPUT_ATTRIBUTES_NUM,
-                                                        .pVertexBindingDescriptions = &rend_info.tiles_vertex_input_binding_desc,
+                                                        .pVertexBindingDescriptions = rend_info.tiles_vertex_input_binding_descs,
                                                         .pVertexAttributeDescriptions = rend_info.tiles_vertex_input_attrib_descs},
 			.pipeline_assembly_input_state_cinfo = (VkPipelineInputAssemblyStateCreateInfo){.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
                                                         .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST},
@@ -91,9 +89,7 @@ kq_info
                                                         .attachmentCount = 1,
                                                         .pAttachments = &rend_info.pipeline_color_blend_attachment_state},
 			.pipeline_layout_cinfo = (VkPipelineLayoutCreateInfo){.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-                                                        .setLayoutCount = 1,
-                                                        .pushConstantRangeCount = 1,
-                                                        .pPushConstantRanges = &rend_info.tiles_pc_range},
+                                                        .setLayoutCount = 2},
 			.pass_color_attachment = (VkAttachmentDescription){.format = VK_FORMAT_B8G8R8A8_UNORM,
                                                         .samples = VK_SAMPLE_COUNT_1_BIT,
                                                         .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
@@ -108,8 +104,9 @@ kq_info
                                                         .subpassCount = 1,
                                                         .pSubpasses = &rend_info.subpass_desc,
                                                         .dependencyCount = 1,
-                                                        .pDependencies = &rend_info.subpass_dep},
+                                                        .pDependencies = rend_info.subpass_deps},
 			.graphics_pipeline_cinfo = (VkGraphicsPipelineCreateInfo){.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+                                                        .pNext = &rend_info.pipeline_rendering_cinfo, // Ignored with a render pass.
                                                         .stageCount = 2,
                                                         .pStages = rend_info.tiles_shader_stages_cinfo,
                                                         .pVertexInputState = &rend_info.tiles_vertex_input_state_cinfo,
@@ -121,6 +118,26 @@ kq_info
                                                         .pDynamicState = &rend_info.pipeline_dynamic_states_cinfo,
                                                         .basePipelineIndex = -1},
 			.fbo_cinfo = (VkFramebufferCreateInfo){.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO, .attachmentCount = 1, .layers = 1},
+			// Dynamic rendering: the same single cleared attachment, named per pass instead of through a framebuffer.
+			.pdev_feats13 = (VkPhysicalDeviceVulkan13Features){.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+                                                        .dynamicRendering = VK_TRUE},
+			.pipeline_rendering_cinfo = (VkPipelineRenderingCreateInfo){.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+                                                        .colorAttachmentCount = 1,
+                                                        .pColorAttachmentFormats = &rend_info.pass_color_attachment.format},
+			.rendering_attachment = (VkRenderingAttachmentInfo){.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+                                                        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                                        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                                        .storeOp = VK_ATTACHMENT_STORE_OP_STORE},
+			.rendering_info = (VkRenderingInfo){.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+                                                        .layerCount = 1,
+                                                        .colorAttachmentCount = 1,
+                                                        .pColorAttachments = &rend_info.rendering_attachment},
+			// Frame pacing, if both are supported.
+			.pdev_present_wait_feats = (VkPhysicalDevicePresentWaitFeaturesKHR){.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+                                                        .pNext = &rend_info.pdev_present_id_feats,
+                                                        .presentWait = VK_TRUE},
+			.pdev_present_id_feats = (VkPhysicalDevicePresentIdFeaturesKHR){.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+                                                        .presentId = VK_TRUE},
 #if KQ_DEBUG
 			.debug_messenger_cinfo = (VkDebugUtilsMessengerCreateInfoEXT){.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
                                                         .messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT
@@ -152,11 +169,55 @@ kq_info
                                                         .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
                                                         .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
                                                         .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT},
+			.subpass_dep_readback = (VkSubpassDependency){.srcSubpass = 0,
+                                                        .dstSubpass = VK_SUBPASS_EXTERNAL,
+                                                        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                                        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                                        .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                                        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT},
 			.present_info = (VkPresentInfoKHR){.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR, .waitSemaphoreCount = 1, .swapchainCount = 1},
-			.tiles_vertex_input_binding_desc = (VkVertexInputBindingDescription){.stride = sizeof(kq_vertex)},
+			.present_regions = (VkPresentRegionsKHR){.sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR,
+                                                        .swapchainCount = 1,
+                                                        .pRegions = &rend_info.present_region},
+			.present_ids = (VkPresentIdKHR){.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR, .swapchainCount = 1},
+			.present_times = (VkPresentTimesInfoGOOGLE){.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE,
+                                                        .swapchainCount = 1,
+                                                        .pTimes = &rend_info.present_time},
+			.tiles_vertex_input_binding_descs = {(VkVertexInputBindingDescription){.binding = 0, .stride = sizeof(kq_vertex), .inputRate = VK_VERTEX_INPUT_RATE_VERTEX},
+                                                        (VkVertexInputBindingDescription){.binding = 1,
+                                                                                          .stride = sizeof(kq_tile_instance),
+                                                                                          .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE}},
 			.tiles_vertex_input_attrib_descs =
 				{(VkVertexInputAttributeDescription){.location = 0, .format = VK_FORMAT_R32G32_SFLOAT, .offset = offsetof(kq_vertex, position)},
-                                                        (VkVertexInputAttributeDescription){.location = 1, .format = VK_FORMAT_R32G32_SFLOAT, .offset = offsetof(kq_vertex, uv)}},
+                                                        (VkVertexInputAttributeDescription){.location = 1, .format = VK_FORMAT_R32G32_SFLOAT, .offset = offsetof(kq_vertex, uv)},
+                                                        (VkVertexInputAttributeDescription){.location = 2,
+                                                                                            .binding = 1,
+                                                                                            .format = VK_FORMAT_R32G32_SFLOAT,
+                                                                                            .offset = offsetof(kq_tile_instance, position)},
+                                                        (VkVertexInputAttributeDescription){.location = 3,
+                                                                                            .binding = 1,
+                                                                                            .format = VK_FORMAT_R32G32_SFLOAT,
+                                                                                            .offset = offsetof(kq_tile_instance, scale)},
+                                                        (VkVertexInputAttributeDescription){.location = 4,
+                                                                                            .binding = 1,
+                                                                                            .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+                                                                                            .offset = offsetof(kq_tile_instance, uv_rect)},
+                                                        (VkVertexInputAttributeDescription){.location = 5,
+                                                                                            .binding = 1,
+                                                                                            .format = VK_FORMAT_R8G8B8A8_UNORM,
+                                                                                            .offset = offsetof(kq_tile_instance, color)},
+                                                        (VkVertexInputAttributeDescription){.location = 6,
+                                                                                            .binding = 1,
+                                                                                            .format = VK_FORMAT_R32_UINT,
+                                                                                            .offset = offsetof(kq_tile_instance, layer)},
+                                                        (VkVertexInputAttributeDescription){.location = 7,
+                                                                                            .binding = 1,
+                                                                                            .format = VK_FORMAT_R32_UINT,
+                                                                                            .offset = offsetof(kq_tile_instance, flags)},
+                                                        (VkVertexInputAttributeDescription){.location = 8,
+                                                                                            .binding = 1,
+                                                                                            .format = VK_FORMAT_R32_SFLOAT,
+                                                                                            .offset = offsetof(kq_tile_instance, anim_start)}},
 			.ubo_layout_binding = (VkDescriptorSetLayoutBinding){.binding = 0,
                                                         .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
                                                         .descriptorCount = 1,
@@ -165,11 +226,19 @@ kq_info
                                                         .descriptorCount = 1,
                                                         .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                                                         .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT},
+			.glyph_atlas_layout_binding = (VkDescriptorSetLayoutBinding){.binding = 2,
+                                                        .descriptorCount = 1,
+                                                        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT},
+			.anim_layout_binding = (VkDescriptorSetLayoutBinding){.binding = 3,
+                                                        .descriptorCount = 1,
+                                                        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                                        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT},
 			.descriptor_set_layout_cinfo = (VkDescriptorSetLayoutCreateInfo){.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-                                                        .bindingCount = 2,
+                                                        .bindingCount = 4,
                                                         .pBindings = rend_info.layout_bindings},
-			.desc_pool_size = {(VkDescriptorPoolSize){.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = KQ_FRAMES_IN_FLIGHT},
-                                                        (VkDescriptorPoolSize){.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = KQ_FRAMES_IN_FLIGHT}},
+			.desc_pool_size = {(VkDescriptorPoolSize){.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 2 * KQ_FRAMES_IN_FLIGHT},
+                                                        (VkDescriptorPoolSize){.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 2 * KQ_FRAMES_IN_FLIGHT}},
 			.desc_pool_cinfo = (VkDescriptorPoolCreateInfo){.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
                                                         .poolSizeCount = 2,
                                                         .pPoolSizes = rend_info.desc_pool_size,
@@ -177,6 +246,7 @@ kq_info
 			.desc_sets_ainfo = (VkDescriptorSetAllocateInfo){.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
                                                         .descriptorSetCount = KQ_FRAMES_IN_FLIGHT},
 			.desc_binfo = (VkDescriptorBufferInfo){.range = sizeof(kq_uniforms)},
+			.anim_binfo = (VkDescriptorBufferInfo){.offset = KQ_ANIM_TABLE_OFFSET, .range = sizeof(kq_anim_clip[KQ_ANIM_CLIPS_MAX])},
 			.desc_write = {(VkWriteDescriptorSet){
 					       .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 					       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
@@ -186,12 +256,18 @@ kq_info
                                                               .dstBinding = 1,
                                                               .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                                                               .descriptorCount = 1,
-                                                              .pImageInfo = &rend_info.sampler_write}},
+                                                              .pImageInfo = &rend_info.sampler_write}, (VkWriteDescriptorSet){.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                                              .dstBinding = 2,
+                                                              .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                              .descriptorCount = 1,
+                                                              .pImageInfo = &rend_info.glyph_atlas_sampler_write}, (VkWriteDescriptorSet){.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                                              .dstBinding = 3,
+                                                              .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                                              .descriptorCount = 1,
+                                                              .pBufferInfo = &rend_info.anim_binfo}},
 			.sampler_write = (VkDescriptorImageInfo){.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+			.glyph_atlas_sampler_write = (VkDescriptorImageInfo){.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
 			.pdev_feats = (VkPhysicalDeviceFeatures){.samplerAnisotropy = VK_TRUE},
-			.tiles_pc_range = (VkPushConstantRange){.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                                                        .offset = 0,
-                                                        .size = sizeof(kq_tiles_pcs)},
 			.tiles_tex_image_cinfo =
 				(VkImageCreateInfo){.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
                                                         .imageType = VK_IMAGE_TYPE_2D,
@@ -226,5 +302,183 @@ kq_info
 							.borderColor = VK_BORDER_COLOR_INT_TRANSPARENT_BLACK,
 							.compareOp = VK_COMPARE_OP_ALWAYS,
 							.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
-							}
+							},
+			.glyph_atlas_view_cinfo =
+				(VkImageViewCreateInfo){
+							.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+							.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+							.format = VK_FORMAT_R8_UNORM,
+							.subresourceRange =
+						(VkImageSubresourceRange){
+							.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+							.levelCount = 1,
+							.layerCount = KQ_GLYPH_ATLAS_LAYERS_INIT, // Set as the atlas grows.
+						}, },
+			.glyph_atlas_sampler_cinfo = (VkSamplerCreateInfo){
+							.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+							.minFilter = VK_FILTER_LINEAR,
+							.magFilter = VK_FILTER_LINEAR,
+							.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+							.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+							.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+							.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+							.compareOp = VK_COMPARE_OP_ALWAYS,
+							.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+							},
+			// Render targets: the swapchain's format, so the tile pipeline's render pass is compatible with this one.
+			.target_color_attachment = (VkAttachmentDescription){.format = VK_FORMAT_B8G8R8A8_UNORM,
+                                                        .samples = VK_SAMPLE_COUNT_1_BIT,
+                                                        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                                        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                                                        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                                        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                                                        .finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+			.target_subpass_deps = {(VkSubpassDependency){.srcSubpass = VK_SUBPASS_EXTERNAL,
+                                                                      .srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+                                                                                                      | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                                                      .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                                                      .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT
+                                                                                                       | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT},
+                                                        (VkSubpassDependency){.srcSubpass = 0,
+                                                                      .dstSubpass = VK_SUBPASS_EXTERNAL,
+                                                                      .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                                                      .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                                                      .dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+                                                                                                      | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                                                      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT}},
+			.target_pass_cinfo = (VkRenderPassCreateInfo){.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+                                                        .attachmentCount = 1,
+                                                        .pAttachments = &rend_info.target_color_attachment,
+                                                        .subpassCount = 1,
+                                                        .pSubpasses = &rend_info.subpass_desc,
+                                                        .dependencyCount = 2,
+                                                        .pDependencies = rend_info.target_subpass_deps},
+			// Keeps what the last pass left, for drawing again only the parts of the scene that changed.
+			.target_load_color_attachment = (VkAttachmentDescription){.format = VK_FORMAT_B8G8R8A8_UNORM,
+                                                        .samples = VK_SAMPLE_COUNT_1_BIT,
+                                                        .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+                                                        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                                                        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                                        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                                                        .initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                        .finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+			.target_load_pass_cinfo = (VkRenderPassCreateInfo){.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+                                                        .attachmentCount = 1,
+                                                        .pAttachments = &rend_info.target_load_color_attachment,
+                                                        .subpassCount = 1,
+                                                        .pSubpasses = &rend_info.subpass_desc,
+                                                        .dependencyCount = 2,
+                                                        .pDependencies = rend_info.target_subpass_deps},
+			.target_pass_begin_info = (VkRenderPassBeginInfo){.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                                                        .clearValueCount = 1,
+                                                        .pClearValues = &rend_info.clear_color},
+			.target_layout_binding = (VkDescriptorSetLayoutBinding){.binding = 0,
+                                                        .descriptorCount = 1,
+                                                        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT},
+			.target_set_layout_cinfo = (VkDescriptorSetLayoutCreateInfo){.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                                                        .bindingCount = 1,
+                                                        .pBindings = &rend_info.target_layout_binding},
+			// Targets, the default set, and the post chain's scene image and blur.
+			.target_desc_pool_size = (VkDescriptorPoolSize){.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                        .descriptorCount = KQ_RENDER_TARGETS_MAX + 3},
+			.target_desc_pool_cinfo = (VkDescriptorPoolCreateInfo){.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                                                        .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+                                                        .poolSizeCount = 1,
+                                                        .pPoolSizes = &rend_info.target_desc_pool_size,
+                                                        .maxSets = KQ_RENDER_TARGETS_MAX + 3},
+			.target_view_cinfo =
+				(VkImageViewCreateInfo){
+							.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+							.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+							.format = VK_FORMAT_B8G8R8A8_UNORM,
+							.subresourceRange =
+						(VkImageSubresourceRange){
+							.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+							.levelCount = 1,
+							.layerCount = 1,
+						}, },
+			.target_sampler_cinfo = (VkSamplerCreateInfo){
+							.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+							.minFilter = VK_FILTER_LINEAR,
+							.magFilter = VK_FILTER_LINEAR,
+							.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+							.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+							.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+							.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+							.compareOp = VK_COMPARE_OP_ALWAYS,
+							.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+							},
+			// Post chain: a fullscreen triangle generated from the vertex index, writing the swapchain image without blending.
+			.post_shader_stages_cinfo = {(VkPipelineShaderStageCreateInfo){.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                                                                                       .stage = VK_SHADER_STAGE_VERTEX_BIT,
+                                                                                       .pName = "main"},
+                                                        (VkPipelineShaderStageCreateInfo){.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                                                                                       .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+                                                                                       .pName = "main"}},
+			.post_vertex_input_state_cinfo =
+				(VkPipelineVertexInputStateCreateInfo){.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO},
+			.post_color_blend_attachment_state =
+				(VkPipelineColorBlendAttachmentState){.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+                                                                                          | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT},
+			.post_color_blend_cinfo = (VkPipelineColorBlendStateCreateInfo){.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+                                                        .logicOp = VK_LOGIC_OP_COPY,
+                                                        .attachmentCount = 1,
+                                                        .pAttachments = &rend_info.post_color_blend_attachment_state},
+			.post_push_range = (VkPushConstantRange){.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT, .size = sizeof(kq_post_push)},
+			.post_pipeline_layout_cinfo = (VkPipelineLayoutCreateInfo){.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                                                        .setLayoutCount = 2,
+                                                        .pushConstantRangeCount = 1,
+                                                        .pPushConstantRanges = &rend_info.post_push_range},
+			.post_pipeline_cinfo = (VkGraphicsPipelineCreateInfo){.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+                                                        .pNext = &rend_info.pipeline_rendering_cinfo,
+                                                        .stageCount = 2,
+                                                        .pStages = rend_info.post_shader_stages_cinfo,
+                                                        .pVertexInputState = &rend_info.post_vertex_input_state_cinfo,
+                                                        .pInputAssemblyState = &rend_info.pipeline_assembly_input_state_cinfo,
+                                                        .pViewportState = &rend_info.pipeline_viewport_state_cinfo,
+                                                        .pRasterizationState = &rend_info.pipeline_rasterization_state_cinfo,
+                                                        .pMultisampleState = &rend_info.pipeline_msaa_state_cinfo,
+                                                        .pColorBlendState = &rend_info.post_color_blend_cinfo,
+                                                        .pDynamicState = &rend_info.pipeline_dynamic_states_cinfo,
+                                                        .basePipelineIndex = -1},
+			// Post chain blur: compute passes sampling one image and storing into another, both in the general layout.
+			.blur_layout_bindings = {(VkDescriptorSetLayoutBinding){.binding = 0,
+                                                                                .descriptorCount = 1,
+                                                                                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                                                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+                                                        (VkDescriptorSetLayoutBinding){.binding = 1,
+                                                                                .descriptorCount = 1,
+                                                                                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                                                                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT}},
+			.blur_set_layout_cinfo = (VkDescriptorSetLayoutCreateInfo){.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                                                        .bindingCount = 2,
+                                                        .pBindings = rend_info.blur_layout_bindings},
+			.blur_desc_pool_sizes = {(VkDescriptorPoolSize){.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 3},
+                                                        (VkDescriptorPoolSize){.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 3}},
+			.blur_desc_pool_cinfo = (VkDescriptorPoolCreateInfo){.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                                                        .poolSizeCount = 2,
+                                                        .pPoolSizes = rend_info.blur_desc_pool_sizes,
+                                                        .maxSets = 3},
+			.blur_push_range = (VkPushConstantRange){.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = sizeof(kq_blur_push)},
+			.blur_pipeline_layout_cinfo = (VkPipelineLayoutCreateInfo){.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                                                        .setLayoutCount = 1,
+                                                        .pushConstantRangeCount = 1,
+                                                        .pPushConstantRanges = &rend_info.blur_push_range},
+			.blur_pipeline_cinfo = (VkComputePipelineCreateInfo){.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                                                        .stage = (VkPipelineShaderStageCreateInfo){.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                                                                                                   .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                                                                                                   .pName = "main"},
+                                                        .basePipelineIndex = -1},
+			.blur_view_cinfo =
+				(VkImageViewCreateInfo){
+							.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+							.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+							.format = VK_FORMAT_R16G16B16A16_SFLOAT,
+							.subresourceRange =
+						(VkImageSubresourceRange){
+							.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+							.levelCount = 1,
+							.layerCount = 1,
+						}, },
 };
@@ -0,0 +1,115 @@
+#include <kq_prof.h>
+
+#if KQ_PROFILE
+
+	#include <inttypes.h>
+	#include <pthread.h>
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <unistd.h>
+
+	#include <libcbase/log.h>
+
+
+	#define CB_LOG_MODULE "PROF"
+
+
+_Thread_local kq_prof_thread *kq_prof_tls = 0;
+
+static pthread_mutex_t kq_prof_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static kq_prof_thread *kq_prof_threads = 0;
+
+// Pairs of (raw timestamp, CLOCK_MONOTONIC ns) taken at init and export, to convert TSC ticks to time.
+static u64 kq_prof_base_raw = 0;
+static u64 kq_prof_base_ns = 0;
+
+
+static u64 kq_prof_mono_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+void kq_prof_init(void) {
+	kq_prof_base_raw = kq_prof_now();
+	kq_prof_base_ns = kq_prof_mono_ns();
+}
+
+kq_prof_thread *kq_prof_thread_register(void) {
+	kq_prof_thread *t = calloc(1, sizeof(kq_prof_thread));
+	if (!t) {
+		LOGM_ERROR("Unable to allocate profiler ring buffer; this thread will not be profiled.");
+		return 0;
+	}
+	t->tid = (u64)gettid();
+
+	pthread_mutex_lock(&kq_prof_threads_lock);
+	t->next = kq_prof_threads;
+	kq_prof_threads = t;
+	pthread_mutex_unlock(&kq_prof_threads_lock);
+
+	kq_prof_tls = t;
+	return t;
+}
+
+bool kq_prof_export_chrome(const char path[static 1]) {
+	FILE *f = fopen(path, "w");
+	if (!f) {
+		LOGM_ERROR("Unable to open \"%s\" for the trace.", path);
+		return false;
+	}
+
+	// Derive ticks per nanosecond from the time elapsed since kq_prof_init().
+	const u64 now_raw = kq_prof_now();
+	const u64 now_ns = kq_prof_mono_ns();
+	double    ns_per_tick = 1.0;
+	if (now_raw > kq_prof_base_raw && now_ns > kq_prof_base_ns)
+		ns_per_tick = (double)(now_ns - kq_prof_base_ns) / (double)(now_raw - kq_prof_base_raw);
+
+	const pid_t pid = getpid();
+	size_t      zones = 0;
+	fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", f);
+
+	pthread_mutex_lock(&kq_prof_threads_lock);
+	for (kq_prof_thread *t = kq_prof_threads; t; t = t->next) {
+		const u64 count = t->head < KQ_PROF_RING_SIZE ? t->head : KQ_PROF_RING_SIZE;
+		for (u64 i = t->head - count; i < t->head; ++i) {
+			const kq_prof_zone *z = &t->ring[i & (KQ_PROF_RING_SIZE - 1U)];
+			// Chrome trace timestamps are in microseconds.
+			const double ts = (double)(z->begin - kq_prof_base_raw) * ns_per_tick / 1000.0;
+			const double dur = (double)(z->end - z->begin) * ns_per_tick / 1000.0;
+			fprintf(f,
+			        "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%" PRIu64 ",\"ts\":%.3f,\"dur\":%.3f}",
+			        zones ? "," : "",
+			        z->name,
+			        (int)pid,
+			        t->tid,
+			        ts,
+			        dur);
+			++zones;
+		}
+	}
+	pthread_mutex_unlock(&kq_prof_threads_lock);
+
+	fputs("\n]}\n", f);
+	if (fclose(f)) {
+		LOGM_ERROR("Failed writing the trace to \"%s\".", path);
+		return false;
+	}
+
+	LOGM_INFO("Wrote %zu profiler zones to \"%s\".", zones, path);
+	return true;
+}
+
+void kq_prof_shutdown(void) {
+	pthread_mutex_lock(&kq_prof_threads_lock);
+	for (kq_prof_thread *t = kq_prof_threads, *next; t; t = next) {
+		next = t->next;
+		free(t);
+	}
+	kq_prof_threads = 0;
+	pthread_mutex_unlock(&kq_prof_threads_lock);
+	kq_prof_tls = 0;
+}
+
+#endif /* KQ_PROFILE */
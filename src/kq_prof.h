@@ -0,0 +1,121 @@
+#ifndef KQ_PROF_H_
+#define KQ_PROF_H_
+
+#include <stdbool.h>
+#include <time.h>
+
+#include <libcbase/common.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+#endif
+
+// CPU profiler: instrumented zones recorded into a per-thread ring buffer, exported as Chrome trace JSON (open the file
+// in Perfetto or chrome://tracing). Build with `make PROFILE=1`; otherwise every macro below compiles to nothing.
+
+#ifndef KQ_PROFILE
+	#define KQ_PROFILE 0
+#endif
+
+// Completed zones kept per thread. Must be a power of two; the oldest zones are overwritten first.
+#define KQ_PROF_RING_SIZE 65536U
+// Deepest nesting of open zones per thread. Deeper zones are dropped rather than recorded.
+#define KQ_PROF_MAX_DEPTH 32U
+
+#define KQ_PROF_DEFAULT_PATH "kq_trace.json"
+
+
+#if KQ_PROFILE
+
+typedef struct kq_prof_zone {
+	const char *name;
+	u64         begin;
+	u64         end;
+} kq_prof_zone;
+
+typedef struct kq_prof_thread {
+	struct kq_prof_thread *next;
+	u64                    tid;
+	u32                    depth;
+	u64                    head; // Zones ever written; the slot is head & (KQ_PROF_RING_SIZE - 1).
+	const char            *open_name[KQ_PROF_MAX_DEPTH];
+	u64                    open_begin[KQ_PROF_MAX_DEPTH];
+	kq_prof_zone           ring[KQ_PROF_RING_SIZE];
+} kq_prof_thread;
+
+extern _Thread_local kq_prof_thread *kq_prof_tls;
+
+extern kq_prof_thread *kq_prof_thread_register(void);
+
+// Raw timestamp. TSC ticks on x86 (converted to ns at export), CLOCK_MONOTONIC nanoseconds elsewhere.
+static inline u64 kq_prof_now(void) {
+	#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+	#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+	#endif
+}
+
+static inline const char *kq_prof_begin(const char name[static 1]) {
+	kq_prof_thread *t = kq_prof_tls;
+	if (!t && !(t = kq_prof_thread_register()))
+		return name;
+
+	if (t->depth < KQ_PROF_MAX_DEPTH) {
+		t->open_name[t->depth] = name;
+		t->open_begin[t->depth] = kq_prof_now();
+	}
+	++t->depth;
+	return name;
+}
+
+static inline void kq_prof_end(void) {
+	kq_prof_thread *t = kq_prof_tls;
+	if (!t || !t->depth)
+		return;
+
+	if (--t->depth < KQ_PROF_MAX_DEPTH) {
+		kq_prof_zone *z = &t->ring[t->head++ & (KQ_PROF_RING_SIZE - 1U)];
+		z->end = kq_prof_now();
+		z->begin = t->open_begin[t->depth];
+		z->name = t->open_name[t->depth];
+	}
+}
+
+static inline void kq_prof_scope_end(const char *const name[static 1]) {
+	CB_UNUSED(name);
+	kq_prof_end();
+}
+
+// Must be called before any thread records a zone; sets the time base used by the export.
+extern void kq_prof_init(void);
+
+// Threads that record zones must be quiescent while this runs.
+extern bool kq_prof_export_chrome(const char path[static 1]);
+
+// Frees every thread's ring buffer. No zone may be recorded afterwards.
+extern void kq_prof_shutdown(void);
+
+	#define KQ_PROF_CAT_(a, b) a##b
+	#define KQ_PROF_CAT(a, b)  KQ_PROF_CAT_(a, b)
+
+	#define KQ_PROF_BEGIN(name) ((void)kq_prof_begin(name))
+	#define KQ_PROF_END()       kq_prof_end()
+	// Zone lasting until the end of the enclosing block.
+	#define KQ_PROF_SCOPE(name)                                                                                    \
+		__attribute__((cleanup(kq_prof_scope_end), unused)) const char *const KQ_PROF_CAT(kq_prof_scope_, __LINE__) = \
+			kq_prof_begin(name)
+	#define KQ_PROF_FUNC() KQ_PROF_SCOPE(__func__)
+
+#else
+
+	#define KQ_PROF_BEGIN(name)
+	#define KQ_PROF_END()
+	#define KQ_PROF_SCOPE(name)
+	#define KQ_PROF_FUNC()
+
+#endif /* KQ_PROFILE */
+
+#endif /* KQ_PROF_H_ */
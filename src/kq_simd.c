@@ -0,0 +1,189 @@
+#include <kq_simd.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcbase/log.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+	#define KQ_SIMD_X86 1
+#else
+	#define KQ_SIMD_X86 0
+#endif
+
+#define CB_LOG_MODULE "KQSIMD"
+
+
+typedef u32 kq_simd_cull_fn(const kq_sprite_store *restrict store,
+                            u32                             first,
+                            u32                             count,
+                            const kq_sprite_xform *restrict xf,
+                            kq_tile_instance *restrict      dst);
+
+// Writes slot i as an instance with its transformed position and scale, unless it is hidden or free. Returns 1 if it did.
+// xf already took it to NDC, so the camera mustn't apply again.
+static inline u32 kq_simd_emit(const kq_sprite_store *restrict store,
+                               u32                             i,
+                               const float                     pos[static 2],
+                               const float                     scale[static 2],
+                               kq_tile_instance *restrict      dst) {
+	if (store->flags[i] & (KQ_SPRITE_HIDDEN | KQ_SPRITE_FREE))
+		return 0;
+	*dst = (kq_tile_instance){
+		.position = {pos[0], pos[1]},
+		.scale = {scale[0], scale[1]},
+		.uv_rect = {0.0f, 0.0f, 1.0f, 1.0f},
+		.color = store->colors[i],
+		.layer = store->layers[i],
+		.flags = store->flags[i] | KQ_INSTANCE_SCREEN,
+		.anim_start = store->anim_starts[i],
+	};
+	return 1;
+}
+
+static u32 kq_simd_cull_scalar(const kq_sprite_store *restrict store,
+                               u32                             first,
+                               u32                             count,
+                               const kq_sprite_xform *restrict xf,
+                               kq_tile_instance *restrict      dst) {
+	u32 n = 0;
+	for (u32 i = first; i < first + count; ++i) {
+		bool  in = true;
+		float pos[2], scale[2];
+		for (size_t a = 0; a < 2; ++a) {
+			pos[a] = store->positions[i][a] * xf->scale[a] + xf->offset[a];
+			scale[a] = store->scales[i][a] * xf->scale[a];
+			in &= pos[a] - fabsf(scale[a]) <= 1.0f && pos[a] + fabsf(scale[a]) >= -1.0f;
+		}
+		if (in)
+			n += kq_simd_emit(store, i, pos, scale, &dst[n]);
+	}
+	return n;
+}
+
+#if KQ_SIMD_X86
+// Positions and scales are x, y pairs, so a vector holds whole sprites, and a sprite is in when both its lanes are.
+__attribute__((target("sse2"))) static u32 kq_simd_cull_sse2(const kq_sprite_store *restrict store,
+                                                             u32                             first,
+                                                             u32                             count,
+                                                             const kq_sprite_xform *restrict xf,
+                                                             kq_tile_instance *restrict      dst) {
+	const __m128 xs = _mm_setr_ps(xf->scale[0], xf->scale[1], xf->scale[0], xf->scale[1]);
+	const __m128 xo = _mm_setr_ps(xf->offset[0], xf->offset[1], xf->offset[0], xf->offset[1]);
+	const __m128 hi = _mm_set1_ps(1.0f);
+	const __m128 lo = _mm_set1_ps(-1.0f);
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+	const u32 end = first + count;
+	u32       i = first;
+	u32       n = 0;
+	for (; i + 2U <= end; i += 2U) {
+		const __m128 p = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(store->positions[i]), xs), xo);
+		const __m128 e = _mm_mul_ps(_mm_loadu_ps(store->scales[i]), xs);
+		const __m128 ae = _mm_and_ps(e, abs_mask);
+		const int    in = _mm_movemask_ps(_mm_and_ps(_mm_cmple_ps(_mm_sub_ps(p, ae), hi), _mm_cmpge_ps(_mm_add_ps(p, ae), lo)));
+		if (!in)
+			continue;
+
+		alignas(16) float pos[4], scale[4];
+		_mm_store_ps(pos, p);
+		_mm_store_ps(scale, e);
+		for (u32 k = 0U; k < 2U; ++k) {
+			if ((in >> (2U * k) & 3) == 3)
+				n += kq_simd_emit(store, i + k, &pos[2U * k], &scale[2U * k], &dst[n]);
+		}
+	}
+	return n + kq_simd_cull_scalar(store, i, end - i, xf, &dst[n]);
+}
+
+__attribute__((target("avx2"))) static u32 kq_simd_cull_avx2(const kq_sprite_store *restrict store,
+                                                             u32                             first,
+                                                             u32                             count,
+                                                             const kq_sprite_xform *restrict xf,
+                                                             kq_tile_instance *restrict      dst) {
+	const __m256 xs = _mm256_setr_ps(xf->scale[0], xf->scale[1], xf->scale[0], xf->scale[1], xf->scale[0], xf->scale[1], xf->scale[0], xf->scale[1]);
+	const __m256 xo =
+		_mm256_setr_ps(xf->offset[0], xf->offset[1], xf->offset[0], xf->offset[1], xf->offset[0], xf->offset[1], xf->offset[0], xf->offset[1]);
+	const __m256 hi = _mm256_set1_ps(1.0f);
+	const __m256 lo = _mm256_set1_ps(-1.0f);
+	const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+
+	const u32 end = first + count;
+	u32       i = first;
+	u32       n = 0;
+	for (; i + 4U <= end; i += 4U) {
+		const __m256 p = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(store->positions[i]), xs), xo);
+		const __m256 e = _mm256_mul_ps(_mm256_loadu_ps(store->scales[i]), xs);
+		const __m256 ae = _mm256_and_ps(e, abs_mask);
+		const __m256 in_lo = _mm256_cmp_ps(_mm256_add_ps(p, ae), lo, _CMP_GE_OQ);
+		const int    in = _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(_mm256_sub_ps(p, ae), hi, _CMP_LE_OQ), in_lo));
+		if (!in)
+			continue;
+
+		alignas(32) float pos[8], scale[8];
+		_mm256_store_ps(pos, p);
+		_mm256_store_ps(scale, e);
+		for (u32 k = 0U; k < 4U; ++k) {
+			if ((in >> (2U * k) & 3) == 3)
+				n += kq_simd_emit(store, i + k, &pos[2U * k], &scale[2U * k], &dst[n]);
+		}
+	}
+	return n + kq_simd_cull_sse2(store, i, end - i, xf, &dst[n]);
+}
+#endif
+
+static kq_simd_cull_fn *kq_simd_cull = 0;
+static const char      *kq_simd_isa = "scalar";
+
+bool kq_simd_sprites_isa_set(const char *isa) {
+	if (isa && !strcmp(isa, "scalar")) {
+		kq_simd_cull = kq_simd_cull_scalar;
+		kq_simd_isa = "scalar";
+		return true;
+	}
+#if KQ_SIMD_X86
+	__builtin_cpu_init();
+	if ((!isa || !strcmp(isa, "avx2")) && __builtin_cpu_supports("avx2")) {
+		kq_simd_cull = kq_simd_cull_avx2;
+		kq_simd_isa = "avx2";
+		return true;
+	}
+	if ((!isa || !strcmp(isa, "sse2")) && __builtin_cpu_supports("sse2")) {
+		kq_simd_cull = kq_simd_cull_sse2;
+		kq_simd_isa = "sse2";
+		return true;
+	}
+#endif
+	if (isa)
+		return false;
+	kq_simd_cull = kq_simd_cull_scalar;
+	kq_simd_isa = "scalar";
+	return true;
+}
+
+static void kq_simd_pick(void) {
+	const char *isa = getenv("KQ_SIMD");
+	if (isa && kq_simd_sprites_isa_set(isa))
+		return;
+	if (isa)
+		LOGM_WARN("KQ_SIMD=%s isn't \"avx2\", \"sse2\" or \"scalar\", or this CPU lacks it; picking the widest there is.", isa);
+	kq_simd_sprites_isa_set(0);
+}
+
+u32 kq_simd_sprites_cull(const kq_sprite_store store[restrict static 1],
+                         u32                   first,
+                         u32                   count,
+                         const kq_sprite_xform xf[restrict static 1],
+                         kq_tile_instance      dst[restrict static count]) {
+	if (!kq_simd_cull)
+		kq_simd_pick();
+	return kq_simd_cull(store, first, count, xf, dst);
+}
+
+const char *kq_simd_sprites_isa(void) {
+	if (!kq_simd_cull)
+		kq_simd_pick();
+	return kq_simd_isa;
+}
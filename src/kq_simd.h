@@ -0,0 +1,28 @@
+#ifndef KQ_SIMD_H_
+#define KQ_SIMD_H_
+
+#include <libcbase/common.h>
+
+#include <kq.h>
+
+
+// Sprite kernels over the SoA arrays of a kq_sprite_store, in AVX2, SSE2 and scalar versions. The first call picks the
+// widest the CPU supports, so builds for a baseline ISA still use AVX2 where it is there, unless the KQ_SIMD environment
+// variable names one of them to use instead.
+
+// Transforms count sprites from first by xf, culls those hidden, free, or wholly outside [-1, 1] after it, and writes the
+// rest in order to dst as instances. Returns how many it wrote.
+extern u32 kq_simd_sprites_cull(const kq_sprite_store store[restrict static 1],
+                                u32                   first,
+                                u32                   count,
+                                const kq_sprite_xform xf[restrict static 1],
+                                kq_tile_instance      dst[restrict static count]);
+
+// The kernels kq_simd_sprites_cull() runs on this CPU: "avx2", "sse2" or "scalar".
+extern const char *kq_simd_sprites_isa(void);
+
+// Makes kq_simd_sprites_cull() run the kernels named by isa, as kq_simd_sprites_isa() names them, or with null the widest
+// the CPU supports. Fails, changing nothing, if isa is unknown or the CPU lacks it.
+extern bool kq_simd_sprites_isa_set(const char *isa);
+
+#endif // KQ_SIMD_H_
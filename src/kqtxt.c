@@ -0,0 +1,1328 @@
+#include <kqtxt.h>
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include <hb-icu.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_MODULE_H
+
+#include <glad/vulkan.h>
+#include <kq.h>
+#include <kq_prof.h>
+#include <kqvk.h>
+#include <libcbase/log.h>
+#include <libcbase/vec.h>
+
+
+#define CB_LOG_MODULE "KQTXT"
+
+
+static u64 kqtxt_glyph_key(const kq_font font[static 1], u32 glyph_id, u32 subpixel_bucket) {
+	// 32 bits of glyph id, 12 of font id, 18 of 26.6 size (up to 4096 px) and 2 of subpixel bucket.
+	return (u64)glyph_id | (u64)(font->id & 0xFFFU) << 32 | (u64)(font->size & 0x3FFFFU) << 44 | (u64)subpixel_bucket << 62;
+}
+
+static size_t kqtxt_hash(u64 key) {
+	// MurmurHash3's 64-bit finaliser.
+	key ^= key >> 33;
+	key *= 0xFF51AFD7ED558CCDULL;
+	key ^= key >> 33;
+	key *= 0xC4CEB9FE1A85EC53ULL;
+	key ^= key >> 33;
+	return (size_t)key;
+}
+
+static kq_glyph *kqtxt_glyph_slot(size_t cap, kq_glyph glyphs[static cap], u64 key) {
+	for (size_t i = kqtxt_hash(key) & (cap - 1);; i = (i + 1) & (cap - 1)) {
+		if (!glyphs[i].used || glyphs[i].key == key)
+			return &glyphs[i];
+	}
+}
+
+static bool kqtxt_glyphs_grow(kq_data kq[static 1]) {
+	const size_t cap = kq->glyphs_cap * 2;
+	kq_glyph    *glyphs = calloc(cap, sizeof(kq_glyph));
+	if (!glyphs) {
+		KQ_OOM_MSG();
+		return false;
+	}
+
+	for (size_t i = 0; i < kq->glyphs_cap; ++i) {
+		if (kq->glyphs[i].used)
+			*kqtxt_glyph_slot(cap, glyphs, kq->glyphs[i].key) = kq->glyphs[i];
+	}
+
+	free(kq->glyphs);
+	kq->glyphs = glyphs;
+	kq->glyphs_cap = cap;
+	return true;
+}
+
+// Finds room for a w x h rectangle on the pages, or only on layer if it isn't UINT32_MAX: the shortest shelf it fits on, or a
+// new shelf in the first page with space if that would waste less.
+static bool kqtxt_atlas_alloc(kq_data kq[static 1], u32 only, u32 w, u32 h, u16 x[static 1], u16 y[static 1], u16 layer[static 1]) {
+	if (w > KQ_GLYPH_ATLAS_SIZE || h > KQ_GLYPH_ATLAS_SIZE)
+		return false;
+
+	kq_atlas_shelf *best = 0;
+	for (size_t i = 0; i < kq->atlas_shelves->size; ++i) {
+		kq_atlas_shelf *s = &kq->atlas_shelves->p[i];
+		if ((only == UINT32_MAX || s->layer == only) && s->h >= h && s->x + w <= KQ_GLYPH_ATLAS_SIZE && (!best || s->h < best->h))
+			best = s;
+	}
+
+	// Shelf heights are rounded up, so glyphs of similar height share them.
+	const u32 shelf_h = (h + 3U) & ~3U;
+	if (!best || best->h > shelf_h + shelf_h / 2) {
+		for (u32 l = 0U; l < kq->atlas_layers; ++l) {
+			if ((only == UINT32_MAX ? l == kq->atlas_spare : l != only) || kq->atlas_next_y[l] + shelf_h > KQ_GLYPH_ATLAS_SIZE)
+				continue;
+
+			const kq_atlas_shelf shelf = {.layer = (u16)l, .y = (u16)kq->atlas_next_y[l], .h = (u16)shelf_h};
+			best = vecshelf_push_back(kq->atlas_shelves, &shelf);
+			if (!best) {
+				KQ_OOM_MSG();
+				return false;
+			}
+			kq->atlas_next_y[l] += shelf_h;
+			break;
+		}
+	}
+	if (!best)
+		return false;
+
+	*x = best->x;
+	*y = best->y;
+	*layer = best->layer;
+	best->x = (u16)(best->x + w);
+	return true;
+}
+
+static int kqtxt_glyph_height_cmp(const void *a, const void *b) {
+	const u16 x = (*(kq_glyph *const *)a)->h;
+	const u16 y = (*(kq_glyph *const *)b)->h;
+	return (x < y) - (x > y);
+}
+
+// Makes space after an allocation failed, on the render thread, in the draw that needed it. Below
+// KQ_GLYPH_ATLAS_LAYERS_MAX the atlas grows at the next frame, as its descriptors can't change while one is recorded. At
+// the limit, the least recently sampled page not used this frame is evicted: glyphs drawn in the last
+// KQ_GLYPH_HOT_FRAMES are copied into the spare layer, the rest are forgotten, and the spare takes the page's place.
+// Returns whether there may be room now.
+static bool kqtxt_atlas_make_room(kq_data kq[static 1]) {
+	if (kq->atlas_layers < KQ_GLYPH_ATLAS_LAYERS_MAX) {
+		kq->atlas_grow_pending = true;
+		kq->redraw = true; // For the glyphs dropped until then.
+		return false;
+	}
+	if (kq->atlas_repacked) {
+		kq->redraw = true;
+		return false;
+	}
+
+	const u64 now = kq->stats.frames;
+	u32       victim = UINT32_MAX;
+	for (u32 l = 0U; l < kq->atlas_layers; ++l) {
+		if (l != kq->atlas_spare && kq->atlas_layer_used[l] != now
+		    && (victim == UINT32_MAX || kq->atlas_layer_used[l] < kq->atlas_layer_used[victim]))
+			victim = l;
+	}
+	if (victim == UINT32_MAX) {
+		LOGM_ERROR("Glyph atlas is full.");
+		return false;
+	}
+	KQ_PROF_FUNC();
+
+	size_t hot_count = 0;
+	for (size_t i = 0; i < kq->glyphs_cap; ++i) {
+		const kq_glyph *g = &kq->glyphs[i];
+		hot_count += g->used && g->w && g->layer == victim && g->last_used + KQ_GLYPH_HOT_FRAMES >= now;
+	}
+	kq_glyph **hot = malloc((hot_count ? hot_count : 1) * sizeof(kq_glyph *));
+	kq_glyph  *glyphs = calloc(kq->glyphs_cap, sizeof(kq_glyph));
+	if (!hot || !glyphs) {
+		KQ_OOM_MSG();
+		free(hot);
+		free(glyphs);
+		return false;
+	}
+	hot_count = 0;
+	for (size_t i = 0; i < kq->glyphs_cap; ++i) {
+		kq_glyph *g = &kq->glyphs[i];
+		if (g->used && g->w && g->layer == victim && g->last_used + KQ_GLYPH_HOT_FRAMES >= now)
+			hot[hot_count++] = g;
+	}
+
+	size_t kept = 0;
+	for (size_t i = 0; i < kq->atlas_shelves->size; ++i) {
+		if (kq->atlas_shelves->p[i].layer != victim)
+			kq->atlas_shelves->p[kept++] = kq->atlas_shelves->p[i];
+	}
+	kq->atlas_shelves->size = kept;
+	kq->atlas_next_y[victim] = 0;
+
+	// Tallest first packs the shelves tightest.
+	const u32 spare = kq->atlas_spare;
+	qsort(hot, hot_count, sizeof(kq_glyph *), kqtxt_glyph_height_cmp);
+	vecimgcopy_clear(kq->atlas_moves);
+	for (size_t i = 0; i < hot_count; ++i) {
+		kq_glyph *g = hot[i];
+		u16       x, y, layer;
+		if (!kqtxt_atlas_alloc(kq, spare, g->w + 2 * KQ_GLYPH_PADDING, g->h + 2 * KQ_GLYPH_PADDING, &x, &y, &layer))
+			continue;
+
+		const VkImageCopy move = {
+			.srcSubresource = (VkImageSubresourceLayers){.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseArrayLayer = victim, .layerCount = 1},
+			.srcOffset = (VkOffset3D){.x = g->x, .y = g->y},
+			.dstSubresource = (VkImageSubresourceLayers){.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseArrayLayer = spare, .layerCount = 1},
+			.dstOffset = (VkOffset3D){.x = x + KQ_GLYPH_PADDING, .y = y + KQ_GLYPH_PADDING},
+			.extent = (VkExtent3D){.width = g->w, .height = g->h, .depth = 1},
+		};
+		if (!vecimgcopy_push_back(kq->atlas_moves, &move)) {
+			KQ_OOM_MSG();
+			break;
+		}
+		g->x = (u16)(x + KQ_GLYPH_PADDING);
+		g->y = (u16)(y + KQ_GLYPH_PADDING);
+		g->layer = (u16)spare;
+	}
+	free(hot);
+
+	// Whatever is still on the victim was not moved; rehashing drops it.
+	size_t count = 0;
+	for (size_t i = 0; i < kq->glyphs_cap; ++i) {
+		const kq_glyph *g = &kq->glyphs[i];
+		if (g->used && !(g->w && g->layer == victim)) {
+			*kqtxt_glyph_slot(kq->glyphs_cap, glyphs, g->key) = *g;
+			++count;
+		}
+	}
+	LOGM_DEBUG("Evicted glyph atlas layer %u: moved %zu glyphs, dropped %zu.", victim, kq->atlas_moves->size, kq->glyphs_count - count);
+	free(kq->glyphs);
+	kq->glyphs = glyphs;
+	kq->glyphs_count = count;
+
+	kq->atlas_repack_layer = spare;
+	kq->atlas_spare = victim;
+	kq->atlas_layer_used[spare] = now;
+	kq->atlas_repacked = true;
+	++kq->atlas_epoch;
+	++kq->stats.atlas_repacks;
+	return true;
+}
+
+// A rasterised glyph, wherever it came from.
+typedef struct kqtxt_bitmap {
+	const u8 *buf;
+	u32       w, h;
+	s32       pitch;
+	s16       left, top;
+} kqtxt_bitmap;
+
+static bool kqtxt_bitmap_from_slot(const FT_GlyphSlot slot, u32 glyph_id, kqtxt_bitmap bm[static 1]) {
+	if (slot->bitmap.width && slot->bitmap.rows && slot->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY) {
+		LOGM_ERROR("Glyph %u rasterised in unsupported pixel mode %d.", glyph_id, (int)slot->bitmap.pixel_mode);
+		return false;
+	}
+
+	*bm = (kqtxt_bitmap){
+		.buf = slot->bitmap.buffer,
+		.w = slot->bitmap.width,
+		.h = slot->bitmap.rows,
+		.pitch = slot->bitmap.pitch,
+		.left = (s16)slot->bitmap_left,
+		.top = (s16)slot->bitmap_top,
+	};
+	return true;
+}
+
+static int kqtxt_sdf_glyph_cmp(const void *key, const void *elem) {
+	const u32 a = *(const u32 *)key;
+	const u32 b = ((const kq_sdf_glyph *)elem)->glyph_id;
+	return (a > b) - (a < b);
+}
+
+// The distance field, from the ones generated at load time if possible.
+static bool kqtxt_rasterize_sdf(const kq_font font[static 1], u32 glyph_id, kqtxt_bitmap bm[static 1]) {
+	const kq_sdf_glyph *pre = bsearch(&glyph_id, font->sdf_glyphs, font->sdf_count, sizeof(kq_sdf_glyph), kqtxt_sdf_glyph_cmp);
+	if (pre && pre->pixels) {
+		*bm = (kqtxt_bitmap){.buf = pre->pixels, .w = pre->w, .h = pre->h, .pitch = pre->w, .left = pre->left, .top = pre->top};
+		return true;
+	}
+
+	FT_Error e = FT_Load_Glyph(font->face, glyph_id, FT_LOAD_DEFAULT);
+	if (!e)
+		e = FT_Render_Glyph(font->face->glyph, FT_RENDER_MODE_SDF);
+	if (e) {
+		LOGM_ERROR("Unable to generate distance field for glyph %u: %s.", glyph_id, FT_Error_String(e));
+		return false;
+	}
+	return kqtxt_bitmap_from_slot(font->face->glyph, glyph_id, bm);
+}
+
+static bool kqtxt_rasterize(const kq_font font[static 1], u32 glyph_id, u32 subpixel_bucket, kqtxt_bitmap bm[static 1]) {
+	FT_Vector delta = {.x = (FT_Pos)(subpixel_bucket * 64U / KQ_GLYPH_SUBPIXEL_BUCKETS)};
+	FT_Set_Transform(font->face, 0, &delta);
+	const FT_Error e = FT_Load_Glyph(font->face, glyph_id, FT_LOAD_RENDER | FT_LOAD_TARGET_LIGHT);
+	FT_Set_Transform(font->face, 0, 0);
+	if (e) {
+		LOGM_ERROR("Unable to rasterise glyph %u: %s.", glyph_id, FT_Error_String(e));
+		return false;
+	}
+	return kqtxt_bitmap_from_slot(font->face->glyph, glyph_id, bm);
+}
+
+const kq_glyph *kqtxt_glyph_get(kq_data kq[static 1], const kq_font font[static 1], u32 glyph_id, u32 subpixel_bucket) {
+	const u64 key = kqtxt_glyph_key(font, glyph_id, subpixel_bucket);
+	const u64 now = kq->stats.frames;
+	kq_glyph *g = kqtxt_glyph_slot(kq->glyphs_cap, kq->glyphs, key);
+	if (g->used) {
+		g->last_used = now;
+		if (g->w)
+			kq->atlas_layer_used[g->layer] = now;
+		return g;
+	}
+
+	// Keep the load factor under 3/4.
+	if ((kq->glyphs_count + 1) * 4 > kq->glyphs_cap * 3) {
+		if (!kqtxt_glyphs_grow(kq))
+			return 0;
+		g = kqtxt_glyph_slot(kq->glyphs_cap, kq->glyphs, key);
+	}
+
+	KQ_PROF_SCOPE("kqtxt_rasterize");
+	kqtxt_bitmap bm;
+	if (!(font->sdf ? kqtxt_rasterize_sdf(font, glyph_id, &bm) : kqtxt_rasterize(font, glyph_id, subpixel_bucket, &bm)))
+		return 0;
+
+	kq_glyph glyph = {.key = key, .used = true, .left = bm.left, .top = bm.top, .last_used = now};
+	if (bm.w && bm.h) {
+		// Staging first, so a full staging buffer doesn't leak atlas space; the glyph is retried next frame.
+		VkDeviceSize offset;
+		u8          *dst = kqvk_upload_reserve(kq, (VkDeviceSize)bm.w * bm.h, &offset);
+		if (!dst)
+			return 0;
+
+		u16 x, y, layer;
+		const u32 w = bm.w + 2 * KQ_GLYPH_PADDING, h = bm.h + 2 * KQ_GLYPH_PADDING;
+		if (!kqtxt_atlas_alloc(kq, UINT32_MAX, w, h, &x, &y, &layer)) {
+			if (!kqtxt_atlas_make_room(kq) || !kqtxt_atlas_alloc(kq, UINT32_MAX, w, h, &x, &y, &layer))
+				return 0;
+			g = kqtxt_glyph_slot(kq->glyphs_cap, kq->glyphs, key);
+		}
+		kq->atlas_layer_used[layer] = now;
+
+		for (u32 row = 0U; row < bm.h; ++row)
+			memcpy(dst + (size_t)row * bm.w, bm.buf + (ptrdiff_t)row * bm.pitch, bm.w);
+
+		glyph.x = (u16)(x + KQ_GLYPH_PADDING);
+		glyph.y = (u16)(y + KQ_GLYPH_PADDING);
+		glyph.w = (u16)bm.w;
+		glyph.h = (u16)bm.h;
+		glyph.layer = layer;
+
+		const VkBufferImageCopy region = {
+			.bufferOffset = offset,
+			.imageSubresource = (VkImageSubresourceLayers){.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseArrayLayer = layer, .layerCount = 1},
+			.imageOffset = (VkOffset3D){.x = glyph.x, .y = glyph.y},
+			.imageExtent = (VkExtent3D){.width = glyph.w, .height = glyph.h, .depth = 1},
+		};
+		if (!vecregion_push_back(kq->atlas_regions, &region)) {
+			KQ_OOM_MSG();
+			return 0;
+		}
+		++kq->stats.glyph_uploads;
+	}
+
+	*g = glyph;
+	++kq->glyphs_count;
+	return g;
+}
+
+bool kqtxt_draw_run(kq_data                    kq[restrict static 1],
+                    const kq_font              font[restrict static 1],
+                    u32                        count,
+                    const hb_glyph_info_t      infos[restrict count],
+                    const hb_glyph_position_t positions[restrict count],
+                    s64                        pen[restrict static 2],
+                    u32                        rgba,
+                    vecinst                   *out) {
+	const float px_w = 2.0f / kq->viewport.width;
+	const float px_h = 2.0f / kq->viewport.height;
+	const float texel = 1.0f / (float)KQ_GLYPH_ATLAS_SIZE;
+
+	const float scale = font->scale;
+	const u32   flags = KQ_INSTANCE_SCREEN | (font->sdf ? KQ_INSTANCE_GLYPH | KQ_INSTANCE_SDF : KQ_INSTANCE_GLYPH);
+
+	for (u32 i = 0U; i < count; ++i) {
+		// HarfBuzz's y axis points up, the framebuffer's down. Its units are the raster size's.
+		const s64 gx = pen[0] + (s64)((float)positions[i].x_offset * scale);
+		const s64 gy = pen[1] - (s64)((float)positions[i].y_offset * scale);
+		pen[0] += (s64)((float)positions[i].x_advance * scale);
+		pen[1] -= (s64)((float)positions[i].y_advance * scale);
+
+		// Distance fields scale smoothly, so they need neither subpixel variants nor snapping.
+		const u32       bucket = font->sdf ? 0U : (u32)((gx & 63) * KQ_GLYPH_SUBPIXEL_BUCKETS) >> 6;
+		const kq_glyph *g = kqtxt_glyph_get(kq, font, infos[i].codepoint, bucket);
+		if (!g)
+			return false;
+		if (!g->w)
+			continue;
+
+		// The bitmap's top left pixel; bitmap fonts snap the baseline to whole pixels.
+		float x0, y0;
+		if (font->sdf) {
+			x0 = (float)gx / 64.0f + (float)g->left * scale;
+			y0 = (float)gy / 64.0f - (float)g->top * scale;
+		} else {
+			x0 = (float)((gx >> 6) + g->left);
+			y0 = (float)(((gy + 32) >> 6) - g->top);
+		}
+		const float w = (float)g->w * scale;
+		const float h = (float)g->h * scale;
+
+		const kq_tile_instance inst = {
+			.position = {(x0 + w * 0.5f) * px_w - 1.0f, (y0 + h * 0.5f) * px_h - 1.0f},
+			.scale = {w * 0.5f * px_w, h * 0.5f * px_h},
+			.uv_rect = {(float)g->x * texel, (float)g->y * texel, (float)(g->x + g->w) * texel, (float)(g->y + g->h) * texel},
+			.color = rgba,
+			.layer = g->layer,
+			.flags = flags,
+		};
+		if (out) {
+			if (!vecinst_push_back(out, &inst)) {
+				KQ_OOM_MSG();
+				return false;
+			}
+		} else {
+			kq_tile_instance *dst = kqvk_batch_push(kq);
+			if (!dst)
+				return false;
+			*dst = inst;
+			kqvk_damage_add(kq, 1, &inst, 0);
+			++kq->stats.quads;
+		}
+	}
+
+	return true;
+}
+
+static u64 kqtxt_shape_hash(const kq_font font[static 1], size_t len, const char text[static len]) {
+	// FNV-1a over the text, finalised together with the font; the rest of the key rarely varies.
+	u64 h = 0xCBF29CE484222325ULL;
+	for (size_t i = 0; i < len; ++i)
+		h = (h ^ (u8)text[i]) * 0x100000001B3ULL;
+	return kqtxt_hash(h ^ ((u64)font->id << 32 | font->size));
+}
+
+static void kqtxt_shape_lru_unlink(kq_data kq[static 1], u32 i) {
+	kq_shape_run *r = &kq->shape_runs[i];
+	if (r->prev == KQ_SHAPE_NONE)
+		kq->shape_lru_head = r->next;
+	else
+		kq->shape_runs[r->prev].next = r->next;
+	if (r->next == KQ_SHAPE_NONE)
+		kq->shape_lru_tail = r->prev;
+	else
+		kq->shape_runs[r->next].prev = r->prev;
+}
+
+static void kqtxt_shape_lru_push(kq_data kq[static 1], u32 i) {
+	kq_shape_run *r = &kq->shape_runs[i];
+	r->prev = KQ_SHAPE_NONE;
+	r->next = kq->shape_lru_head;
+	if (kq->shape_lru_head == KQ_SHAPE_NONE)
+		kq->shape_lru_tail = i;
+	else
+		kq->shape_runs[kq->shape_lru_head].prev = i;
+	kq->shape_lru_head = i;
+}
+
+static void kqtxt_shape_evict_lru(kq_data kq[static 1]) {
+	const u32     i = kq->shape_lru_tail;
+	kq_shape_run *r = &kq->shape_runs[i];
+
+	u32 *link = &kq->shape_buckets[r->hash & (KQ_SHAPE_CACHE_ENTRIES - 1)];
+	while (*link != i)
+		link = &kq->shape_runs[*link].chain;
+	*link = r->chain;
+
+	kqtxt_shape_lru_unlink(kq, i);
+	free(r->infos);
+	kq->shape_bytes -= r->bytes;
+	--kq->shape_count;
+	r->chain = kq->shape_free;
+	kq->shape_free = i;
+}
+
+bool kqtxt_shape(kq_data                     kq[restrict static 1],
+                 const kq_font               font[restrict static 1],
+                 size_t                      len,
+                 const char                  text[restrict len],
+                 hb_direction_t              direction,
+                 hb_script_t                 script,
+                 hb_language_t               language,
+                 u32                         count[restrict static 1],
+                 const hb_glyph_info_t     *infos[restrict static 1],
+                 const hb_glyph_position_t *positions[restrict static 1]) {
+	const u64  hash = kqtxt_shape_hash(font, len, text);
+	u32 *const bucket = &kq->shape_buckets[hash & (KQ_SHAPE_CACHE_ENTRIES - 1)];
+
+	for (u32 i = *bucket; i != KQ_SHAPE_NONE; i = kq->shape_runs[i].chain) {
+		const kq_shape_run *r = &kq->shape_runs[i];
+		if (r->hash == hash && r->font_id == font->id && r->size == font->size && r->direction == direction && r->script == script
+		    && r->language == language && r->text_len == len && !memcmp(r->text, text, len)) {
+			kqtxt_shape_lru_unlink(kq, i);
+			kqtxt_shape_lru_push(kq, i);
+			*count = r->count;
+			*infos = r->infos;
+			*positions = r->positions;
+			++kq->stats.shape_hits;
+			return true;
+		}
+	}
+
+	KQ_PROF_SCOPE("hb_shape");
+	++kq->stats.shape_misses;
+	hb_buffer_clear_contents(kq->hb_buf);
+	hb_buffer_add_utf8(kq->hb_buf, text, (int)len, 0, (int)len);
+	if (direction != HB_DIRECTION_INVALID)
+		hb_buffer_set_direction(kq->hb_buf, direction);
+	if (script != HB_SCRIPT_INVALID)
+		hb_buffer_set_script(kq->hb_buf, script);
+	if (language != HB_LANGUAGE_INVALID)
+		hb_buffer_set_language(kq->hb_buf, language);
+	hb_buffer_guess_segment_properties(kq->hb_buf);
+	hb_shape(font->hb_font, kq->hb_buf, 0, 0);
+
+	*infos = hb_buffer_get_glyph_infos(kq->hb_buf, count);
+	*positions = hb_buffer_get_glyph_positions(kq->hb_buf, 0);
+
+	// Runs too big to be worth the cache are still drawn, straight from the HarfBuzz buffer.
+	const size_t bytes = *count * (sizeof(hb_glyph_info_t) + sizeof(hb_glyph_position_t)) + len;
+	if (bytes > KQ_SHAPE_CACHE_BYTES / 4)
+		return true;
+
+	while (kq->shape_count && (kq->shape_count == KQ_SHAPE_CACHE_ENTRIES || kq->shape_bytes + bytes > KQ_SHAPE_CACHE_BYTES))
+		kqtxt_shape_evict_lru(kq);
+
+	// Not being able to cache only costs speed.
+	hb_glyph_info_t *block = malloc(bytes ? bytes : 1U);
+	if (!block)
+		return true;
+
+	const u32     i = kq->shape_free;
+	kq_shape_run *r = &kq->shape_runs[i];
+	kq->shape_free = r->chain;
+	*r = (kq_shape_run){
+		.hash = hash,
+		.font_id = font->id,
+		.size = font->size,
+		.direction = direction,
+		.script = script,
+		.language = language,
+		.text_len = (u32)len,
+		.count = *count,
+		.infos = block,
+		.positions = (hb_glyph_position_t *)(block + *count),
+		.bytes = bytes,
+		.chain = *bucket,
+	};
+	r->text = (const char *)(r->positions + *count);
+	memcpy(r->infos, *infos, *count * sizeof(hb_glyph_info_t));
+	memcpy(r->positions, *positions, *count * sizeof(hb_glyph_position_t));
+	memcpy((char *)r->text, text, len);
+	*bucket = i;
+	kqtxt_shape_lru_push(kq, i);
+	kq->shape_bytes += bytes;
+	++kq->shape_count;
+	return true;
+}
+
+// Growing geometrically, unlike the vecs' own resize.
+#define kqtxt_mk_splice(name, type)                                                                                   \
+	static bool name##_reserve(name vec[static 1], size_t size) {                                                 \
+		return size <= vec->cap || name##_realloc(vec, size > vec->cap * 2 ? size : vec->cap * 2);            \
+	}                                                                                                             \
+                                                                                                                      \
+	/* Replaces old_n elements at at with new_n from src, or uninitialised ones if src is 0. Must be reserved. */ \
+	static void name##_splice(name vec[restrict static 1], size_t at, size_t old_n, size_t new_n, const type *restrict src) { \
+		memmove(&vec->p[at + new_n], &vec->p[at + old_n], (vec->size - at - old_n) * sizeof(type));           \
+		if (src)                                                                                              \
+			memcpy(&vec->p[at], src, new_n * sizeof(type));                                               \
+		vec->size = vec->size - old_n + new_n;                                                                \
+	}
+
+kqtxt_mk_splice(vecchar, char)
+kqtxt_mk_splice(vecu8, u8)
+kqtxt_mk_splice(vecline, kq_text_line)
+kqtxt_mk_splice(vecinst, kq_tile_instance)
+
+// Where a text offset ends up after replacing removed bytes at at; offsets inside the removed bytes collapse onto at.
+static u32 kqtxt_offset_shift(u32 x, u32 at, u32 removed, u32 inserted) {
+	return x <= at ? x : x >= at + removed ? x - removed + inserted : at;
+}
+
+bool kqtxt_box_splice_text(kq_text_box box[restrict static 1], u32 at, u32 removed, u32 inserted, const char *restrict text, u32 style) {
+	const u32 len = (u32)box->text->size;
+	if (at > len || removed > len - at) {
+		LOGM_ERROR("Text edit of bytes %u to %u is outside the box's %u.", at, at + removed, len);
+		return false;
+	}
+	if (inserted && style >= box->styles_count) {
+		LOGM_ERROR("Text box has no style %u.", style);
+		return false;
+	}
+
+	const size_t new_len = (size_t)len - removed + inserted;
+	if (!vecchar_reserve(box->text, new_len) || !vecu8_reserve(box->text_styles, new_len)) {
+		KQ_OOM_MSG();
+		return false;
+	}
+	vecchar_splice(box->text, at, removed, inserted, text);
+	vecu8_splice(box->text_styles, at, removed, inserted, 0);
+	memset(&box->text_styles->p[at], (int)style, inserted);
+
+	// Lines after the edit move with it, so layout can recognise where it rejoins them.
+	kq_text_line *lines = box->lines->p;
+	u32           first = 0;
+	for (u32 i = 0U; i < box->lines->size; ++i) {
+		if (lines[i].start <= at)
+			first = i;
+		lines[i].start = kqtxt_offset_shift(lines[i].start, at, removed, inserted);
+		lines[i].end = kqtxt_offset_shift(lines[i].end, at, removed, inserted);
+	}
+
+	// Shortening a line's first word can pull it up onto the line before.
+	if (first) {
+		const char *t = box->text->p;
+		u32         word_end = lines[first].start;
+		while (word_end < new_len && t[word_end] != ' ' && t[word_end] != '\n')
+			++word_end;
+		if (at <= word_end)
+			--first;
+	}
+
+	if (box->dirty_line == KQ_TEXT_CLEAN) {
+		box->dirty_line = first;
+		box->dirty_end = at + inserted;
+	} else {
+		const u32 end = kqtxt_offset_shift(box->dirty_end, at, removed, inserted);
+		box->dirty_line = first < box->dirty_line ? first : box->dirty_line;
+		box->dirty_end = end > at + inserted ? end : at + inserted;
+	}
+	return true;
+}
+
+// Text boxes let HarfBuzz guess direction, script and language.
+static inline bool kqtxt_box_shape(kq_data                     kq[restrict static 1],
+                                   const kq_font               font[restrict static 1],
+                                   u32                         len,
+                                   const char                  text[restrict len],
+                                   u32                         count[restrict static 1],
+                                   const hb_glyph_info_t     *infos[restrict static 1],
+                                   const hb_glyph_position_t *positions[restrict static 1]) {
+	return kqtxt_shape(kq, font, len, text, HB_DIRECTION_INVALID, HB_SCRIPT_INVALID, HB_LANGUAGE_INVALID, count, infos, positions);
+}
+
+// Measures the word at i (non-spaces, then spaces): where it ends, its advance, and its advance up to its last non-space.
+static bool kqtxt_box_word(kq_data           kq[restrict static 1],
+                           const kq_text_box box[restrict static 1],
+                           u32               i,
+                           u32               end[restrict static 1],
+                           float             adv[restrict static 1],
+                           float             ink[restrict static 1]) {
+	const char *t = box->text->p;
+	const u8   *st = box->text_styles->p;
+	const u32   len = (u32)box->text->size;
+
+	u32 j = i;
+	while (j < len && t[j] != ' ' && t[j] != '\n')
+		++j;
+	const u32 ink_end = j;
+	while (j < len && t[j] == ' ')
+		++j;
+	*end = j;
+
+	*adv = 0.0f;
+	*ink = 0.0f;
+	for (u32 p = i, q; p < j; p = q) {
+		for (q = p; q < j && st[q] == st[p];)
+			++q;
+
+		const kq_font             *font = box->styles[st[p]].font;
+		u32                        count;
+		const hb_glyph_info_t     *infos;
+		const hb_glyph_position_t *positions;
+		if (!kqtxt_box_shape(kq, font, q - p, t + p, &count, &infos, &positions))
+			return false;
+
+		for (u32 g = 0U; g < count; ++g) {
+			*adv += (float)positions[g].x_advance * font->scale / 64.0f;
+			if (p + infos[g].cluster < ink_end)
+				*ink = *adv;
+		}
+	}
+	return true;
+}
+
+// Breaks and emits the line starting at byte start, as line index of the box. Instances go to the scratch vec, and
+// line->inst_first is relative to it.
+static bool kqtxt_box_layout_line(kq_data      kq[restrict static 1],
+                                  kq_text_box  box[restrict static 1],
+                                  u32          start,
+                                  u32          index,
+                                  kq_text_line line[restrict static 1]) {
+	const char *t = box->text->p;
+	const u8   *st = box->text_styles->p;
+	const u32   len = (u32)box->text->size;
+
+	// Greedy: take words while their ink fits, but always at least one.
+	float x = 0.0f, ink_width = 0.0f;
+	u32   end = start;
+	while (end < len && t[end] != '\n') {
+		u32   word_end;
+		float adv, ink;
+		if (!kqtxt_box_word(kq, box, end, &word_end, &adv, &ink))
+			return false;
+		if (end > start && x + ink > box->width)
+			break;
+		ink_width = x + ink;
+		x += adv;
+		end = word_end;
+	}
+	const u32 ink_end = end;
+	if (end < len && t[end] == '\n')
+		++end;
+
+	float offset = 0.0f;
+	if (box->align == KQ_TEXT_ALIGN_CENTER)
+		offset = (box->width - ink_width) * 0.5f;
+	else if (box->align == KQ_TEXT_ALIGN_RIGHT)
+		offset = box->width - ink_width;
+
+	// The first style's ascender puts the baseline inside the line.
+	const kq_font *first_font = box->styles[0].font;
+	const float    ascender = (float)first_font->face->size->metrics.ascender / 64.0f * first_font->scale;
+	s64            pen[2] = {
+		           (s64)((box->origin[0] + offset) * 64.0f),
+		           (s64)((box->origin[1] + (float)index * box->line_height + ascender) * 64.0f),
+	};
+
+	line->start = start;
+	line->end = end;
+	line->inst_first = (u32)box->scratch_instances->size;
+
+	// Shaped in the same pieces as measured, so this all comes from the run cache.
+	for (u32 w = start, w_end; w < ink_end; w = w_end) {
+		for (w_end = w; w_end < ink_end && t[w_end] != ' ';)
+			++w_end;
+		while (w_end < ink_end && t[w_end] == ' ')
+			++w_end;
+
+		for (u32 p = w, q; p < w_end; p = q) {
+			for (q = p; q < w_end && st[q] == st[p];)
+				++q;
+
+			const kq_text_style       *style = &box->styles[st[p]];
+			u32                        count;
+			const hb_glyph_info_t     *infos;
+			const hb_glyph_position_t *positions;
+			if (!kqtxt_box_shape(kq, style->font, q - p, t + p, &count, &infos, &positions)
+			    || !kqtxt_draw_run(kq, style->font, count, infos, positions, pen, style->rgba, box->scratch_instances))
+				return false;
+		}
+	}
+
+	line->inst_count = (u32)box->scratch_instances->size - line->inst_first;
+	for (size_t i = line->inst_first; i < box->scratch_instances->size; ++i)
+		box->atlas_layers_used |= 1U << box->scratch_instances->p[i].layer;
+	return true;
+}
+
+bool kqtxt_box_layout(kq_data kq[restrict static 1], kq_text_box box[restrict static 1]) {
+	// Instance positions are in NDC, so a new viewport size means laying everything out again. So do glyphs moving in the atlas.
+	if (box->viewport[0] != kq->viewport.width || box->viewport[1] != kq->viewport.height || box->atlas_epoch != kq->atlas_epoch) {
+		box->viewport[0] = kq->viewport.width;
+		box->viewport[1] = kq->viewport.height;
+		box->atlas_epoch = kq->atlas_epoch;
+		box->atlas_layers_used = 0;
+		if (box->text->size || box->lines->size) {
+			box->dirty_line = 0;
+			box->dirty_end = (u32)box->text->size;
+		}
+	}
+	if (box->dirty_line == KQ_TEXT_CLEAN)
+		return true;
+
+	KQ_PROF_FUNC();
+	vecline  *lines = box->lines;
+	vecinst  *instances = box->instances;
+	const u32 len = (u32)box->text->size;
+	const u32 first = lines->size ? (box->dirty_line < lines->size ? box->dirty_line : (u32)lines->size - 1) : 0;
+	const u32 inst_at = lines->size ? lines->p[first].inst_first : 0;
+	u32       pos = lines->size ? lines->p[first].start : 0;
+
+	// Lay out until a line ends where an unedited old line of the same index starts; from there on, nothing changed.
+	vecline_clear(box->scratch_lines);
+	vecinst_clear(box->scratch_instances);
+	u32 keep = (u32)lines->size;
+	for (u32 index = first; pos < len;) {
+		kq_text_line line;
+		if (!kqtxt_box_layout_line(kq, box, pos, index, &line))
+			return false;
+		line.inst_first += inst_at;
+		if (!vecline_push_back(box->scratch_lines, &line)) {
+			KQ_OOM_MSG();
+			return false;
+		}
+		++kq->stats.text_lines;
+
+		pos = line.end;
+		++index;
+		if (pos > box->dirty_end && index < lines->size && lines->p[index].start == pos) {
+			keep = index;
+			break;
+		}
+	}
+
+	const u32 old_inst_end = keep < lines->size ? lines->p[keep].inst_first : (u32)instances->size;
+	const u32 new_inst_count = (u32)box->scratch_instances->size;
+	const u32 new_line_count = (u32)box->scratch_lines->size;
+	if (!vecinst_reserve(instances, instances->size - (old_inst_end - inst_at) + new_inst_count)
+	    || !vecline_reserve(lines, lines->size - (keep - first) + new_line_count)) {
+		KQ_OOM_MSG();
+		return false;
+	}
+
+	const bool shifted = new_inst_count != old_inst_end - inst_at;
+	for (size_t i = keep; i < lines->size; ++i)
+		lines->p[i].inst_first = lines->p[i].inst_first - (old_inst_end - inst_at) + new_inst_count;
+	vecinst_splice(instances, inst_at, old_inst_end - inst_at, new_inst_count, box->scratch_instances->p);
+	vecline_splice(lines, first, keep - first, new_line_count, box->scratch_lines->p);
+
+	// Instances after the laid out lines only need uploading again if they moved.
+	const u32 upload_end = shifted ? (u32)instances->size : inst_at + new_inst_count;
+	if (box->upload_first >= box->upload_end) {
+		box->upload_first = inst_at;
+		box->upload_end = upload_end;
+	} else {
+		box->upload_first = inst_at < box->upload_first ? inst_at : box->upload_first;
+		box->upload_end = shifted ? (u32)instances->size : upload_end > box->upload_end ? upload_end : box->upload_end;
+	}
+	if (box->upload_end > instances->size)
+		box->upload_end = (u32)instances->size;
+
+	box->dirty_line = KQ_TEXT_CLEAN;
+	box->dirty_end = 0;
+	return true;
+}
+
+bool kqtxt_box_upload(kq_data kq[restrict static 1], kq_text_box box[restrict static 1]) {
+	if (box->retired_buf && kq->stats.frames >= box->retired_frame + KQ_FRAMES_IN_FLIGHT) {
+		vkDestroyBuffer(kq->vk_ldev, box->retired_buf, 0);
+		vkFreeMemory(kq->vk_ldev, box->retired_mem, 0);
+		box->retired_buf = 0;
+	}
+
+	const u32 count = (u32)box->instances->size;
+	if (count > box->buf_cap) {
+		u32 cap = box->buf_cap ? box->buf_cap * 2 : 64U;
+		cap = cap > count ? cap : count;
+
+		// Outgrowing it twice within the frames in flight is rare enough to simply wait.
+		if (box->retired_buf) {
+			vkDeviceWaitIdle(kq->vk_ldev);
+			vkDestroyBuffer(kq->vk_ldev, box->retired_buf, 0);
+			vkFreeMemory(kq->vk_ldev, box->retired_mem, 0);
+			box->retired_buf = 0;
+		}
+
+		VkBuffer       buf;
+		VkDeviceMemory buf_mem;
+		if (!kqvk_buffer_create(kq,
+		                        sizeof(kq_tile_instance) * cap,
+		                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		                        &buf,
+		                        &buf_mem)) {
+			LOGM_ERROR("Unable to create a text box instance buffer of %u instances.", cap);
+			return false;
+		}
+
+		if (box->buf) {
+			box->retired_buf = box->buf;
+			box->retired_mem = box->buf_mem;
+			box->retired_frame = kq->stats.frames;
+		}
+		box->buf = buf;
+		box->buf_mem = buf_mem;
+		box->buf_cap = cap;
+		box->upload_first = 0;
+		box->upload_end = count;
+	}
+
+	// Whatever doesn't fit in this frame's staging goes up next frame.
+	while (box->upload_first < box->upload_end) {
+		const u32 room = (u32)(kqvk_upload_available(kq) / sizeof(kq_tile_instance));
+		if (!room)
+			break;
+
+		const u32              n = box->upload_end - box->upload_first < room ? box->upload_end - box->upload_first : room;
+		VkDeviceSize           offset;
+		kq_tile_instance      *dst = kqvk_upload_reserve(kq, sizeof(kq_tile_instance) * n, &offset);
+		const kq_buffer_upload upload = {
+			.dst = box->buf,
+			.region =
+				(VkBufferCopy){
+					.srcOffset = offset,
+					.dstOffset = sizeof(kq_tile_instance) * box->upload_first,
+					.size = sizeof(kq_tile_instance) * n,
+				},
+		};
+		if (!dst || !vecbufupload_push_back(kq->buffer_uploads, &upload)) {
+			KQ_OOM_MSG();
+			return false;
+		}
+		memcpy(dst, &box->instances->p[box->upload_first], sizeof(kq_tile_instance) * n);
+		box->upload_first += n;
+	}
+	return true;
+}
+
+void kqtxt_atlas_record_uploads(kq_data kq[static 1], VkCommandBuffer cmd_buf) {
+	// Moves copy between layers of the same image, which needs one layout for both ends.
+	const VkImageLayout  layout = kq->atlas_repacked ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		.newLayout = layout,
+		.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = kq->glyph_atlas_image,
+		.subresourceRange = (VkImageSubresourceRange){.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = kq->atlas_layers},
+	};
+	// Earlier frames may still be sampling the atlas; only execution has to wait for them.
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &barrier);
+
+	if (kq->atlas_repacked) {
+		// The old spare still holds whatever it last had as a page.
+		const VkImageSubresourceRange target = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.levelCount = 1,
+			.baseArrayLayer = kq->atlas_repack_layer,
+			.layerCount = 1,
+		};
+		const VkClearColorValue clear = {0};
+		vkCmdClearColorImage(cmd_buf, kq->glyph_atlas_image, layout, &clear, 1, &target);
+
+		barrier.oldLayout = layout;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &barrier);
+		if (kq->atlas_moves->size) {
+			vkCmdCopyImage(cmd_buf,
+			               kq->glyph_atlas_image,
+			               layout,
+			               kq->glyph_atlas_image,
+			               layout,
+			               (u32)kq->atlas_moves->size,
+			               kq->atlas_moves->p);
+			vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &barrier);
+		}
+		vecimgcopy_clear(kq->atlas_moves);
+	}
+
+	if (kq->atlas_regions->size) {
+		vkCmdCopyBufferToImage(cmd_buf,
+		                       kq->upload_bufs[kq->current_frame],
+		                       kq->glyph_atlas_image,
+		                       layout,
+		                       (u32)kq->atlas_regions->size,
+		                       kq->atlas_regions->p);
+		vecregion_clear(kq->atlas_regions);
+	}
+
+	barrier.oldLayout = layout;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, 0, 0, 0, 1, &barrier);
+}
+
+// Widens the distance range of both SDF renderers (outline and bitmap) from FreeType's default of 2 pixels.
+static FT_Error kqtxt_ft_set_spread(FT_Library lib) {
+	const FT_UInt spread = KQ_SDF_SPREAD;
+	const FT_Error e = FT_Property_Set(lib, "sdf", "spread", &spread);
+	return e ? e : FT_Property_Set(lib, "bsdf", "spread", &spread);
+}
+
+// Shared by the SDF workers; each claims the next glyph from next.
+typedef struct kqtxt_sdf_job {
+	const char   *path;
+	FT_F26Dot6    size;
+	u32           count;
+	kq_sdf_glyph *glyphs; // glyph_id filled in, the rest is the output.
+	atomic_uint   next;
+} kqtxt_sdf_job;
+
+static void *kqtxt_sdf_worker(void *arg) {
+	KQ_PROF_FUNC();
+	kqtxt_sdf_job *job = arg;
+
+	// FreeType objects are not thread safe, so every worker gets its own library and face.
+	FT_Library lib;
+	FT_Face    face;
+	if (FT_Init_FreeType(&lib))
+		return 0;
+	if (kqtxt_ft_set_spread(lib) || FT_New_Face(lib, job->path, 0, &face)) {
+		FT_Done_FreeType(lib);
+		return 0;
+	}
+	FT_Set_Char_Size(face, 0, job->size, 72, 72);
+
+	for (u32 i; (i = atomic_fetch_add_explicit(&job->next, 1U, memory_order_relaxed)) < job->count;) {
+		kq_sdf_glyph *g = &job->glyphs[i];
+		if (FT_Load_Glyph(face, g->glyph_id, FT_LOAD_DEFAULT) || FT_Render_Glyph(face->glyph, FT_RENDER_MODE_SDF))
+			continue;
+
+		const FT_Bitmap *bm = &face->glyph->bitmap;
+		if (bm->pixel_mode != FT_PIXEL_MODE_GRAY && bm->width && bm->rows)
+			continue;
+
+		g->w = (u16)bm->width;
+		g->h = (u16)bm->rows;
+		g->left = (s16)face->glyph->bitmap_left;
+		g->top = (s16)face->glyph->bitmap_top;
+		// Empty glyphs still get a (zero byte) allocation, to tell them apart from failures.
+		g->pixels = malloc((size_t)bm->width * bm->rows + 1U);
+		if (!g->pixels)
+			continue;
+		for (u32 row = 0U; row < bm->rows; ++row)
+			memcpy(g->pixels + (size_t)row * bm->width, bm->buffer + (ptrdiff_t)row * bm->pitch, bm->width);
+	}
+
+	FT_Done_Face(face);
+	FT_Done_FreeType(lib);
+	return 0;
+}
+
+static int kqtxt_u32_cmp(const void *a, const void *b) {
+	const u32 x = *(const u32 *)a;
+	const u32 y = *(const u32 *)b;
+	return (x > y) - (x < y);
+}
+
+bool kqtxt_sdf_prebake(kq_font font[static 1], const char path[static 1]) {
+	KQ_PROF_FUNC();
+	u32 ids[KQ_SDF_PREBAKE_LAST - KQ_SDF_PREBAKE_FIRST + 1];
+	u32 count = 0U;
+	for (FT_ULong c = KQ_SDF_PREBAKE_FIRST; c <= KQ_SDF_PREBAKE_LAST; ++c) {
+		const FT_UInt id = FT_Get_Char_Index(font->face, c);
+		if (id)
+			ids[count++] = id;
+	}
+
+	// Deduplicated and sorted, for bsearch() in kqtxt_rasterize_sdf().
+	qsort(ids, count, sizeof(u32), kqtxt_u32_cmp);
+	u32 unique = 0U;
+	for (u32 i = 0U; i < count; ++i) {
+		if (!unique || ids[unique - 1] != ids[i])
+			ids[unique++] = ids[i];
+	}
+
+	font->sdf_glyphs = calloc(unique ? unique : 1U, sizeof(kq_sdf_glyph));
+	if (!font->sdf_glyphs) {
+		KQ_OOM_MSG();
+		return false;
+	}
+	font->sdf_count = unique;
+	for (u32 i = 0U; i < unique; ++i)
+		font->sdf_glyphs[i].glyph_id = ids[i];
+
+	kqtxt_sdf_job job = {.path = path, .size = (FT_F26Dot6)font->size, .count = unique, .glyphs = font->sdf_glyphs};
+	atomic_init(&job.next, 0U);
+
+	const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	const u32  wanted = cpus < 1 ? 1U : cpus > KQ_SDF_WORKERS_MAX ? KQ_SDF_WORKERS_MAX : (u32)cpus;
+	pthread_t  workers[KQ_SDF_WORKERS_MAX];
+	u32        started = 0U;
+	while (started < wanted && !pthread_create(&workers[started], 0, kqtxt_sdf_worker, &job))
+		++started;
+
+	// Without any threads this still works, just serially.
+	if (!started)
+		kqtxt_sdf_worker(&job);
+	for (u32 i = 0U; i < started; ++i)
+		pthread_join(workers[i], 0);
+
+	// Glyphs that failed here are retried on the main thread when first drawn.
+	u32 failed = 0U;
+	for (u32 i = 0U; i < unique; ++i)
+		failed += !font->sdf_glyphs[i].pixels;
+	LOGM_DEBUG("Generated %u distance fields on %u threads; %u failed.", unique - failed, started ? started : 1U, failed);
+	return true;
+}
+
+void kqtxt_sdf_free(kq_font font[static 1]) {
+	for (u32 i = 0U; i < font->sdf_count; ++i)
+		free(font->sdf_glyphs[i].pixels);
+	free(font->sdf_glyphs);
+	font->sdf_glyphs = 0;
+	font->sdf_count = 0;
+}
+
+// Creates an atlas image of layers layers and its view, cleared, with the first old_layers layers of old copied in if it isn't 0.
+static bool kqtxt_atlas_create(kq_data        kq[static 1],
+                               u32            layers,
+                               VkImage        old,
+                               u32            old_layers,
+                               VkImage        image[static 1],
+                               VkDeviceMemory mem[static 1],
+                               VkImageView    view[static 1]) {
+	if (!kqvk_image_create(kq,
+	                       KQ_GLYPH_ATLAS_SIZE,
+	                       KQ_GLYPH_ATLAS_SIZE,
+	                       layers,
+	                       VK_FORMAT_R8_UNORM,
+	                       VK_IMAGE_TILING_OPTIMAL,
+	                       VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+	                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	                       image,
+	                       mem)) {
+		LOGM_ERROR("Unable to create glyph atlas.");
+		return false;
+	}
+
+	// Padding texels are never written, so start from all zero.
+	const VkImageSubresourceRange range = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = layers};
+	VkImageMemoryBarrier          barrier = {
+				 .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				 .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				 .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				 .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+				 .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				 .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				 .image = *image,
+				 .subresourceRange = range,
+	};
+	const VkClearColorValue clear = {0};
+
+	VkCommandBuffer cmd_buf = kqvk_single_time_command_begin(kq);
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &barrier);
+	vkCmdClearColorImage(cmd_buf, *image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clear, 1, &range);
+	if (old) {
+		// The caller has waited for the device, so the old image is only read from here on.
+		const VkImageMemoryBarrier src_barrier = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = old,
+			.subresourceRange = (VkImageSubresourceRange){.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = old_layers},
+		};
+		const VkImageCopy copy = {
+			.srcSubresource = (VkImageSubresourceLayers){.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = old_layers},
+			.dstSubresource = (VkImageSubresourceLayers){.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = old_layers},
+			.extent = (VkExtent3D){.width = KQ_GLYPH_ATLAS_SIZE, .height = KQ_GLYPH_ATLAS_SIZE, .depth = 1},
+		};
+		vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &src_barrier);
+
+		// The clear and the copy both write the old layers.
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &barrier);
+		vkCmdCopyImage(cmd_buf, old, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, *image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+	}
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, 0, 0, 0, 1, &barrier);
+	kqvk_single_time_command_end(kq, cmd_buf);
+
+	rend_info.glyph_atlas_view_cinfo.image = *image;
+	rend_info.glyph_atlas_view_cinfo.subresourceRange.layerCount = layers;
+	if (vkCreateImageView(kq->vk_ldev, &rend_info.glyph_atlas_view_cinfo, 0, view)) {
+		LOGM_ERROR("Unable to create glyph atlas view.");
+		vkDestroyImage(kq->vk_ldev, *image, 0);
+		vkFreeMemory(kq->vk_ldev, *mem, 0);
+		return false;
+	}
+	return true;
+}
+
+static bool kqtxt_create_atlas(kq_data kq[static 1]) {
+	if (!kqtxt_atlas_create(kq, KQ_GLYPH_ATLAS_LAYERS_INIT, 0, 0, &kq->glyph_atlas_image, &kq->glyph_atlas_mem, &kq->glyph_atlas_view))
+		return false;
+	kq->atlas_layers = KQ_GLYPH_ATLAS_LAYERS_INIT;
+	kq->atlas_spare = KQ_GLYPH_ATLAS_LAYERS_INIT - 1;
+
+	if (vkCreateSampler(kq->vk_ldev, &rend_info.glyph_atlas_sampler_cinfo, 0, &kq->glyph_atlas_sampler)) {
+		LOGM_FATAL("Unable to create glyph atlas sampler.");
+		vkDestroyImageView(kq->vk_ldev, kq->glyph_atlas_view, 0);
+		vkDestroyImage(kq->vk_ldev, kq->glyph_atlas_image, 0);
+		vkFreeMemory(kq->vk_ldev, kq->glyph_atlas_mem, 0);
+		return false;
+	}
+
+	rend_info.glyph_atlas_sampler_write.imageView = kq->glyph_atlas_view;
+	rend_info.glyph_atlas_sampler_write.sampler = kq->glyph_atlas_sampler;
+	return true;
+}
+
+bool kqtxt_atlas_grow(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
+	kq->atlas_grow_pending = false;
+	const u32 pages = kq->atlas_layers - 1;
+	const u32 layers = 2 * pages + 1 < KQ_GLYPH_ATLAS_LAYERS_MAX ? 2 * pages + 1 : KQ_GLYPH_ATLAS_LAYERS_MAX;
+
+	// Every frame in flight samples the old image through its descriptor set.
+	vkDeviceWaitIdle(kq->vk_ldev);
+
+	VkImage        image;
+	VkDeviceMemory mem;
+	VkImageView    view;
+	if (!kqtxt_atlas_create(kq, layers, kq->glyph_atlas_image, kq->atlas_layers, &image, &mem, &view))
+		return false;
+
+	vkDestroyImageView(kq->vk_ldev, kq->glyph_atlas_view, 0);
+	vkDestroyImage(kq->vk_ldev, kq->glyph_atlas_image, 0);
+	vkFreeMemory(kq->vk_ldev, kq->glyph_atlas_mem, 0);
+	kq->glyph_atlas_image = image;
+	kq->glyph_atlas_mem = mem;
+	kq->glyph_atlas_view = view;
+
+	// Layers keep their index, so no glyph moves; the old spare stays the spare.
+	LOGM_DEBUG("Glyph atlas grown from %u to %u layers.", kq->atlas_layers, layers);
+	kq->atlas_layers = layers;
+
+	rend_info.glyph_atlas_sampler_write.imageView = view;
+	for (size_t i = 0; i < KQ_FRAMES_IN_FLIGHT; ++i) {
+		rend_info.desc_write[2].dstSet = kq->desc_sets[i];
+		vkUpdateDescriptorSets(kq->vk_ldev, 1, &rend_info.desc_write[2], 0, 0);
+	}
+	return true;
+}
+
+bool kqtxt_init(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
+	const FT_Error e = FT_Init_FreeType(&kq->ft_lib);
+	if (e) {
+		LOGM_FATAL("Error during FreeType initialization: %s.", FT_Error_String(e));
+		goto fail_FT_Init_FreeType;
+	}
+	if (kqtxt_ft_set_spread(kq->ft_lib))
+		LOGM_WARN("Unable to set the SDF spread; distance fields will be narrower than expected.");
+
+	kq->hb_buf = hb_buffer_create();
+	if (!hb_buffer_allocation_successful(kq->hb_buf)) {
+		KQ_OOM_MSG();
+		goto fail_hb_buffer_create;
+	}
+	hb_buffer_set_unicode_funcs(kq->hb_buf, hb_icu_get_unicode_funcs());
+
+	kq->glyphs_cap = KQ_GLYPH_CACHE_INITIAL_CAP;
+	kq->glyphs_count = 0;
+	kq->glyphs = calloc(kq->glyphs_cap, sizeof(kq_glyph));
+	if (!kq->glyphs) {
+		KQ_OOM_MSG();
+		goto fail_glyphs;
+	}
+
+	kq->atlas_shelves = vecshelf_create(0);
+	if (!kq->atlas_shelves) {
+		KQ_OOM_MSG();
+		goto fail_atlas_shelves;
+	}
+	memset(kq->atlas_next_y, 0, sizeof kq->atlas_next_y);
+	memset(kq->atlas_layer_used, 0, sizeof kq->atlas_layer_used);
+	kq->atlas_epoch = 0;
+	kq->atlas_grow_pending = false;
+	kq->atlas_repacked = false;
+
+	kq->atlas_moves = vecimgcopy_create(0);
+	if (!kq->atlas_moves) {
+		KQ_OOM_MSG();
+		goto fail_atlas_moves;
+	}
+
+	kq->atlas_regions = vecregion_create(0);
+	if (!kq->atlas_regions) {
+		KQ_OOM_MSG();
+		goto fail_atlas_regions;
+	}
+
+	kq->shape_runs = malloc(sizeof(kq_shape_run[KQ_SHAPE_CACHE_ENTRIES]));
+	if (!kq->shape_runs) {
+		KQ_OOM_MSG();
+		goto fail_shape_runs;
+	}
+	for (u32 i = 0U; i < KQ_SHAPE_CACHE_ENTRIES; ++i) {
+		kq->shape_runs[i].chain = i + 1 < KQ_SHAPE_CACHE_ENTRIES ? i + 1 : KQ_SHAPE_NONE;
+		kq->shape_buckets[i] = KQ_SHAPE_NONE;
+	}
+	kq->shape_free = 0;
+	kq->shape_lru_head = KQ_SHAPE_NONE;
+	kq->shape_lru_tail = KQ_SHAPE_NONE;
+	kq->shape_count = 0;
+	kq->shape_bytes = 0;
+
+	if (!kqtxt_create_atlas(kq))
+		goto fail_create_atlas;
+
+	LOGM_TRACE("Text initialised.");
+	return true;
+
+fail_create_atlas:
+	free(kq->shape_runs);
+fail_shape_runs:
+	vecregion_destroy(kq->atlas_regions);
+fail_atlas_regions:
+	vecimgcopy_destroy(kq->atlas_moves);
+fail_atlas_moves:
+	vecshelf_destroy(kq->atlas_shelves);
+fail_atlas_shelves:
+	free(kq->glyphs);
+fail_glyphs:
+fail_hb_buffer_create:
+	hb_buffer_destroy(kq->hb_buf);
+	FT_Done_FreeType(kq->ft_lib);
+fail_FT_Init_FreeType:
+	return false;
+}
+
+void kqtxt_stop(kq_data kq[static 1]) {
+	vkDestroySampler(kq->vk_ldev, kq->glyph_atlas_sampler, 0);
+	vkDestroyImageView(kq->vk_ldev, kq->glyph_atlas_view, 0);
+	vkDestroyImage(kq->vk_ldev, kq->glyph_atlas_image, 0);
+	vkFreeMemory(kq->vk_ldev, kq->glyph_atlas_mem, 0);
+	while (kq->shape_count)
+		kqtxt_shape_evict_lru(kq);
+	free(kq->shape_runs);
+	vecregion_destroy(kq->atlas_regions);
+	vecimgcopy_destroy(kq->atlas_moves);
+	vecshelf_destroy(kq->atlas_shelves);
+	free(kq->glyphs);
+	hb_buffer_destroy(kq->hb_buf);
+	FT_Done_FreeType(kq->ft_lib);
+}
+
+
+cb_impl_vec(vecshelf, kq_atlas_shelf);
+cb_impl_vec(vecregion, VkBufferImageCopy);
+cb_impl_vec(vecimgcopy, VkImageCopy);
+cb_impl_vec(vecchar, char);
+cb_impl_vec(vecu8, u8);
+cb_impl_vec(vecline, kq_text_line);
+cb_impl_vec(vecinst, kq_tile_instance);
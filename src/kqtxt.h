@@ -0,0 +1,69 @@
+#ifndef KQTXT_H_
+#define KQTXT_H_
+
+#include <stdbool.h>
+
+#include <glad/vulkan.h>
+
+#include <hb.h>
+
+#include <libcbase/common.h>
+
+#include <kq.h>
+
+
+// FreeType, the HarfBuzz buffer, the glyph atlas and its cache. Must run before the descriptor sets are written.
+extern bool kqtxt_init(kq_data kq[static 1]);
+
+extern void kqtxt_stop(kq_data kq[static 1]);
+
+// The cached glyph, rasterising and queueing its upload on a miss; 0 if it could not be rasterised or placed.
+extern const kq_glyph *kqtxt_glyph_get(kq_data kq[static 1], const kq_font font[static 1], u32 glyph_id, u32 subpixel_bucket);
+
+// Shapes len bytes of text, or returns an identical earlier call's glyphs from the LRU cache without touching HarfBuzz. Invalid
+// direction, script or language are guessed from the text. The arrays are valid until the next call.
+extern bool kqtxt_shape(kq_data                     kq[restrict static 1],
+                        const kq_font               font[restrict static 1],
+                        size_t                      len,
+                        const char                  text[restrict len],
+                        hb_direction_t              direction,
+                        hb_script_t                 script,
+                        hb_language_t               language,
+                        u32                         count[restrict static 1],
+                        const hb_glyph_info_t     *infos[restrict static 1],
+                        const hb_glyph_position_t *positions[restrict static 1]);
+
+// Appends glyph instances for a shaped run to out, or to the frame's batch if out is 0. The pen is in pixels, 26.6 fixed
+// point, and is left after the run.
+extern bool kqtxt_draw_run(kq_data                    kq[restrict static 1],
+                           const kq_font              font[restrict static 1],
+                           u32                        count,
+                           const hb_glyph_info_t      infos[restrict count],
+                           const hb_glyph_position_t positions[restrict count],
+                           s64                        pen[restrict static 2],
+                           u32                        rgba,
+                           vecinst                   *out);
+
+// Generates the distance fields of the prebaked codepoint range on worker threads, each with its own FreeType face.
+extern bool kqtxt_sdf_prebake(kq_font font[static 1], const char path[static 1]);
+
+extern void kqtxt_sdf_free(kq_font font[static 1]);
+
+// Replaces removed bytes of the box's text at at with inserted bytes of text in style, and marks the lines to lay out.
+extern bool kqtxt_box_splice_text(kq_text_box box[restrict static 1], u32 at, u32 removed, u32 inserted, const char *restrict text, u32 style);
+
+// Lays out the lines edits touched, until layout rejoins the old lines.
+extern bool kqtxt_box_layout(kq_data kq[restrict static 1], kq_text_box box[restrict static 1]);
+
+// Stages the changed instances for copying into the box's buffer, growing it if needed.
+extern bool kqtxt_box_upload(kq_data kq[restrict static 1], kq_text_box box[restrict static 1]);
+
+// Replaces the full atlas with one of about twice the pages, copying the glyphs across. Waits for the device, so it is only
+// called between frames, when the last one asked for it.
+extern bool kqtxt_atlas_grow(kq_data kq[static 1]);
+
+// Records the atlas copies queued this frame into cmd_buf, the eviction's clear and moves first, bracketed by layout
+// transitions.
+extern void kqtxt_atlas_record_uploads(kq_data kq[static 1], VkCommandBuffer cmd_buf);
+
+#endif /* KQTXT_H_ */
@@ -1,10 +1,15 @@
 #include <kqvk.h>
 
+#include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <tgmath.h>
+#include <time.h>
 
 #include <glad/vulkan.h>
 #include <kq.h>
+#include <kq_prof.h>
+#include <kqtxt.h>
 #include <libcbase/log.h>
 #include <libcbase/fs.h>
 
@@ -18,6 +23,7 @@ static const u32         kqvk_wanted_validation_layers_count = sizeof kqvk_wante
 vecstr                  *kqvk_validation_layers_vec = 0;
 #endif /* KQ_DEBUG */
 vecstr *kqvk_instance_exts_vec = 0;
+vecstr *kqvk_device_exts_vec = 0;
 
 
 #if KQ_DEBUG
@@ -69,15 +75,16 @@ bool kqvk_instance_add_validation_layers(VkInstanceCreateInfo instance_cinfo[sta
 }
 #endif /* KQ_DEBUG */
 
-bool kqvk_instance_add_extensions(VkInstanceCreateInfo instance_cinfo[static 1]) {
+bool kqvk_instance_add_extensions(VkInstanceCreateInfo instance_cinfo[static 1], bool headless) {
 	kqvk_instance_exts_vec = vecstr_create(0);
 	if (!kqvk_instance_exts_vec) {
 		KQ_OOM_MSG();
 		return false;
 	}
 
+	// Without a surface, nothing is required.
 	u32          req_exts_count = 0;
-	const char **exts = glfwGetRequiredInstanceExtensions(&req_exts_count);
+	const char **exts = headless ? 0 : glfwGetRequiredInstanceExtensions(&req_exts_count);
 
 	for (u32 i = 0; i < req_exts_count; ++i) {
 		LOGM_DEBUG("Enabling required instance extension %s.", exts[i]);
@@ -126,7 +133,98 @@ bool kqvk_check_pdev_for_extension(VkPhysicalDevice pdev, const char ext[restric
 	return found;
 }
 
+bool kqvk_device_add_extensions(kq_data kq[static 1]) {
+	kqvk_device_exts_vec = vecstr_create(0);
+	if (!kqvk_device_exts_vec) {
+		KQ_OOM_MSG();
+		return false;
+	}
+
+	const char *swapchain_ext = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+	if (!kq->headless && !vecstr_push_back(kqvk_device_exts_vec, &swapchain_ext)) {
+		KQ_OOM_MSG();
+		vecstr_destroy(kqvk_device_exts_vec);
+		return false;
+	}
+
+	const char *budget_ext = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+	if (kqvk_check_pdev_for_extension(kq->vk_pdev, budget_ext)) {
+		LOGM_DEBUG("Enabling optional device extension %s.", budget_ext);
+		if (!vecstr_push_back(kqvk_device_exts_vec, &budget_ext)) {
+			KQ_OOM_MSG();
+			vecstr_destroy(kqvk_device_exts_vec);
+			return false;
+		}
+		kq->has_memory_budget = true;
+	}
+
+	const char *incremental_ext = VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME;
+	if (!kq->headless && kqvk_check_pdev_for_extension(kq->vk_pdev, incremental_ext)) {
+		LOGM_DEBUG("Enabling optional device extension %s.", incremental_ext);
+		if (!vecstr_push_back(kqvk_device_exts_vec, &incremental_ext)) {
+			KQ_OOM_MSG();
+			vecstr_destroy(kqvk_device_exts_vec);
+			return false;
+		}
+		kq->has_incremental_present = true;
+	}
+
+	const char *timing_ext = VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME;
+	if (!kq->headless && kqvk_check_pdev_for_extension(kq->vk_pdev, timing_ext)) {
+		LOGM_DEBUG("Enabling optional device extension %s.", timing_ext);
+		if (!vecstr_push_back(kqvk_device_exts_vec, &timing_ext)) {
+			KQ_OOM_MSG();
+			vecstr_destroy(kqvk_device_exts_vec);
+			return false;
+		}
+		kq->has_display_timing = true;
+	}
+
+	// Dynamic rendering is core from 1.3; older devices keep render passes and framebuffers.
+	VkPhysicalDeviceProperties pdev_props;
+	vkGetPhysicalDeviceProperties(kq->vk_pdev, &pdev_props);
+	kq->dynamic_rendering = false;
+	if (!kq->render_passes && pdev_props.apiVersion >= VK_API_VERSION_1_3) {
+		VkPhysicalDeviceVulkan13Features feats13 = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+		VkPhysicalDeviceFeatures2        feats = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &feats13};
+		vkGetPhysicalDeviceFeatures2(kq->vk_pdev, &feats);
+		kq->dynamic_rendering = feats13.dynamicRendering;
+	}
+	LOGM_DEBUG("Rendering with %s.", kq->dynamic_rendering ? "dynamic rendering" : "render passes and framebuffers");
+
+	// Frame pacing waits for presents by their ids, which takes both extensions and both their features.
+	const char *present_id_ext = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+	const char *present_wait_ext = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+	kq->has_present_wait = false;
+	if (!kq->headless && pdev_props.apiVersion >= VK_API_VERSION_1_1 && kqvk_check_pdev_for_extension(kq->vk_pdev, present_id_ext)
+	    && kqvk_check_pdev_for_extension(kq->vk_pdev, present_wait_ext)) {
+		VkPhysicalDevicePresentIdFeaturesKHR   id_feats = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR};
+		VkPhysicalDevicePresentWaitFeaturesKHR wait_feats = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR, .pNext = &id_feats};
+		VkPhysicalDeviceFeatures2              feats = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &wait_feats};
+		vkGetPhysicalDeviceFeatures2(kq->vk_pdev, &feats);
+		if (id_feats.presentId && wait_feats.presentWait) {
+			LOGM_DEBUG("Enabling optional device extensions %s and %s.", present_id_ext, present_wait_ext);
+			if (!vecstr_push_back(kqvk_device_exts_vec, &present_id_ext) || !vecstr_push_back(kqvk_device_exts_vec, &present_wait_ext)) {
+				KQ_OOM_MSG();
+				vecstr_destroy(kqvk_device_exts_vec);
+				return false;
+			}
+			kq->has_present_wait = true;
+		}
+	}
+
+	void *feats_next = kq->has_present_wait ? &rend_info.pdev_present_wait_feats : 0;
+	rend_info.pdev_feats13.pNext = feats_next;
+	rend_info.ldevice_cinfo.pNext = kq->dynamic_rendering ? &rend_info.pdev_feats13 : feats_next;
+
+	rend_info.ldevice_cinfo.enabledExtensionCount = (u32)kqvk_device_exts_vec->size;
+	rend_info.ldevice_cinfo.ppEnabledExtensionNames = kqvk_device_exts_vec->p;
+
+	return true;
+}
+
 bool kqvk_choose_pdev(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	u32 pdev_count = 0U;
 	vkEnumeratePhysicalDevices(kq->vk_ins, &pdev_count, 0);
 	VkPhysicalDevice *pdevs = malloc(sizeof(VkPhysicalDevice[pdev_count]));
@@ -136,9 +234,10 @@ bool kqvk_choose_pdev(kq_data kq[static 1]) {
 	}
 	vkEnumeratePhysicalDevices(kq->vk_ins, &pdev_count, pdevs);
 
+	// Headless rendering never presents, so any device will do (e.g. lavapipe).
 	u32 chosen_pdev = pdev_count;
 	for (u32 i = 0U; i < pdev_count; ++i) {
-		if (kqvk_check_pdev_for_extension(pdevs[i], VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
+		if (kq->headless || kqvk_check_pdev_for_extension(pdevs[i], VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
 			chosen_pdev = i;
 			break;
 		}
@@ -157,12 +256,43 @@ bool kqvk_choose_pdev(kq_data kq[static 1]) {
 	vkGetPhysicalDeviceProperties(kq->vk_pdev, &pdev_props);
 	LOGM_INFO("\"%s\" chosen as Vulkan physical device.", pdev_props.deviceName);
 
+	if (kq->headless) {
+		// Stand-in capabilities, so resolution clamping works the same as with a surface.
+		kq->vk_surface_capabilities.minImageExtent = (VkExtent2D){1U, 1U};
+		kq->vk_surface_capabilities.maxImageExtent = (VkExtent2D){pdev_props.limits.maxImageDimension2D, pdev_props.limits.maxImageDimension2D};
+		kqvk_ready_new_resolution(kq,
+		                          kq->headless_width ? (int)kq->headless_width : KQ_HEADLESS_DEFAULT_WIDTH,
+		                          kq->headless_height ? (int)kq->headless_height : KQ_HEADLESS_DEFAULT_HEIGHT);
+		return true;
+	}
+
 	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(kq->vk_pdev, kq->vk_surface, &kq->vk_surface_capabilities);
 
 	int w, h;
 	glfwGetFramebufferSize(kq->win, &w, &h);
 	kqvk_ready_new_resolution(kq, w, h);
 
+	// FIFO is the only mode guaranteed to exist.
+	const VkPresentModeKHR wanted_mode = kq->present_immediate ? VK_PRESENT_MODE_IMMEDIATE_KHR : rend_info.swapchain_cinfo.presentMode;
+	u32                    modes_count = 0U;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(kq->vk_pdev, kq->vk_surface, &modes_count, 0);
+	VkPresentModeKHR *modes = malloc(sizeof(VkPresentModeKHR[modes_count]));
+	if (!modes) {
+		KQ_OOM_MSG();
+		return false;
+	}
+	vkGetPhysicalDeviceSurfacePresentModesKHR(kq->vk_pdev, kq->vk_surface, &modes_count, modes);
+	rend_info.swapchain_cinfo.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	for (u32 i = 0U; i < modes_count; ++i) {
+		if (modes[i] == wanted_mode) {
+			rend_info.swapchain_cinfo.presentMode = wanted_mode;
+			break;
+		}
+	}
+	free(modes);
+	if (rend_info.swapchain_cinfo.presentMode != wanted_mode)
+		LOGM_WARN("Present mode %d unsupported; falling back to FIFO.", (int)wanted_mode);
+
 	rend_info.swapchain_cinfo.preTransform = kq->vk_surface_capabilities.currentTransform;
 	// Set to KQ_FRAMES_IN_FLIGHT + 1, assuming minImageCount is 2, which it probably is.
 	rend_info.swapchain_cinfo.minImageCount = kq->vk_surface_capabilities.minImageCount + KQ_FRAMES_IN_FLIGHT - 1;
@@ -190,6 +320,7 @@ int kqvk_reload_vulkan(VkInstance ins, VkPhysicalDevice pdev, VkDevice ldev) {
 }
 
 bool kqvk_set_up_pdev_queues(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	u32 q_family_count = 0U;
 	vkGetPhysicalDeviceQueueFamilyProperties(kq->vk_pdev, &q_family_count, 0);
 	VkQueueFamilyProperties *q_families = malloc(sizeof(VkQueueFamilyProperties[q_family_count]));
@@ -207,8 +338,12 @@ bool kqvk_set_up_pdev_queues(kq_data kq[static 1]) {
 			g_found = true;
 		}
 
+		// Headless has nothing to present to; the "present" queue is just the graphics one.
 		VkBool32 present_supported = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(kq->vk_pdev, i, kq->vk_surface, &present_supported);
+		if (kq->headless)
+			present_supported = g_found && kq->q_graphics_index == i;
+		else
+			vkGetPhysicalDeviceSurfaceSupportKHR(kq->vk_pdev, i, kq->vk_surface, &present_supported);
 		if (present_supported) {
 			kq->q_present_index = i;
 			p_found = true;
@@ -437,6 +572,10 @@ bool kqvk_image_layout_transition(kq_data       kq[restrict static 1],
 		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 		src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 		dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	} else if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_GENERAL) {
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		dst_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 	} else {
 		LOGM_FATAL("Image layout transition not supported.");
 		return false;
@@ -470,7 +609,7 @@ stbi_uc *kqvk_tex_load(const char path[restrict static 1], int desired_width, in
 		return 0;
 	}
 
-	if (width != desired_width && height != desired_height) {
+	if (width != desired_width || height != desired_height) {
 		LOGM_ERROR("%s: Loaded texture size does not match desired texture size. Wanted %dx%d, but got %dx%d.",
 		           path,
 		           desired_width,
@@ -485,9 +624,109 @@ stbi_uc *kqvk_tex_load(const char path[restrict static 1], int desired_width, in
 	return pix;
 }
 
+static u32 kqvk_crc32(u32 crc, size_t n, const u8 p[restrict n]) {
+	static u32 table[256];
+	if (!table[1]) {
+		for (u32 i = 0U; i < 256U; ++i) {
+			u32 c = i;
+			for (int k = 0; k < 8; ++k)
+				c = (c & 1U) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+	}
+
+	crc = ~crc;
+	for (size_t i = 0; i < n; ++i)
+		crc = table[(crc ^ p[i]) & 0xFFU] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void kqvk_be32(u8 out[static 4], u32 v) {
+	out[0] = (u8)(v >> 24);
+	out[1] = (u8)(v >> 16);
+	out[2] = (u8)(v >> 8);
+	out[3] = (u8)v;
+}
+
+static bool kqvk_png_chunk(FILE f[static 1], const char type[static 4], size_t len, const u8 data[len]) {
+	u8 hdr[8];
+	kqvk_be32(hdr, (u32)len);
+	memcpy(hdr + 4, type, 4);
+
+	u8 crc[4];
+	kqvk_be32(crc, kqvk_crc32(kqvk_crc32(0U, 4, (const u8 *)type), len, data));
+
+	return fwrite(hdr, 1, 8, f) == 8 && (!len || fwrite(data, 1, len, f) == len) && fwrite(crc, 1, 4, f) == 4;
+}
+
+bool kqvk_png_write(const char path[restrict static 1], u32 w, u32 h, const u8 rgba[restrict static 4]) {
+	// Scanlines are prefixed with filter type 0, then split into stored deflate blocks of at most 65535 bytes.
+	const size_t row = (size_t)w * 4 + 1;
+	const size_t raw_len = row * h;
+	const size_t blocks = raw_len / 65535 + 1;
+	const size_t idat_len = 2 + blocks * 5 + raw_len + 4;
+
+	u8 *idat = malloc(idat_len);
+	if (!idat) {
+		KQ_OOM_MSG();
+		return false;
+	}
+
+	u8    *o = idat;
+	size_t in_block = 0; // Bytes left in the current stored block.
+	size_t left = raw_len;
+	u32    adler_a = 1U, adler_b = 0U;
+	*o++ = 0x78; // zlib header: deflate, 32K window, no dictionary, fastest.
+	*o++ = 0x01;
+	for (u32 y = 0U; y < h; ++y) {
+		for (size_t x = 0; x < row; ++x) {
+			if (!in_block) {
+				in_block = left < 65535 ? left : 65535;
+				left -= in_block;
+				*o++ = (u8)!left; // BFINAL on the last block, BTYPE 00 (stored).
+				*o++ = (u8)in_block;
+				*o++ = (u8)(in_block >> 8);
+				*o++ = (u8)~in_block;
+				*o++ = (u8)(~in_block >> 8);
+			}
+			const u8 b = x ? rgba[(size_t)y * w * 4 + x - 1] : 0;
+			*o++ = b;
+			adler_a = (adler_a + b) % 65521U;
+			adler_b = (adler_b + adler_a) % 65521U;
+			--in_block;
+		}
+	}
+	kqvk_be32(o, (adler_b << 16) | adler_a);
+	o += 4;
+
+	u8 ihdr[13] = {0};
+	kqvk_be32(ihdr, w);
+	kqvk_be32(ihdr + 4, h);
+	ihdr[8] = 8; // Bit depth.
+	ihdr[9] = 6; // Colour type: RGBA.
+
+	FILE *f = fopen(path, "wb");
+	if (!f) {
+		LOGM_ERROR("Unable to open \"%s\" for writing.", path);
+		free(idat);
+		return false;
+	}
+
+	static const u8 sig[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	bool            ok = fwrite(sig, 1, sizeof sig, f) == sizeof sig && kqvk_png_chunk(f, "IHDR", sizeof ihdr, ihdr)
+	        && kqvk_png_chunk(f, "IDAT", (size_t)(o - idat), idat) && kqvk_png_chunk(f, "IEND", 0, 0);
+	ok = !fclose(f) && ok;
+	free(idat);
+
+	if (!ok)
+		LOGM_ERROR("Failed writing \"%s\".", path);
+	return ok;
+}
+
 
 
 bool kqvk_create_swapchain(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	rend_info.swapchain_cinfo.oldSwapchain = kq->vk_swapchain;
 	if (vkCreateSwapchainKHR(kq->vk_ldev, &rend_info.swapchain_cinfo, 0, &kq->vk_swapchain)) {
 		LOGM_FATAL("Unable to create swapchain.");
@@ -541,11 +780,92 @@ bool kqvk_create_swapchain(kq_data kq[static 1]) {
 	}
 
 	rend_info.present_info.pSwapchains = &kq->vk_swapchain;
+	rend_info.present_ids.pPresentIds = &kq->present_id;
+	kq->present_id = 0; // Ids count per swapchain.
+	kq->present_shown_ns = 0;
+
+	return true;
+}
+
+bool kqvk_create_headless_images(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
+	if (!kq->swapchain_imgs) {
+		kq->swapchain_img_count = KQ_FRAMES_IN_FLIGHT;
+		kq->swapchain_imgs = malloc(sizeof(VkImage[KQ_FRAMES_IN_FLIGHT]));
+		kq->swapchain_img_views = malloc(sizeof(VkImageView[KQ_FRAMES_IN_FLIGHT]));
+		if (!kq->swapchain_imgs || !kq->swapchain_img_views) {
+			KQ_OOM_MSG();
+			free(kq->swapchain_img_views);
+			free(kq->swapchain_imgs);
+			kq->swapchain_img_views = 0;
+			kq->swapchain_imgs = 0;
+			return false;
+		}
+	}
+
+	kq->headless_extent = rend_info.swapchain_cinfo.imageExtent;
+	kq->readback_ready = false;
+	const VkDeviceSize readback_size = (VkDeviceSize)kq->headless_extent.width * kq->headless_extent.height * 4;
+
+	for (u32 i = 0U; i < KQ_FRAMES_IN_FLIGHT; ++i) {
+		if (!kqvk_image_create(kq,
+		                       kq->headless_extent.width,
+		                       kq->headless_extent.height,
+		                       1,
+		                       rend_info.swapchain_cinfo.imageFormat,
+		                       VK_IMAGE_TILING_OPTIMAL,
+		                       VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		                       &kq->swapchain_imgs[i],
+		                       &kq->headless_imgs_mem[i])) {
+			LOGM_FATAL("Unable to create headless image %u.", i + 1);
+			kqvk_destroy_headless_images(kq, i);
+			for (u32 j = 0U; j < i; ++j)
+				vkDestroyImageView(kq->vk_ldev, kq->swapchain_img_views[j], 0);
+			return false;
+		}
+
+		if (!kqvk_buffer_create(kq,
+		                        readback_size,
+		                        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                        &kq->readback_bufs[i],
+		                        &kq->readback_bufs_mem[i])) {
+			LOGM_FATAL("Unable to create readback buffer %u.", i + 1);
+			vkDestroyImage(kq->vk_ldev, kq->swapchain_imgs[i], 0);
+			vkFreeMemory(kq->vk_ldev, kq->headless_imgs_mem[i], 0);
+			kqvk_destroy_headless_images(kq, i);
+			for (u32 j = 0U; j < i; ++j)
+				vkDestroyImageView(kq->vk_ldev, kq->swapchain_img_views[j], 0);
+			return false;
+		}
+		vkMapMemory(kq->vk_ldev, kq->readback_bufs_mem[i], 0, readback_size, 0, &kq->readback_bufs_mapped[i]);
+
+		rend_info.swapchain_img_view_cinfo.image = kq->swapchain_imgs[i];
+		if (vkCreateImageView(kq->vk_ldev, &rend_info.swapchain_img_view_cinfo, 0, &kq->swapchain_img_views[i])) {
+			LOGM_FATAL("Unable to create headless image view %u.", i + 1);
+			kqvk_destroy_headless_images(kq, i + 1);
+			for (u32 j = 0U; j < i; ++j)
+				vkDestroyImageView(kq->vk_ldev, kq->swapchain_img_views[j], 0);
+			return false;
+		}
+	}
 
 	return true;
 }
 
+void kqvk_destroy_headless_images(kq_data kq[static 1], u32 count) {
+	for (u32 i = 0U; i < count; ++i) {
+		vkUnmapMemory(kq->vk_ldev, kq->readback_bufs_mem[i]);
+		vkDestroyBuffer(kq->vk_ldev, kq->readback_bufs[i], 0);
+		vkFreeMemory(kq->vk_ldev, kq->readback_bufs_mem[i], 0);
+		vkDestroyImage(kq->vk_ldev, kq->swapchain_imgs[i], 0);
+		vkFreeMemory(kq->vk_ldev, kq->headless_imgs_mem[i], 0);
+	}
+}
+
 bool kqvk_init_shaders(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	size_t tiles_vert_len = 0;
 	u32   *tiles_vert_buf = fs_file_read_all_alloc("shaders/tile.vert.spv", &tiles_vert_len);
 	if (!(tiles_vert_buf && !(tiles_vert_len % 4))) { // codeSize must be a multiple of 4.
@@ -588,10 +908,15 @@ bool kqvk_init_shaders(kq_data kq[static 1]) {
 }
 
 bool kqvk_create_render_pass(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	kq->viewport.maxDepth = 1.0f;
 	rend_info.pipeline_viewport_state_cinfo.pViewports = &kq->viewport;
 	rend_info.pipeline_viewport_state_cinfo.pScissors = &kq->scissor;
 
+	// Pipelines then take their attachment format from pipeline_rendering_cinfo instead.
+	if (kq->dynamic_rendering)
+		return true;
+
 	if (vkCreateRenderPass(kq->vk_ldev, &rend_info.pass_cinfo, 0, &kq->render_pass)) {
 		LOGM_FATAL("Unable to create vkRenderPass.");
 		return false;
@@ -605,16 +930,24 @@ bool kqvk_create_render_pass(kq_data kq[static 1]) {
 }
 
 bool kqvk_create_descriptor_set_layout(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	if (vkCreateDescriptorSetLayout(kq->vk_ldev, &rend_info.descriptor_set_layout_cinfo, 0, &kq->descriptor_set_layout)) {
 		LOGM_FATAL("Unable to create descriptor set layout.");
 		return false;
 	}
+	if (vkCreateDescriptorSetLayout(kq->vk_ldev, &rend_info.target_set_layout_cinfo, 0, &kq->target_set_layout)) {
+		LOGM_FATAL("Unable to create render target descriptor set layout.");
+		vkDestroyDescriptorSetLayout(kq->vk_ldev, kq->descriptor_set_layout, 0);
+		return false;
+	}
 
 	return true;
 }
 
 bool kqvk_create_pipeline(kq_data kq[static 1]) {
-	rend_info.pipeline_layout_cinfo.pSetLayouts = &kq->descriptor_set_layout;
+	KQ_PROF_FUNC();
+	const VkDescriptorSetLayout set_layouts[2] = {kq->descriptor_set_layout, kq->target_set_layout};
+	rend_info.pipeline_layout_cinfo.pSetLayouts = set_layouts;
 
 	if (vkCreatePipelineLayout(kq->vk_ldev, &rend_info.pipeline_layout_cinfo, 0, &kq->pipeline_layout)) {
 		LOGM_FATAL("Unable to create graphics pipeline layout.");
@@ -634,6 +967,10 @@ bool kqvk_create_pipeline(kq_data kq[static 1]) {
 }
 
 bool kqvk_create_framebuffers(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
+	if (kq->dynamic_rendering)
+		return true;
+
 	if (!kq->fbos) { // In case this is not the first call.
 		kq->fbos = malloc(sizeof(VkFramebuffer[kq->swapchain_img_count]));
 		if (!kq->fbos) {
@@ -657,6 +994,7 @@ bool kqvk_create_framebuffers(kq_data kq[static 1]) {
 }
 
 bool kqvk_create_cmd_pool(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	if (vkCreateCommandPool(kq->vk_ldev, &rend_info.cmd_pool_cinfo, 0, &kq->cmd_pool)) {
 		LOGM_FATAL("Unable to create command pool.");
 		return false;
@@ -669,6 +1007,7 @@ bool kqvk_create_cmd_pool(kq_data kq[static 1]) {
 }
 
 bool kqvk_create_cmd_bufs(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	if (vkAllocateCommandBuffers(kq->vk_ldev, &rend_info.cmd_buf_allocate_info, kq->cmd_buf)) {
 		LOGM_FATAL("Unable to create command buffer.");
 		return false;
@@ -678,7 +1017,1286 @@ bool kqvk_create_cmd_bufs(kq_data kq[static 1]) {
 	return true;
 }
 
+bool kqvk_instance_chunk_add(kq_data kq[static 1], size_t frame) {
+	const u32          chunk = kq->instance_chunks_count[frame];
+	const VkDeviceSize size = sizeof(kq_tile_instance[KQ_INSTANCE_CHUNK_SIZE]);
+	if (chunk == KQ_INSTANCE_CHUNKS_MAX)
+		return false;
+
+	if (!kqvk_buffer_create(kq,
+	                        size,
+	                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+	                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	                        &kq->instance_bufs[frame][chunk],
+	                        &kq->instance_bufs_mem[frame][chunk])) {
+		LOGM_ERROR("Unable to create instance buffer chunk %u.", chunk + 1);
+		return false;
+	}
+	vkMapMemory(kq->vk_ldev, kq->instance_bufs_mem[frame][chunk], 0, size, 0, (void **)&kq->instance_bufs_mapped[frame][chunk]);
+
+	++kq->instance_chunks_count[frame];
+	return true;
+}
+
+bool kqvk_create_instance_buffers(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
+	for (size_t i = 0; i < KQ_FRAMES_IN_FLIGHT; ++i) {
+		if (!kqvk_instance_chunk_add(kq, i)) {
+			kqvk_destroy_instance_buffers(kq);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void kqvk_destroy_instance_buffers(kq_data kq[static 1]) {
+	for (size_t i = 0; i < KQ_FRAMES_IN_FLIGHT; ++i) {
+		for (u32 j = 0U; j < kq->instance_chunks_count[i]; ++j) {
+			vkUnmapMemory(kq->vk_ldev, kq->instance_bufs_mem[i][j]);
+			vkDestroyBuffer(kq->vk_ldev, kq->instance_bufs[i][j], 0);
+			vkFreeMemory(kq->vk_ldev, kq->instance_bufs_mem[i][j], 0);
+		}
+		kq->instance_chunks_count[i] = 0;
+	}
+}
+
+// Moves the batch on to the next chunk once the current one is full.
+static bool kqvk_batch_room(kq_data kq[static 1]) {
+	if (kq->instance_count < KQ_INSTANCE_CHUNK_SIZE)
+		return true;
+
+	kqvk_batch_flush(kq);
+
+	const u32 next = kq->instance_chunk + 1;
+	if (next == kq->instance_chunks_count[kq->current_frame] && !kqvk_instance_chunk_add(kq, kq->current_frame)) {
+		LOGM_ERROR("Out of instance buffer space; more than %u quads in one frame.", KQ_INSTANCE_CHUNK_SIZE * next);
+		return false;
+	}
+	kq->instance_chunk = next;
+	kq->instance_count = 0;
+	kq->batch_first = 0;
+	return true;
+}
+
+kq_tile_instance *kqvk_batch_push(kq_data kq[static 1]) {
+	if (!kqvk_batch_room(kq))
+		return 0;
+	return &kq->instance_bufs_mapped[kq->current_frame][kq->instance_chunk][kq->instance_count++];
+}
+
+kq_tile_instance *kqvk_batch_reserve(kq_data kq[static 1], u32 room[static 1]) {
+	if (!kqvk_batch_room(kq))
+		return 0;
+	*room = KQ_INSTANCE_CHUNK_SIZE - kq->instance_count;
+	return &kq->instance_bufs_mapped[kq->current_frame][kq->instance_chunk][kq->instance_count];
+}
+
+void kqvk_batch_commit(kq_data kq[static 1], u32 count) {
+	kq->instance_count += count;
+}
+
+// Records a draw of count instances of buf from first, or logs it for kqvk_scene_record() if it is of the scene under
+// damage tracking.
+static void kqvk_draw(kq_data kq[static 1], VkBuffer buf, u32 first, u32 count) {
+	if (kq->damage_on && !kq->target_active) {
+		const kq_scene_draw draw = {.buf = buf, .first = first, .count = count, .set = kq->target_set_bound};
+		if (!vecscenedraw_push_back(kq->scene_draws, &draw))
+			KQ_OOM_MSG();
+		return;
+	}
+
+	const VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(kq->draw_cmd_buf, 1, 1, &buf, &offset);
+	vkCmdDrawIndexed(kq->draw_cmd_buf, KQ_QUAD_NUM_INDICES, count, 0, 0, first);
+	++kq->stats.draw_calls;
+}
+
+void kqvk_batch_flush(kq_data kq[static 1]) {
+	if (kq->batch_first == kq->instance_count)
+		return;
+
+	kqvk_draw(kq, kq->instance_bufs[kq->current_frame][kq->instance_chunk], kq->batch_first, kq->instance_count - kq->batch_first);
+	kq->batch_first = kq->instance_count;
+}
+
+void kqvk_draw_instances(kq_data kq[static 1], VkBuffer buf, u32 first, u32 count) {
+	// Keep the order of anything batched before.
+	kqvk_batch_flush(kq);
+
+	kqvk_draw(kq, buf, first, count);
+	kq->stats.quads += count;
+}
+
+// The instance a sprite store slot draws; hidden and free slots draw nothing.
+static inline kq_tile_instance kqvk_sprite_instance(const kq_sprite_store store[static 1], u32 i) {
+	if (store->flags[i] & (KQ_SPRITE_HIDDEN | KQ_SPRITE_FREE))
+		return (kq_tile_instance){0};
+	return (kq_tile_instance){
+		.position = {store->positions[i][0], store->positions[i][1]},
+		.scale = {store->scales[i][0], store->scales[i][1]},
+		.uv_rect = {0.0f, 0.0f, 1.0f, 1.0f},
+		.color = store->colors[i],
+		.layer = store->layers[i],
+		.flags = store->flags[i],
+		.anim_start = store->anim_starts[i],
+	};
+}
+
+// Uploads each run of dirty blocks from b up to end in one copy, until this frame's staging runs out; then sets full and
+// leaves the rest for the next frame, starting from the first block left.
+static bool kqvk_sprites_upload_runs(kq_data         kq[restrict static 1],
+                                     kq_sprite_store store[restrict static 1],
+                                     u32             b,
+                                     u32             end_block,
+                                     bool            full[restrict static 1]) {
+	while (b < end_block) {
+		if (!store->dirty[b / 64U]) {
+			b = (b / 64U + 1U) * 64U;
+			continue;
+		}
+		if (!(store->dirty[b / 64U] >> b % 64U & 1U)) {
+			++b;
+			continue;
+		}
+
+		u32 end = b + 1U;
+		while (end < end_block && store->dirty[end / 64U] >> end % 64U & 1U)
+			++end;
+		const VkDeviceSize available = kqvk_upload_available(kq);
+		const VkDeviceSize usable = available > KQ_SPRITE_UPLOAD_SPARE ? available - KQ_SPRITE_UPLOAD_SPARE : 0U;
+		const u32          room = (u32)(usable / sizeof(kq_tile_instance[KQ_SPRITE_BLOCK]));
+		if (!room) {
+			store->upload_next = b;
+			*full = true;
+			return true;
+		}
+		if (end - b > room)
+			end = b + room;
+
+		const u32              first = b * KQ_SPRITE_BLOCK;
+		const u32              n = (end * KQ_SPRITE_BLOCK < store->count ? end * KQ_SPRITE_BLOCK : store->count) - first;
+		VkDeviceSize           offset;
+		kq_tile_instance      *dst = kqvk_upload_reserve(kq, sizeof(kq_tile_instance) * n, &offset);
+		const kq_buffer_upload upload = {
+			.dst = store->buf,
+			.region =
+				(VkBufferCopy){
+					.srcOffset = offset,
+					.dstOffset = sizeof(kq_tile_instance) * first,
+					.size = sizeof(kq_tile_instance) * n,
+				},
+		};
+		if (!dst || !vecbufupload_push_back(kq->buffer_uploads, &upload)) {
+			KQ_OOM_MSG();
+			return false;
+		}
+		for (u32 i = 0U; i < n; ++i)
+			dst[i] = kqvk_sprite_instance(store, first + i);
+		for (; b < end; ++b) {
+			store->dirty[b / 64U] &= ~(1ULL << b % 64U);
+			store->blank[b / 64U] &= ~(1ULL << b % 64U);
+			store->damage_stale[b / 64U] |= 1ULL << b % 64U;
+		}
+	}
+	return true;
+}
+
+bool kqvk_sprites_upload(kq_data kq[restrict static 1], kq_sprite_store store[restrict static 1]) {
+	if (store->retired_buf && kq->stats.frames >= store->retired_frame + KQ_FRAMES_IN_FLIGHT) {
+		vkDestroyBuffer(kq->vk_ldev, store->retired_buf, 0);
+		vkFreeMemory(kq->vk_ldev, store->retired_mem, 0);
+		store->retired_buf = 0;
+	}
+
+	if (store->count > store->buf_cap) {
+		// Outgrowing it twice within the frames in flight is rare enough to simply wait.
+		if (store->retired_buf) {
+			vkDeviceWaitIdle(kq->vk_ldev);
+			vkDestroyBuffer(kq->vk_ldev, store->retired_buf, 0);
+			vkFreeMemory(kq->vk_ldev, store->retired_mem, 0);
+			store->retired_buf = 0;
+		}
+
+		VkBuffer       buf;
+		VkDeviceMemory buf_mem;
+		if (!kqvk_buffer_create(kq,
+		                        sizeof(kq_tile_instance) * store->cap,
+		                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		                        &buf,
+		                        &buf_mem)) {
+			LOGM_ERROR("Unable to create a sprite store instance buffer of %u instances.", store->cap);
+			return false;
+		}
+
+		// Blocks the old buffer holds as they stand are copied across on the GPU; the rest go up again, as staging allows.
+		const u32    old_blocks = store->buf_cap / KQ_SPRITE_BLOCK;
+		const size_t uploads_size = kq->buffer_uploads->size;
+		for (u32 w = 0U; w < store->cap / KQ_SPRITE_GROW; ++w)
+			store->blank[w] = w < old_blocks / 64U ? store->dirty[w] | store->blank[w] : UINT64_MAX;
+		for (u32 b = 0U; b < old_blocks;) {
+			if (store->blank[b / 64U] >> b % 64U & 1U) {
+				++b;
+				continue;
+			}
+			u32 end = b + 1U;
+			while (end < old_blocks && !(store->blank[end / 64U] >> end % 64U & 1U))
+				++end;
+			const VkDeviceSize     offset = sizeof(kq_tile_instance[KQ_SPRITE_BLOCK]) * b;
+			const kq_buffer_upload copy = {
+				.src = store->buf,
+				.dst = buf,
+				.region =
+					(VkBufferCopy){
+						.srcOffset = offset,
+						.dstOffset = offset,
+						.size = sizeof(kq_tile_instance[KQ_SPRITE_BLOCK]) * (end - b),
+					},
+			};
+			if (!vecbufupload_push_back(kq->buffer_uploads, &copy)) {
+				KQ_OOM_MSG();
+				kq->buffer_uploads->size = uploads_size;
+				vkDestroyBuffer(kq->vk_ldev, buf, 0);
+				vkFreeMemory(kq->vk_ldev, buf_mem, 0);
+				return false;
+			}
+			b = end;
+		}
+
+		if (store->buf) {
+			store->retired_buf = store->buf;
+			store->retired_mem = store->buf_mem;
+			store->retired_frame = kq->stats.frames;
+		}
+		store->buf = buf;
+		store->buf_mem = buf_mem;
+		store->buf_cap = store->cap;
+	}
+
+	// Everything in use the buffer holds nothing of has to go up.
+	const u32 blocks = (store->count + KQ_SPRITE_BLOCK - 1U) / KQ_SPRITE_BLOCK;
+	for (u32 w = 0U; w < (blocks + 63U) / 64U; ++w)
+		store->dirty[w] |= store->blank[w] & (w < blocks / 64U ? UINT64_MAX : (1ULL << blocks % 64U) - 1U);
+
+	// From where the last upload ran out of staging, wrapping around, so blocks changing every frame can't starve the rest.
+	const u32 from = store->upload_next < blocks ? store->upload_next : 0U;
+	bool      full = false;
+	store->upload_next = 0U;
+	if (!kqvk_sprites_upload_runs(kq, store, from, blocks, &full))
+		return false;
+	return full || kqvk_sprites_upload_runs(kq, store, 0U, from, &full);
+}
+
+bool kqvk_create_upload_buffers(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
+	VkCommandBufferAllocateInfo ainfo = rend_info.cmd_buf_allocate_info;
+	if (vkAllocateCommandBuffers(kq->vk_ldev, &ainfo, kq->upload_cmd_buf)) {
+		LOGM_FATAL("Unable to create upload command buffers.");
+		return false;
+	}
+
+	for (size_t i = 0; i < KQ_FRAMES_IN_FLIGHT; ++i) {
+		if (!kqvk_buffer_create(kq,
+		                        KQ_UPLOAD_STAGING_SIZE,
+		                        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                        &kq->upload_bufs[i],
+		                        &kq->upload_bufs_mem[i])) {
+			LOGM_FATAL("Unable to create upload staging buffer %zu.", i + 1);
+			for (size_t j = 0; j < i; ++j) {
+				vkUnmapMemory(kq->vk_ldev, kq->upload_bufs_mem[j]);
+				vkDestroyBuffer(kq->vk_ldev, kq->upload_bufs[j], 0);
+				vkFreeMemory(kq->vk_ldev, kq->upload_bufs_mem[j], 0);
+			}
+			vkFreeCommandBuffers(kq->vk_ldev, kq->cmd_pool, KQ_FRAMES_IN_FLIGHT, kq->upload_cmd_buf);
+			return false;
+		}
+		vkMapMemory(kq->vk_ldev, kq->upload_bufs_mem[i], 0, KQ_UPLOAD_STAGING_SIZE, 0, (void **)&kq->upload_bufs_mapped[i]);
+	}
+
+	kq->buffer_uploads = vecbufupload_create(0);
+	if (!kq->buffer_uploads) {
+		KQ_OOM_MSG();
+		kqvk_destroy_upload_buffers(kq);
+		return false;
+	}
+
+	return true;
+}
+
+void kqvk_destroy_upload_buffers(kq_data kq[static 1]) {
+	if (kq->buffer_uploads)
+		vecbufupload_destroy(kq->buffer_uploads);
+	kq->buffer_uploads = 0;
+	for (size_t i = 0; i < KQ_FRAMES_IN_FLIGHT; ++i) {
+		vkUnmapMemory(kq->vk_ldev, kq->upload_bufs_mem[i]);
+		vkDestroyBuffer(kq->vk_ldev, kq->upload_bufs[i], 0);
+		vkFreeMemory(kq->vk_ldev, kq->upload_bufs_mem[i], 0);
+	}
+	vkFreeCommandBuffers(kq->vk_ldev, kq->cmd_pool, KQ_FRAMES_IN_FLIGHT, kq->upload_cmd_buf);
+}
+
+void *kqvk_upload_reserve(kq_data kq[static 1], VkDeviceSize size, VkDeviceSize offset[static 1]) {
+	// Offsets stay 4-aligned, as buffer to image copies require for their bufferOffset.
+	const VkDeviceSize start = (kq->upload_used + 3U) & ~(VkDeviceSize)3U;
+	if (start + size > KQ_UPLOAD_STAGING_SIZE)
+		return 0;
+
+	kq->upload_used = start + size;
+	*offset = start;
+	return kq->upload_bufs_mapped[kq->current_frame] + start;
+}
+
+VkDeviceSize kqvk_upload_available(kq_data kq[static 1]) {
+	const VkDeviceSize start = (kq->upload_used + 3U) & ~(VkDeviceSize)3U;
+	return start < KQ_UPLOAD_STAGING_SIZE ? KQ_UPLOAD_STAGING_SIZE - start : 0;
+}
+
+static void kqvk_record_buffer_uploads(kq_data kq[static 1], VkCommandBuffer cmd_buf) {
+	// Earlier frames may still be reading the destinations as vertex input, and buffers copied from were written by their
+	// uploads.
+	VkMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+	};
+	vkCmdPipelineBarrier(cmd_buf,
+	                     VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                     0,
+	                     1,
+	                     &barrier,
+	                     0,
+	                     0,
+	                     0,
+	                     0);
+
+	for (size_t i = 0; i < kq->buffer_uploads->size; ++i) {
+		const kq_buffer_upload *u = &kq->buffer_uploads->p[i];
+		vkCmdCopyBuffer(cmd_buf, u->src ? u->src : kq->upload_bufs[kq->current_frame], u->dst, 1, &u->region);
+	}
+	vecbufupload_clear(kq->buffer_uploads);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, 0, 0, 0);
+}
+
+bool kqvk_uploads_end(kq_data kq[static 1]) {
+	u32 count = 0U;
+	if (kq->atlas_regions->size || kq->atlas_repacked || kq->buffer_uploads->size) {
+		const VkCommandBuffer cmd_buf = kq->upload_cmd_buf[kq->current_frame];
+		vkResetCommandBuffer(cmd_buf, 0);
+		if (vkBeginCommandBuffer(cmd_buf, &rend_info.cmd_buf_begin_info))
+			return false;
+		if (kq->atlas_regions->size || kq->atlas_repacked)
+			kqtxt_atlas_record_uploads(kq, cmd_buf);
+		if (kq->buffer_uploads->size)
+			kqvk_record_buffer_uploads(kq, cmd_buf);
+		if (vkEndCommandBuffer(cmd_buf))
+			return false;
+		kq->submit_cmd_bufs[count++] = cmd_buf;
+	}
+
+	// Same queue, so submission order is enough for target passes to see the uploads, and the frame both.
+	if (kq->targets_recorded) {
+		if (vkEndCommandBuffer(kq->target_cmd_buf[kq->current_frame]))
+			return false;
+		kq->submit_cmd_bufs[count++] = kq->target_cmd_buf[kq->current_frame];
+	}
+	kq->submit_cmd_bufs[count++] = kq->cmd_buf[kq->current_frame];
+	rend_info.submit_info.commandBufferCount = count;
+	rend_info.submit_info.pCommandBuffers = kq->submit_cmd_bufs;
+	return true;
+}
+
+void kqvk_pass_bind(kq_data kq[static 1], VkCommandBuffer cmd_buf) {
+	// The scene at a dynamic internal resolution is laid out at its full size, but drawn into part of post_scene.
+	const bool scaled = kq->internal_on && !kq->target_active;
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, kq->graphics_pipeline);
+	vkCmdSetViewport(cmd_buf, 0, 1, scaled ? &kq->internal_viewport : &kq->viewport);
+	vkCmdSetScissor(cmd_buf, 0, 1, scaled ? &kq->internal_scissor : &kq->scissor);
+
+	VkDeviceSize vertex_buf_offset = 0;
+	vkCmdBindVertexBuffers(cmd_buf, 0, 1, &kq->vertex_buf, &vertex_buf_offset);
+	vkCmdBindIndexBuffer(cmd_buf, kq->index_buf, 0, VK_INDEX_TYPE_UINT16);
+
+	const VkDescriptorSet sets[2] = {kq->desc_sets[kq->current_frame], kq->target_default_set};
+	vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, kq->pipeline_layout, 0, 2, sets, 0, 0);
+	kq->target_set_bound = kq->target_default_set;
+}
+
+void kqvk_target_bind(kq_data kq[static 1], VkDescriptorSet set) {
+	if (kq->target_set_bound == set)
+		return;
+
+	// Instances already pushed may sample the previous target. Logged scene draws carry the set they sample instead.
+	kqvk_batch_flush(kq);
+	if (!kq->damage_on || kq->target_active)
+		vkCmdBindDescriptorSets(kq->draw_cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, kq->pipeline_layout, 1, 1, &set, 0, 0);
+	kq->target_set_bound = set;
+}
+
+void kqvk_image_clear(kq_data kq[static 1], VkImage img) {
+	const VkImageSubresourceRange range = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1};
+	VkImageMemoryBarrier          barrier = {
+				 .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				 .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				 .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				 .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+				 .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				 .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				 .image = img,
+				 .subresourceRange = range,
+	};
+	const VkClearColorValue clear = {0};
+
+	VkCommandBuffer cmd_buf = kqvk_single_time_command_begin(kq);
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &barrier);
+	vkCmdClearColorImage(cmd_buf, img, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clear, 1, &range);
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, 0, 0, 0, 1, &barrier);
+	kqvk_single_time_command_end(kq, cmd_buf);
+}
+
+bool kqvk_targets_init(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
+	if (!kq->dynamic_rendering && vkCreateRenderPass(kq->vk_ldev, &rend_info.target_pass_cinfo, 0, &kq->target_pass)) {
+		LOGM_FATAL("Unable to create the render target pass.");
+		goto fail_vkCreateRenderPass;
+	}
+	if (!kq->dynamic_rendering && vkCreateRenderPass(kq->vk_ldev, &rend_info.target_load_pass_cinfo, 0, &kq->target_load_pass)) {
+		LOGM_FATAL("Unable to create the render target pass that keeps the contents.");
+		goto fail_vkCreateRenderPass_load;
+	}
+
+	if (vkCreateSampler(kq->vk_ldev, &rend_info.target_sampler_cinfo, 0, &kq->target_sampler)) {
+		LOGM_FATAL("Unable to create the render target sampler.");
+		goto fail_vkCreateSampler;
+	}
+
+	if (vkCreateDescriptorPool(kq->vk_ldev, &rend_info.target_desc_pool_cinfo, 0, &kq->target_desc_pool)) {
+		LOGM_FATAL("Unable to create the render target descriptor pool.");
+		goto fail_vkCreateDescriptorPool;
+	}
+
+	// The default set is never sampled, but has to be valid; the tiles texture is the right type.
+	const VkDescriptorSetAllocateInfo ainfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = kq->target_desc_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &kq->target_set_layout,
+	};
+	if (vkAllocateDescriptorSets(kq->vk_ldev, &ainfo, &kq->target_default_set)) {
+		LOGM_FATAL("Unable to allocate the default render target descriptor set.");
+		goto fail_vkAllocateDescriptorSets;
+	}
+	kqvk_target_set_write(kq, kq->target_default_set, kq->tiles_tex_view);
+
+	if (vkAllocateCommandBuffers(kq->vk_ldev, &rend_info.cmd_buf_allocate_info, kq->target_cmd_buf)) {
+		LOGM_FATAL("Unable to create render target command buffers.");
+		goto fail_vkAllocateCommandBuffers;
+	}
+	kq->targets_recorded = false;
+	kq->target_active = 0;
+	return true;
+
+fail_vkAllocateCommandBuffers:
+fail_vkAllocateDescriptorSets:
+	vkDestroyDescriptorPool(kq->vk_ldev, kq->target_desc_pool, 0);
+fail_vkCreateDescriptorPool:
+	vkDestroySampler(kq->vk_ldev, kq->target_sampler, 0);
+fail_vkCreateSampler:
+	vkDestroyRenderPass(kq->vk_ldev, kq->target_load_pass, 0);
+fail_vkCreateRenderPass_load:
+	vkDestroyRenderPass(kq->vk_ldev, kq->target_pass, 0);
+fail_vkCreateRenderPass:
+	return false;
+}
+
+void kqvk_targets_stop(kq_data kq[static 1]) {
+	vkFreeCommandBuffers(kq->vk_ldev, kq->cmd_pool, KQ_FRAMES_IN_FLIGHT, kq->target_cmd_buf);
+	vkDestroyDescriptorPool(kq->vk_ldev, kq->target_desc_pool, 0);
+	vkDestroySampler(kq->vk_ldev, kq->target_sampler, 0);
+	vkDestroyRenderPass(kq->vk_ldev, kq->target_load_pass, 0);
+	vkDestroyRenderPass(kq->vk_ldev, kq->target_pass, 0);
+}
+
+void kqvk_target_set_write(kq_data kq[static 1], VkDescriptorSet set, VkImageView view) {
+	const VkDescriptorImageInfo image_info = {
+		.sampler = kq->target_sampler,
+		.imageView = view,
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	};
+	const VkWriteDescriptorSet write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = set,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 1,
+		.pImageInfo = &image_info,
+	};
+	vkUpdateDescriptorSets(kq->vk_ldev, 1, &write, 0, 0);
+}
+
+void kqvk_pass_begin(kq_data kq[static 1], VkCommandBuffer cmd_buf, const kq_render_target *target, bool load) {
+	if (!kq->dynamic_rendering) {
+		if (target) {
+			rend_info.target_pass_begin_info.renderPass = load ? kq->target_load_pass : kq->target_pass;
+			rend_info.target_pass_begin_info.framebuffer = target->fbo;
+			rend_info.target_pass_begin_info.renderArea.extent = (VkExtent2D){.width = target->width, .height = target->height};
+			vkCmdBeginRenderPass(cmd_buf, &rend_info.target_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+		} else {
+			rend_info.pass_begin_info.framebuffer = kq->fbos[kq->img_index];
+			vkCmdBeginRenderPass(cmd_buf, &rend_info.pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+		}
+		return;
+	}
+
+	// The render passes' initial layout and incoming dependency: the old contents are discarded, or kept when loading,
+	// once whatever sampled them (targets) or waited on the acquire semaphore (the swapchain) is done.
+	const VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (load ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0),
+		.oldLayout = load ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+		.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = target ? target->image : kq->swapchain_imgs[kq->img_index],
+		.subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1},
+	};
+	const VkPipelineStageFlags src_stage =
+		target ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	vkCmdPipelineBarrier(cmd_buf, src_stage, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, 0, 0, 0, 1, &barrier);
+
+	rend_info.rendering_attachment.imageView = target ? target->view : kq->swapchain_img_views[kq->img_index];
+	rend_info.rendering_attachment.loadOp = load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+	rend_info.rendering_info.renderArea.extent =
+		target ? (VkExtent2D){.width = target->width, .height = target->height} : rend_info.pass_begin_info.renderArea.extent;
+	vkCmdBeginRendering(cmd_buf, &rend_info.rendering_info);
+}
+
+void kqvk_pass_end(kq_data kq[static 1], VkCommandBuffer cmd_buf, const kq_render_target *target) {
+	if (!kq->dynamic_rendering) {
+		vkCmdEndRenderPass(cmd_buf);
+		return;
+	}
+	vkCmdEndRendering(cmd_buf);
+
+	// The render passes' final layout and outgoing dependency: targets are sampled next, headless images copied out,
+	// and swapchain images presented.
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = target ? target->image : kq->swapchain_imgs[kq->img_index],
+		.subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1},
+	};
+	VkPipelineStageFlags dst_stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	if (target) {
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	} else if (kq->headless) {
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	}
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, dst_stage, 0, 0, 0, 0, 0, 1, &barrier);
+}
+
+static bool kqvk_shader_module_load(kq_data kq[restrict static 1], const char path[restrict static 1], VkShaderModule module[restrict static 1]) {
+	size_t len = 0;
+	u32   *code = fs_file_read_all_alloc(path, &len);
+	if (!(code && !(len % 4))) { // codeSize must be a multiple of 4.
+		LOGM_FATAL("Unable to read shader \"%s\".", path);
+		free(code);
+		return false;
+	}
+
+	const VkShaderModuleCreateInfo cinfo = {.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, .codeSize = len, .pCode = code};
+	const VkResult                 res = vkCreateShaderModule(kq->vk_ldev, &cinfo, 0, module);
+	free(code);
+	if (res) {
+		LOGM_FATAL("Unable to create shader module from \"%s\".", path);
+		return false;
+	}
+	return true;
+}
+
+bool kqvk_post_init(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
+	if (!kqvk_shader_module_load(kq, "shaders/post.vert.spv", &kq->post_vert_module))
+		goto fail_vert_module;
+	if (!kqvk_shader_module_load(kq, "shaders/post.frag.spv", &kq->post_frag_module))
+		goto fail_frag_module;
+	rend_info.post_shader_stages_cinfo[0].module = kq->post_vert_module;
+	rend_info.post_shader_stages_cinfo[1].module = kq->post_frag_module;
+
+	// The scene image and the blur are sampled through render target sets.
+	const VkDescriptorSetLayout set_layouts[2] = {kq->target_set_layout, kq->target_set_layout};
+	rend_info.post_pipeline_layout_cinfo.pSetLayouts = set_layouts;
+	if (vkCreatePipelineLayout(kq->vk_ldev, &rend_info.post_pipeline_layout_cinfo, 0, &kq->post_pipeline_layout)) {
+		LOGM_FATAL("Unable to create the post pipeline layout.");
+		goto fail_vkCreatePipelineLayout;
+	}
+
+	rend_info.post_pipeline_cinfo.layout = kq->post_pipeline_layout;
+	rend_info.post_pipeline_cinfo.renderPass = kq->render_pass;
+	if (vkCreateGraphicsPipelines(kq->vk_ldev, 0, 1, &rend_info.post_pipeline_cinfo, 0, &kq->post_pipeline)) {
+		LOGM_FATAL("Unable to create the post pipeline.");
+		goto fail_vkCreateGraphicsPipelines;
+	}
+
+	kq->scene_draws = vecscenedraw_create(0);
+	if (!kq->scene_draws) {
+		KQ_OOM_MSG();
+		goto fail_scene_draws;
+	}
+	kq->post_chain.count = 0;
+	kq->post_on = false;
+	kq->internal_base = (VkExtent2D){0};
+	kq->internal_budget_ns = 0;
+	kq->internal_scale = 1.0f;
+	kq->internal_on = false;
+	kq->damage_tracking = false;
+	kq->damage_on = false;
+	kq->damage_cells = 0;
+	kq->damage_extent = (VkExtent2D){0};
+	return true;
+
+fail_scene_draws:
+	vkDestroyPipeline(kq->vk_ldev, kq->post_pipeline, 0);
+fail_vkCreateGraphicsPipelines:
+	vkDestroyPipelineLayout(kq->vk_ldev, kq->post_pipeline_layout, 0);
+fail_vkCreatePipelineLayout:
+	vkDestroyShaderModule(kq->vk_ldev, kq->post_frag_module, 0);
+fail_frag_module:
+	vkDestroyShaderModule(kq->vk_ldev, kq->post_vert_module, 0);
+fail_vert_module:
+	return false;
+}
+
+void kqvk_post_stop(kq_data kq[static 1]) {
+	free(kq->damage_cells);
+	vecscenedraw_destroy(kq->scene_draws);
+	vkDestroyPipeline(kq->vk_ldev, kq->post_pipeline, 0);
+	vkDestroyPipelineLayout(kq->vk_ldev, kq->post_pipeline_layout, 0);
+	vkDestroyShaderModule(kq->vk_ldev, kq->post_frag_module, 0);
+	vkDestroyShaderModule(kq->vk_ldev, kq->post_vert_module, 0);
+}
+
+void kqvk_post_record(kq_data kq[static 1], VkCommandBuffer cmd_buf) {
+	kqvk_pass_begin(kq, cmd_buf, 0, false);
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, kq->post_pipeline);
+	vkCmdSetViewport(cmd_buf, 0, 1, kq->internal_on ? &kq->internal_dst : &kq->viewport); // The rest stays cleared.
+	vkCmdSetScissor(cmd_buf, 0, 1, &kq->scissor);
+	const VkDescriptorSet sets[2] = {kq->post_scene.desc_set, kq->blur_post_set};
+	vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, kq->post_pipeline_layout, 0, 2, sets, 0, 0);
+	vkCmdPushConstants(cmd_buf, kq->post_pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof kq->post_push, &kq->post_push);
+	vkCmdDraw(cmd_buf, 3, 1, 0, 0);
+	++kq->stats.draw_calls;
+	kqvk_pass_end(kq, cmd_buf, 0);
+}
+
+bool kqvk_damage_begin(kq_data kq[static 1], bool full) {
+	if (!kq->damage_on)
+		return true;
+
+	const VkExtent2D extent = kq->internal_scissor.extent;
+	if (extent.width != kq->damage_extent.width || extent.height != kq->damage_extent.height) {
+		const u32 cols = (extent.width + KQ_DAMAGE_TILE - 1U) / KQ_DAMAGE_TILE;
+		const u32 rows = (extent.height + KQ_DAMAGE_TILE - 1U) / KQ_DAMAGE_TILE;
+		free(kq->damage_cells);
+		kq->damage_cells = malloc(sizeof(u64[2]) * cols * rows);
+		if (!kq->damage_cells) {
+			KQ_OOM_MSG();
+			kq->damage_extent = (VkExtent2D){0};
+			return false;
+		}
+		kq->damage_extent = extent;
+		kq->damage_cols = cols;
+		kq->damage_rows = rows;
+		full = true; // Everything is somewhere else at another resolution.
+	}
+
+	kq->damage_full = full;
+	memset(kq->damage_cells, 0, sizeof(u64) * kq->damage_cols * kq->damage_rows);
+	vecscenedraw_clear(kq->scene_draws);
+	return true;
+}
+
+// The finaliser of SplitMix64, over the hash so far and one more word.
+static u64 kqvk_hash_mix(u64 h, u64 w) {
+	h ^= w;
+	h = (h ^ h >> 30) * 0xBF58476D1CE4E5B9ULL;
+	h = (h ^ h >> 27) * 0x94D049BB133111EBULL;
+	return h ^ h >> 31;
+}
+
+// The frame of clip an instance started at start shows at time, as tile.vert works it out.
+static u32 kqvk_anim_frame(const kq_anim_clip clip[static 1], float start, float time) {
+	if (!clip->frames)
+		return 0U;
+
+	const u32 n = (u32)(fmaxf(time - start, 0.0f) * clip->fps);
+	switch (clip->mode) {
+	case KQ_ANIM_ONCE:
+		return n < clip->frames ? n : clip->frames - 1U;
+	case KQ_ANIM_PINGPONG: {
+		const u32 period = clip->frames > 1U ? 2U * clip->frames - 2U : 1U;
+		const u32 f = n % period;
+		return f < clip->frames ? f : period - f;
+	}
+	default:
+		return n % clip->frames;
+	}
+}
+
+// The frame of clip number clip an instance started at start shows at the frame's start. Asks for a frame as it next
+// turns over, as tile.vert will then show another.
+static u32 kqvk_anim_due(kq_data kq[static 1], u32 clip, float start) {
+	const kq_anim_clip *c = &kq->anim_clips[clip];
+	const float         time = (float)kq->anim_time;
+	const u32           frame = kqvk_anim_frame(c, start, time);
+	if (c->frames < 2U || !(c->fps > 0.0f) || (c->mode == KQ_ANIM_ONCE && frame == c->frames - 1U))
+		return frame;
+
+	const double n = floor(fmax((double)time - (double)start, 0.0) * (double)c->fps);
+	KQredraw_at(kq, (double)start + (n + 1.0) / (double)c->fps);
+	return frame;
+}
+
+// salt mixed with the camera's uniforms, field by field.
+static u64 kqvk_damage_camera_salt(const kq_data kq[static 1], u64 salt) {
+	u64 words[4];
+	memcpy(&words[0], kq->uniforms.camera, sizeof kq->uniforms.camera);
+	memcpy(&words[2], kq->uniforms.camera_offset, sizeof kq->uniforms.camera_offset);
+	memcpy(&words[3], kq->uniforms.camera_snap, sizeof kq->uniforms.camera_snap);
+	for (size_t k = 0; k < sizeof words / sizeof words[0]; ++k)
+		salt = kqvk_hash_mix(salt, words[k]);
+	return salt;
+}
+
+// Works out the cells inst covers, and its hash but for its animation; false if it is off the scene.
+static bool kqvk_damage_entry(const kq_data          kq[restrict static 1],
+                              const kq_tile_instance inst[restrict static 1],
+                              u64                    salt,
+                              u64                    camera_salt,
+                              kq_damage_entry        e[restrict static 1]) {
+	const float  w = (float)kq->damage_extent.width;
+	const float  h = (float)kq->damage_extent.height;
+	const float *m = kq->uniforms.camera;
+	const float *o = kq->uniforms.camera_offset;
+
+	// Instances under the camera land where it puts them, and change with it.
+	float pos[2] = {inst->position[0], inst->position[1]};
+	float ext[2] = {fabsf(inst->scale[0]), fabsf(inst->scale[1])};
+	if (!(inst->flags & KQ_INSTANCE_SCREEN)) {
+		pos[0] = m[0] * inst->position[0] + m[2] * inst->position[1] + o[0];
+		pos[1] = m[1] * inst->position[0] + m[3] * inst->position[1] + o[1];
+		ext[0] = fabsf(m[0]) * fabsf(inst->scale[0]) + fabsf(m[2]) * fabsf(inst->scale[1]);
+		ext[1] = fabsf(m[1]) * fabsf(inst->scale[0]) + fabsf(m[3]) * fabsf(inst->scale[1]);
+	}
+
+	// Pixels the quad touches, and one more around them for filtering and rounding, snapping included.
+	const float x0 = (pos[0] - ext[0] + 1.0f) * 0.5f * w - 1.0f;
+	const float x1 = (pos[0] + ext[0] + 1.0f) * 0.5f * w + 1.0f;
+	const float y0 = (pos[1] - ext[1] + 1.0f) * 0.5f * h - 1.0f;
+	const float y1 = (pos[1] + ext[1] + 1.0f) * 0.5f * h + 1.0f;
+	if (!(x1 >= 0.0f && y1 >= 0.0f && x0 < w && y0 < h)) // Off the scene, or NaN.
+		return false;
+
+	u64 words[sizeof(kq_tile_instance) / sizeof(u64)];
+	memcpy(words, inst, sizeof words);
+	e->hash = inst->flags & KQ_INSTANCE_SCREEN ? salt : camera_salt;
+	for (size_t k = 0; k < sizeof words / sizeof words[0]; ++k)
+		e->hash = kqvk_hash_mix(e->hash, words[k]);
+
+	e->cells[0] = (u16)(x0 > 0.0f ? (u32)x0 / KQ_DAMAGE_TILE : 0U);
+	e->cells[1] = (u16)(x1 < w ? (u32)x1 / KQ_DAMAGE_TILE : kq->damage_cols - 1U);
+	e->cells[2] = (u16)(y0 > 0.0f ? (u32)y0 / KQ_DAMAGE_TILE : 0U);
+	e->cells[3] = (u16)(y1 < h ? (u32)y1 / KQ_DAMAGE_TILE : kq->damage_rows - 1U);
+	e->clip = (inst->flags & KQ_INSTANCE_CLIP_MASK) >> KQ_INSTANCE_CLIP_SHIFT;
+	e->anim_start = inst->anim_start;
+	return true;
+}
+
+// Mixes an entry into the cells it covers, in draw order, so draws trading places over each other count as a change too.
+static void kqvk_damage_mix(kq_data kq[restrict static 1], const kq_damage_entry e[restrict static 1]) {
+	u64 hash = e->hash;
+
+	// An animated instance changes as its frame turns over, or its clip does. The time is the frame's start, not the one
+	// latched as it is submitted, so a frame turning over in between shows a frame late where nothing else is drawn.
+	if (e->clip && e->clip <= KQ_ANIM_CLIPS_MAX) {
+		const kq_anim_clip *c = &kq->anim_clips[e->clip - 1U];
+		u64                 clip_words[sizeof(kq_anim_clip) / sizeof(u64)];
+		memcpy(clip_words, c, sizeof clip_words);
+		for (size_t k = 0; k < sizeof clip_words / sizeof clip_words[0]; ++k)
+			hash = kqvk_hash_mix(hash, clip_words[k]);
+		hash = kqvk_hash_mix(hash, kqvk_anim_due(kq, e->clip - 1U, e->anim_start));
+	}
+
+	for (u32 r = e->cells[2]; r <= e->cells[3]; ++r) {
+		for (u32 c = e->cells[0]; c <= e->cells[1]; ++c)
+			kq->damage_cells[r * kq->damage_cols + c] = kqvk_hash_mix(kq->damage_cells[r * kq->damage_cols + c], hash);
+	}
+}
+
+void kqvk_damage_add(kq_data kq[static 1], u32 count, const kq_tile_instance inst[static count], u64 salt) {
+	if (!kq->damage_on || kq->target_active) {
+		// Animations still want frames drawn as they turn over.
+		for (u32 i = 0U; i < count; ++i) {
+			const u32 clip = (inst[i].flags & KQ_INSTANCE_CLIP_MASK) >> KQ_INSTANCE_CLIP_SHIFT;
+			if (clip && clip <= KQ_ANIM_CLIPS_MAX)
+				kqvk_anim_due(kq, clip - 1U, inst[i].anim_start);
+		}
+		return;
+	}
+
+	const u64 camera_salt = kqvk_damage_camera_salt(kq, salt);
+	for (u32 i = 0U; i < count; ++i) {
+		kq_damage_entry e;
+		if (kqvk_damage_entry(kq, &inst[i], salt, camera_salt, &e))
+			kqvk_damage_mix(kq, &e);
+	}
+}
+
+void kqvk_sprites_damage(kq_data kq[static 1], kq_sprite_store store[static 1]) {
+	if (!kq->damage_on || kq->target_active) {
+		// Animations still want frames drawn as they turn over; with no entries to go by, that means finding them.
+		if (!store->animated)
+			return;
+		store->animated = false;
+		for (u32 i = 0U; i < store->count; ++i) {
+			const u32 clip = (store->flags[i] & KQ_INSTANCE_CLIP_MASK) >> KQ_INSTANCE_CLIP_SHIFT;
+			if (!clip || store->flags[i] & (KQ_SPRITE_HIDDEN | KQ_SPRITE_FREE))
+				continue;
+			store->animated = true;
+			if (clip <= KQ_ANIM_CLIPS_MAX)
+				kqvk_anim_due(kq, clip - 1U, store->anim_starts[i]);
+		}
+		return;
+	}
+
+	// Entries hold cells, so a camera or scene size other than the one they were worked out under calls for them all again.
+	const u64 camera_salt = kqvk_damage_camera_salt(kq, 0);
+	const u64 key = kqvk_hash_mix(camera_salt, (u64)kq->damage_extent.width << 32 | kq->damage_extent.height);
+	if (key != store->damage_key) {
+		store->damage_key = key;
+		memset(store->damage_stale, 0xFF, sizeof(u64) * (store->cap / KQ_SPRITE_GROW));
+	}
+
+	const u32 blocks = (store->count + KQ_SPRITE_BLOCK - 1U) / KQ_SPRITE_BLOCK;
+	for (u32 b = 0U; b < blocks; ++b) {
+		const u64 bit = 1ULL << b % 64U;
+		if (store->blank[b / 64U] & bit) // Not drawn.
+			continue;
+		if (store->damage_stale[b / 64U] & bit) {
+			if (store->dirty[b / 64U] & bit) {
+				// Still waiting to go up, so what buf holds of it is no longer in the store to work out.
+				kq->damage_full = true;
+				continue;
+			}
+
+			// Only what changed since is worked out again: hidden, free and off-scene slots leave no entry.
+			const u32 first = b * KQ_SPRITE_BLOCK;
+			const u32 last = first + KQ_SPRITE_BLOCK < store->count ? first + KQ_SPRITE_BLOCK : store->count;
+			u8        n = 0U;
+			for (u32 i = first; i < last; ++i) {
+				if (store->flags[i] & (KQ_SPRITE_HIDDEN | KQ_SPRITE_FREE))
+					continue;
+				const kq_tile_instance inst = kqvk_sprite_instance(store, i);
+				if (kqvk_damage_entry(kq, &inst, 0, camera_salt, &store->damage[first + n]))
+					++n;
+			}
+			store->damage_counts[b] = n;
+			store->damage_stale[b / 64U] &= ~bit;
+		}
+
+		for (u32 i = 0U; i < store->damage_counts[b]; ++i)
+			kqvk_damage_mix(kq, &store->damage[b * KQ_SPRITE_BLOCK + i]);
+	}
+}
+
+// Merges runs of changed cells, row by row, into rectangles of cells: a run spanning the same columns as one ending on
+// the row above extends it down. Returns the count, or 0 with bounds set if there were more than KQ_DAMAGE_RUNS_MAX.
+static u32 kqvk_damage_runs(kq_data kq[static 1], VkRect2D runs[static KQ_DAMAGE_RUNS_MAX], VkRect2D bounds[static 1]) {
+	const u32  cols = kq->damage_cols;
+	const u64 *cur = kq->damage_cells;
+	const u64 *last = cur + (size_t)cols * kq->damage_rows;
+	u32        count = 0U;
+	bool       overflow = false;
+	s32        x0 = INT32_MAX, y0 = INT32_MAX, x1 = 0, y1 = 0;
+	for (u32 r = 0U; r < kq->damage_rows; ++r) {
+		for (u32 c = 0U; c < cols; ++c) {
+			if (cur[r * cols + c] == last[r * cols + c])
+				continue;
+			const u32 start = c;
+			while (c + 1U < cols && cur[r * cols + c + 1U] != last[r * cols + c + 1U])
+				++c;
+			x0 = (s32)start < x0 ? (s32)start : x0;
+			x1 = (s32)c + 1 > x1 ? (s32)c + 1 : x1;
+			y0 = (s32)r < y0 ? (s32)r : y0;
+			y1 = (s32)r + 1;
+
+			u32 i = 0U;
+			while (i < count
+			       && !(runs[i].offset.x == (s32)start && runs[i].extent.width == c + 1U - start
+			            && runs[i].offset.y + (s32)runs[i].extent.height == (s32)r))
+				++i;
+			if (i < count)
+				++runs[i].extent.height;
+			else if (count < KQ_DAMAGE_RUNS_MAX)
+				runs[count++] = (VkRect2D){.offset = {(s32)start, (s32)r}, .extent = {c + 1U - start, 1U}};
+			else
+				overflow = true;
+		}
+	}
+	if (x1 > 0) // Left zero-sized if no cell changed.
+		*bounds = (VkRect2D){.offset = {x0, y0}, .extent = {(u32)(x1 - x0), (u32)(y1 - y0)}};
+	return overflow ? 0U : count;
+}
+
+static s64 kqvk_rect_area(VkRect2D r) {
+	return (s64)r.extent.width * r.extent.height;
+}
+
+static VkRect2D kqvk_rect_union(VkRect2D a, VkRect2D b) {
+	const s32 x0 = a.offset.x < b.offset.x ? a.offset.x : b.offset.x;
+	const s32 y0 = a.offset.y < b.offset.y ? a.offset.y : b.offset.y;
+	const s32 ax1 = a.offset.x + (s32)a.extent.width, bx1 = b.offset.x + (s32)b.extent.width;
+	const s32 ay1 = a.offset.y + (s32)a.extent.height, by1 = b.offset.y + (s32)b.extent.height;
+	return (VkRect2D){.offset = {x0, y0}, .extent = {(u32)((ax1 > bx1 ? ax1 : bx1) - x0), (u32)((ay1 > by1 ? ay1 : by1) - y0)}};
+}
+
+void kqvk_damage_end(kq_data kq[static 1]) {
+	if (!kq->damage_on)
+		return;
+
+	const size_t cells = (size_t)kq->damage_cols * kq->damage_rows;
+	VkRect2D     runs[KQ_DAMAGE_RUNS_MAX];
+	VkRect2D     bounds = {0};
+	u32          count = kq->damage_full ? 0U : kqvk_damage_runs(kq, runs, &bounds);
+	if (kq->damage_full)
+		runs[count++] = (VkRect2D){.extent = {kq->damage_cols, kq->damage_rows}};
+	else if (!count && bounds.extent.width)
+		runs[count++] = bounds;
+
+	// Merges the pair whose bounds add the least area over theirs, until the rectangles fit.
+	while (count > KQ_DAMAGE_RECTS_MAX) {
+		u32 best_i = 0U, best_j = 1U;
+		s64 best = INT64_MAX;
+		for (u32 i = 0U; i < count; ++i) {
+			for (u32 j = i + 1U; j < count; ++j) {
+				const s64 waste = kqvk_rect_area(kqvk_rect_union(runs[i], runs[j])) - kqvk_rect_area(runs[i]) - kqvk_rect_area(runs[j]);
+				if (waste < best) {
+					best = waste;
+					best_i = i;
+					best_j = j;
+				}
+			}
+		}
+		runs[best_i] = kqvk_rect_union(runs[best_i], runs[best_j]);
+		runs[best_j] = runs[--count];
+	}
+
+	// Cells to pixels; the last row and column of cells can hang over the scene.
+	kq->damage_rects_count = count;
+	kq->stats.damage_px = 0;
+	for (u32 i = 0U; i < count; ++i) {
+		const u32 x = (u32)runs[i].offset.x * KQ_DAMAGE_TILE;
+		const u32 y = (u32)runs[i].offset.y * KQ_DAMAGE_TILE;
+		const u32 w = runs[i].extent.width * KQ_DAMAGE_TILE;
+		const u32 h = runs[i].extent.height * KQ_DAMAGE_TILE;
+		kq->damage_rects[i] = (VkRect2D){
+			.offset = {(s32)x, (s32)y},
+			.extent = {.width = w < kq->damage_extent.width - x ? w : kq->damage_extent.width - x,
+			           .height = h < kq->damage_extent.height - y ? h : kq->damage_extent.height - y},
+		};
+		kq->stats.damage_px += kq->damage_rects[i].extent.width * kq->damage_rects[i].extent.height;
+	}
+	memcpy(kq->damage_cells + cells, kq->damage_cells, sizeof(u64) * cells);
+}
+
+void kqvk_scene_record(kq_data kq[static 1], VkCommandBuffer cmd_buf) {
+	// Nothing changed, and post_scene still holds the last frame's scene.
+	if (!kq->damage_rects_count)
+		return;
+
+	kqvk_pass_begin(kq, cmd_buf, &kq->post_scene, !kq->damage_full);
+	kqvk_pass_bind(kq, cmd_buf);
+	VkDescriptorSet         bound = kq->target_default_set;
+	const VkClearAttachment clear = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .clearValue = rend_info.clear_color};
+	for (u32 r = 0U; r < kq->damage_rects_count; ++r) {
+		// Merged rectangles can overlap; clearing each before drawing it keeps blending from applying twice.
+		if (!kq->damage_full) {
+			const VkClearRect clear_rect = {.rect = kq->damage_rects[r], .layerCount = 1};
+			vkCmdClearAttachments(cmd_buf, 1, &clear, 1, &clear_rect);
+		}
+		vkCmdSetScissor(cmd_buf, 0, 1, &kq->damage_rects[r]);
+		for (size_t i = 0; i < kq->scene_draws->size; ++i) {
+			const kq_scene_draw *draw = &kq->scene_draws->p[i];
+			if (draw->set != bound) {
+				vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, kq->pipeline_layout, 1, 1, &draw->set, 0, 0);
+				bound = draw->set;
+			}
+			const VkDeviceSize offset = 0;
+			vkCmdBindVertexBuffers(cmd_buf, 1, 1, &draw->buf, &offset);
+			vkCmdDrawIndexed(cmd_buf, KQ_QUAD_NUM_INDICES, draw->count, 0, 0, draw->first);
+			++kq->stats.draw_calls;
+		}
+	}
+	kqvk_pass_end(kq, cmd_buf, &kq->post_scene);
+}
+
+bool kqvk_blur_init(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
+	if (vkCreateDescriptorSetLayout(kq->vk_ldev, &rend_info.blur_set_layout_cinfo, 0, &kq->blur_set_layout)) {
+		LOGM_FATAL("Unable to create the blur descriptor set layout.");
+		goto fail_vkCreateDescriptorSetLayout;
+	}
+
+	if (vkCreateDescriptorPool(kq->vk_ldev, &rend_info.blur_desc_pool_cinfo, 0, &kq->blur_desc_pool)) {
+		LOGM_FATAL("Unable to create the blur descriptor pool.");
+		goto fail_vkCreateDescriptorPool;
+	}
+
+	const VkDescriptorSetLayout layouts[3] = {kq->blur_set_layout, kq->blur_set_layout, kq->blur_set_layout};
+	const VkDescriptorSetAllocateInfo ainfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = kq->blur_desc_pool,
+		.descriptorSetCount = 3,
+		.pSetLayouts = layouts,
+	};
+	if (vkAllocateDescriptorSets(kq->vk_ldev, &ainfo, kq->blur_sets)) {
+		LOGM_FATAL("Unable to allocate the blur descriptor sets.");
+		goto fail_vkAllocateDescriptorSets;
+	}
+
+	// Like the default target set, valid but never sampled until there is a blur.
+	const VkDescriptorSetAllocateInfo post_ainfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = kq->target_desc_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &kq->target_set_layout,
+	};
+	if (vkAllocateDescriptorSets(kq->vk_ldev, &post_ainfo, &kq->blur_post_set)) {
+		LOGM_FATAL("Unable to allocate the post chain's blur descriptor set.");
+		goto fail_vkAllocateDescriptorSets;
+	}
+	kqvk_target_set_write(kq, kq->blur_post_set, kq->tiles_tex_view);
+
+	rend_info.blur_pipeline_layout_cinfo.pSetLayouts = &kq->blur_set_layout;
+	if (vkCreatePipelineLayout(kq->vk_ldev, &rend_info.blur_pipeline_layout_cinfo, 0, &kq->blur_pipeline_layout)) {
+		LOGM_FATAL("Unable to create the blur pipeline layout.");
+		goto fail_vkCreatePipelineLayout;
+	}
+	rend_info.blur_pipeline_cinfo.layout = kq->blur_pipeline_layout;
+
+	if (!kqvk_shader_module_load(kq, "shaders/blur_down.comp.spv", &kq->blur_down_module))
+		goto fail_down_module;
+	rend_info.blur_pipeline_cinfo.stage.module = kq->blur_down_module;
+	if (vkCreateComputePipelines(kq->vk_ldev, 0, 1, &rend_info.blur_pipeline_cinfo, 0, &kq->blur_down_pipeline)) {
+		LOGM_FATAL("Unable to create the blur downsampling pipeline.");
+		goto fail_down_pipeline;
+	}
+
+	if (!kqvk_shader_module_load(kq, "shaders/blur.comp.spv", &kq->blur_module))
+		goto fail_module;
+	rend_info.blur_pipeline_cinfo.stage.module = kq->blur_module;
+	if (vkCreateComputePipelines(kq->vk_ldev, 0, 1, &rend_info.blur_pipeline_cinfo, 0, &kq->blur_pipeline)) {
+		LOGM_FATAL("Unable to create the blur pipeline.");
+		goto fail_pipeline;
+	}
+	kq->blur_imgs[0] = 0;
+	return true;
+
+fail_pipeline:
+	vkDestroyShaderModule(kq->vk_ldev, kq->blur_module, 0);
+fail_module:
+	vkDestroyPipeline(kq->vk_ldev, kq->blur_down_pipeline, 0);
+fail_down_pipeline:
+	vkDestroyShaderModule(kq->vk_ldev, kq->blur_down_module, 0);
+fail_down_module:
+	vkDestroyPipelineLayout(kq->vk_ldev, kq->blur_pipeline_layout, 0);
+fail_vkCreatePipelineLayout:
+	vkFreeDescriptorSets(kq->vk_ldev, kq->target_desc_pool, 1, &kq->blur_post_set);
+fail_vkAllocateDescriptorSets:
+	vkDestroyDescriptorPool(kq->vk_ldev, kq->blur_desc_pool, 0);
+fail_vkCreateDescriptorPool:
+	vkDestroyDescriptorSetLayout(kq->vk_ldev, kq->blur_set_layout, 0);
+fail_vkCreateDescriptorSetLayout:
+	return false;
+}
+
+void kqvk_blur_stop(kq_data kq[static 1]) {
+	kqvk_blur_fit(kq, false);
+	vkDestroyPipeline(kq->vk_ldev, kq->blur_pipeline, 0);
+	vkDestroyShaderModule(kq->vk_ldev, kq->blur_module, 0);
+	vkDestroyPipeline(kq->vk_ldev, kq->blur_down_pipeline, 0);
+	vkDestroyShaderModule(kq->vk_ldev, kq->blur_down_module, 0);
+	vkDestroyPipelineLayout(kq->vk_ldev, kq->blur_pipeline_layout, 0);
+	vkFreeDescriptorSets(kq->vk_ldev, kq->target_desc_pool, 1, &kq->blur_post_set);
+	vkDestroyDescriptorPool(kq->vk_ldev, kq->blur_desc_pool, 0);
+	vkDestroyDescriptorSetLayout(kq->vk_ldev, kq->blur_set_layout, 0);
+}
+
+// Points blur set i at sampling src, in layout, and storing into dst.
+static void kqvk_blur_set_write(kq_data kq[static 1], u32 i, VkImageView src, VkImageLayout layout, VkImageView dst) {
+	const VkDescriptorImageInfo src_info = {.sampler = kq->target_sampler, .imageView = src, .imageLayout = layout};
+	const VkDescriptorImageInfo dst_info = {.imageView = dst, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+	const VkWriteDescriptorSet  writes[2] = {
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = kq->blur_sets[i],
+			.dstBinding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			.pImageInfo = &src_info,
+		},
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = kq->blur_sets[i],
+			.dstBinding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.descriptorCount = 1,
+			.pImageInfo = &dst_info,
+		},
+	};
+	vkUpdateDescriptorSets(kq->vk_ldev, 2, writes, 0, 0);
+}
+
+bool kqvk_blur_fit(kq_data kq[static 1], bool needed) {
+	u32 factor = 2U;
+	while (factor < KQ_BLUR_FACTOR_MAX && kq->post_scene.height / factor > KQ_BLUR_HEIGHT_MAX)
+		factor *= 2U;
+	const VkExtent2D extent = {(kq->post_scene.width + factor - 1) / factor, (kq->post_scene.height + factor - 1) / factor};
+
+	if (kq->blur_imgs[0]) {
+		if (needed && kq->blur_extent.width == extent.width && kq->blur_extent.height == extent.height)
+			return true;
+
+		vkDeviceWaitIdle(kq->vk_ldev);
+		for (u32 i = 0U; i < 2U; ++i) {
+			vkDestroyImageView(kq->vk_ldev, kq->blur_views[i], 0);
+			vkDestroyImage(kq->vk_ldev, kq->blur_imgs[i], 0);
+			vkFreeMemory(kq->vk_ldev, kq->blur_imgs_mem[i], 0);
+			kq->blur_imgs[i] = 0;
+		}
+		kqvk_target_set_write(kq, kq->blur_post_set, kq->tiles_tex_view);
+	}
+	if (!needed)
+		return true;
+
+	u32 created = 0U;
+	for (; created < 2U; ++created) {
+		if (!kqvk_image_create(kq,
+		                       extent.width,
+		                       extent.height,
+		                       1,
+		                       rend_info.blur_view_cinfo.format,
+		                       VK_IMAGE_TILING_OPTIMAL,
+		                       VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		                       &kq->blur_imgs[created],
+		                       &kq->blur_imgs_mem[created])) {
+			LOGM_ERROR("Unable to create a %ux%u blur image.", extent.width, extent.height);
+			goto fail;
+		}
+
+		VkImageViewCreateInfo view_cinfo = rend_info.blur_view_cinfo;
+		view_cinfo.image = kq->blur_imgs[created];
+		if (vkCreateImageView(kq->vk_ldev, &view_cinfo, 0, &kq->blur_views[created])) {
+			LOGM_ERROR("Unable to create a blur image view.");
+			vkDestroyImage(kq->vk_ldev, kq->blur_imgs[created], 0);
+			vkFreeMemory(kq->vk_ldev, kq->blur_imgs_mem[created], 0);
+			goto fail;
+		}
+		kqvk_image_layout_transition(kq, kq->blur_imgs[created], 1, view_cinfo.format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	}
+	kq->blur_extent = extent;
+	kq->blur_factor = factor;
+
+	kqvk_blur_set_write(kq, 0, kq->post_scene.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, kq->blur_views[0]);
+	kqvk_blur_set_write(kq, 1, kq->blur_views[0], VK_IMAGE_LAYOUT_GENERAL, kq->blur_views[1]);
+	kqvk_blur_set_write(kq, 2, kq->blur_views[1], VK_IMAGE_LAYOUT_GENERAL, kq->blur_views[0]);
+
+	const VkDescriptorImageInfo post_info = {.sampler = kq->target_sampler, .imageView = kq->blur_views[0], .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+	const VkWriteDescriptorSet  post_write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = kq->blur_post_set,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 1,
+		.pImageInfo = &post_info,
+	};
+	vkUpdateDescriptorSets(kq->vk_ldev, 1, &post_write, 0, 0);
+	return true;
+
+fail:
+	for (u32 i = 0U; i < created; ++i) {
+		vkDestroyImageView(kq->vk_ldev, kq->blur_views[i], 0);
+		vkDestroyImage(kq->vk_ldev, kq->blur_imgs[i], 0);
+		vkFreeMemory(kq->vk_ldev, kq->blur_imgs_mem[i], 0);
+	}
+	kq->blur_imgs[0] = 0;
+	return false;
+}
+
+void kqvk_blur_record(kq_data kq[static 1], VkCommandBuffer cmd_buf, const kq_post_step step[static 1]) {
+	// The radius is in frame pixels; at the blur's resolution, fewer taps cover it.
+	const float  radius = fmax(step->params[1] / (float)kq->blur_factor, 1.0f);
+	kq_blur_push push = {
+		.radius = (s32)fmin(ceil(radius), (float)KQ_BLUR_RADIUS_MAX),
+		.sigma = radius * 0.5f,
+		.threshold = step->effect == KQ_POST_BLOOM ? step->params[2] : 0.0f,
+		.factor = kq->blur_factor,
+	};
+	const u32 w = kq->blur_extent.width, h = kq->blur_extent.height;
+
+	// The last frame's passes may still be reading the images this one writes.
+	VkMemoryBarrier barrier = {.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+	vkCmdPipelineBarrier(cmd_buf,
+	                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+	                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+	                     0,
+	                     1,
+	                     &barrier,
+	                     0,
+	                     0,
+	                     0,
+	                     0);
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, kq->blur_down_pipeline);
+	vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, kq->blur_pipeline_layout, 0, 1, &kq->blur_sets[0], 0, 0);
+	vkCmdPushConstants(cmd_buf, kq->blur_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof push, &push);
+	vkCmdDispatch(cmd_buf, (w + 7) / 8, (h + 7) / 8, 1);
+
+	// Across rows into blur_imgs[1], then down columns back into [0]: one workgroup per KQ_BLUR_GROUP texels of a line.
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, kq->blur_pipeline);
+	for (u32 pass = 0U; pass < 2U; ++pass) {
+		vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, 0, 0, 0);
+		push.dir[0] = pass == 0U;
+		push.dir[1] = pass == 1U;
+		vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, kq->blur_pipeline_layout, 0, 1, &kq->blur_sets[1 + pass], 0, 0);
+		vkCmdPushConstants(cmd_buf, kq->blur_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof push, &push);
+		const u32 len = pass ? h : w, lines = pass ? w : h;
+		vkCmdDispatch(cmd_buf, (len + KQ_BLUR_GROUP - 1) / KQ_BLUR_GROUP, lines, 1);
+	}
+
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, 0, 0, 0);
+}
+
 bool kqvk_create_vertex_buffer(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	VkBuffer              staging_buf;
 	VkDeviceMemory        staging_buf_mem;
 	register const size_t buf_size = sizeof(kq_vertex[KQ_QUAD_NUM_VERTICES]);
@@ -711,6 +2329,7 @@ bool kqvk_create_vertex_buffer(kq_data kq[static 1]) {
 }
 
 bool kqvk_create_index_buffer(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	VkBuffer              staging_buf;
 	VkDeviceMemory        staging_buf_mem;
 	register const size_t buf_size = sizeof(u16[KQ_QUAD_NUM_INDICES]);
@@ -743,6 +2362,7 @@ bool kqvk_create_index_buffer(kq_data kq[static 1]) {
 }
 
 bool kqvk_create_tiles_tex(kq_data kq[restrict static 1]) {
+	KQ_PROF_FUNC();
 	stbi_uc *img1 = kqvk_tex_load("textures/tiles/1.png", KQ_TILES_IMAGE_WIDTH, KQ_TILES_IMAGE_HEIGHT, STBI_rgb_alpha);
 	if (!img1)
 		return 0;
@@ -818,6 +2438,7 @@ bool kqvk_create_tiles_tex(kq_data kq[restrict static 1]) {
 }
 
 bool kqvk_create_tiles_tex_view(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	rend_info.tiles_tex_view_cinfo.image = kq->tiles_tex_image;
 
 	if (vkCreateImageView(kq->vk_ldev, &rend_info.tiles_tex_view_cinfo, 0, &kq->tiles_tex_view)) {
@@ -831,6 +2452,7 @@ bool kqvk_create_tiles_tex_view(kq_data kq[static 1]) {
 }
 
 bool kqvk_create_tiles_tex_sampler(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	VkPhysicalDeviceProperties props;
 	vkGetPhysicalDeviceProperties(kq->vk_pdev, &props);
 
@@ -847,6 +2469,7 @@ bool kqvk_create_tiles_tex_sampler(kq_data kq[static 1]) {
 }
 
 bool kqvk_uniforms_init(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	if (!kqvk_create_uniform_buffers(kq))
 		return false;
 
@@ -875,6 +2498,7 @@ bool kqvk_uniforms_init(kq_data kq[static 1]) {
 }
 
 bool kqvk_create_sync_primitives(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	for (size_t i = 0; i < KQ_FRAMES_IN_FLIGHT; ++i) {
 		if (vkCreateFence(kq->vk_ldev, &rend_info.fence_cinfo, 0, &kq->in_flight_fence[i])) {
 			for (size_t j = 0; j < i; ++j) {
@@ -911,8 +2535,59 @@ bool kqvk_create_sync_primitives(kq_data kq[static 1]) {
 
 
 
+void kqvk_create_timestamp_pool(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
+	u32 q_family_count = 0U;
+	vkGetPhysicalDeviceQueueFamilyProperties(kq->vk_pdev, &q_family_count, 0);
+	VkQueueFamilyProperties *q_families = malloc(sizeof(VkQueueFamilyProperties[q_family_count]));
+	if (!q_families) {
+		KQ_OOM_MSG();
+		return;
+	}
+	vkGetPhysicalDeviceQueueFamilyProperties(kq->vk_pdev, &q_family_count, q_families);
+	const u32 valid_bits = q_families[kq->q_graphics_index].timestampValidBits;
+	free(q_families);
+
+	if (!valid_bits) {
+		LOGM_WARN("Graphics queue has no timestamp support; GPU frame times will not be reported.");
+		return;
+	}
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(kq->vk_pdev, &props);
+	kq->timestamp_period = (double)props.limits.timestampPeriod;
+	kq->timestamp_mask = valid_bits >= 64U ? UINT64_MAX : (1ULL << valid_bits) - 1ULL;
+
+	const VkQueryPoolCreateInfo cinfo = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = KQ_GPU_TIMESTAMPS * KQ_FRAMES_IN_FLIGHT,
+	};
+	if (vkCreateQueryPool(kq->vk_ldev, &cinfo, 0, &kq->timestamp_pool)) {
+		LOGM_WARN("Unable to create timestamp query pool; GPU frame times will not be reported.");
+		kq->timestamp_pool = 0;
+	}
+}
+
+u64 kqvk_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+void kqvk_sleep_until_ns(u64 t) {
+	if (t > KQ_SLEEP_SPIN_NS) {
+		const u64             wake = t - KQ_SLEEP_SPIN_NS;
+		const struct timespec ts = {.tv_sec = (time_t)(wake / 1000000000ULL), .tv_nsec = (long)(wake % 1000000000ULL)};
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR)
+			;
+	}
+	while (kqvk_now_ns() < t)
+		;
+}
+
 bool kqvk_create_uniform_buffers(kq_data kq[static 1]) {
-	register const size_t buf_size = sizeof(kq_uniforms);
+	register const size_t buf_size = KQ_ANIM_TABLE_OFFSET + sizeof(kq_anim_clip[KQ_ANIM_CLIPS_MAX]);
 
 	for (size_t i = 0; i < KQ_FRAMES_IN_FLIGHT; ++i) {
 		kqvk_buffer_create(kq,
@@ -924,43 +2599,78 @@ bool kqvk_create_uniform_buffers(kq_data kq[static 1]) {
 
 		vkMapMemory(kq->vk_ldev, kq->uniform_bufs_mem[i], 0, buf_size, 0, &kq->uniform_bufs_mapped[i]);
 	}
+	kq->anim_stale = (1U << KQ_FRAMES_IN_FLIGHT) - 1U; // The clip tables start out as garbage.
 
 	return true;
 }
 
 bool kqvk_swapchain_recreate(kq_data kq[static 1]) {
+	KQ_PROF_FUNC();
 	vkDeviceWaitIdle(kq->vk_ldev);
 
 	// Checks for minimized window.
-	while (!(kq->scissor.extent.width | kq->scissor.extent.height))
+	while (!kq->headless && !(kq->scissor.extent.width | kq->scissor.extent.height))
 		glfwWaitEvents();
 
 	LOGM_TRACE("Recreating swapchain.");
 
 	// Destroy old swapchain stuff, but not the swapchain itself (to be reused).
 	for (u32 i = 0; i < kq->swapchain_img_count; ++i) {
-		vkDestroyFramebuffer(kq->vk_ldev, kq->fbos[i], 0);
+		if (kq->fbos)
+			vkDestroyFramebuffer(kq->vk_ldev, kq->fbos[i], 0);
 		vkDestroyImageView(kq->vk_ldev, kq->swapchain_img_views[i], 0);
 	}
 
-	if (!kqvk_create_swapchain(kq))
+	if (kq->headless) {
+		kqvk_destroy_headless_images(kq, kq->swapchain_img_count);
+		if (!kqvk_create_headless_images(kq))
+			return false;
+	} else if (!kqvk_create_swapchain(kq)) {
 		return false;
+	}
 	if (!kqvk_create_framebuffers(kq))
 		return false;
 
+	kq->damage_window = true;
 	return true;
 }
 
 void kqvk_uniforms_update_time(kq_data kq[static 1]) {
-	register const double now = glfwGetTime();
+	register const double now = kq->headless ? kq->headless_time : glfwGetTime();
 
 	kq->uniforms.time = (float)now;
 	kq->uniforms.time_sin = (float)(sin(now));
 	kq->uniforms.time_cos = (float)(cos(now));
 }
 
+void kqvk_uniforms_camera(kq_data kq[static 1]) {
+	// The scene's drawn size, latched for the frame, rather than whichever viewport is current: a render target's, or
+	// the window's before the internal resolution's goes in.
+	const float w = kq->internal_viewport.width;
+	const float h = kq->internal_viewport.height;
+	const float c = kq->camera.zoom * cosf(kq->camera.rotation);
+	const float s = kq->camera.zoom * sinf(kq->camera.rotation);
+	const float aspect = w > 0.0f && h > 0.0f ? w / h : 1.0f;
+
+	// Rotating in pixels rather than NDC keeps a non-square viewport from shearing what turns.
+	kq->uniforms.camera[0] = c;
+	kq->uniforms.camera[1] = s * aspect;
+	kq->uniforms.camera[2] = -s / aspect;
+	kq->uniforms.camera[3] = c;
+	kq->uniforms.camera_offset[0] = -(kq->uniforms.camera[0] * kq->camera.pos[0] + kq->uniforms.camera[2] * kq->camera.pos[1]);
+	kq->uniforms.camera_offset[1] = -(kq->uniforms.camera[1] * kq->camera.pos[0] + kq->uniforms.camera[3] * kq->camera.pos[1]);
+	kq->uniforms.camera_snap[0] = kq->camera.snap ? w : 0.0f;
+	kq->uniforms.camera_snap[1] = kq->camera.snap ? h : 0.0f;
+}
+
 void kqvk_uniforms_push(kq_data kq[static 1]) {
 	memcpy(kq->uniform_bufs_mapped[kq->current_frame], &kq->uniforms, sizeof(kq_uniforms));
+
+	// Clips change rarely, so each frame's copy of the table is brought up to date only after they do.
+	if (kq->anim_stale & 1U << kq->current_frame) {
+		memcpy((u8 *)kq->uniform_bufs_mapped[kq->current_frame] + KQ_ANIM_TABLE_OFFSET, kq->anim_clips, sizeof kq->anim_clips);
+		kq->anim_stale &= ~(1U << kq->current_frame);
+	}
 }
 
 bool kqvk_create_descriptor_sets(kq_data kq[static 1]) {
@@ -976,10 +2686,17 @@ bool kqvk_create_descriptor_sets(kq_data kq[static 1]) {
 
 	for (size_t i = 0; i < KQ_FRAMES_IN_FLIGHT; ++i) {
 		rend_info.desc_binfo.buffer = kq->uniform_bufs[i];
+		rend_info.anim_binfo.buffer = kq->uniform_bufs[i];
 		rend_info.desc_write[0].dstSet = kq->desc_sets[i];
 		rend_info.desc_write[1].dstSet = kq->desc_sets[i];
-		vkUpdateDescriptorSets(kq->vk_ldev, 2, rend_info.desc_write, 0, 0);
+		rend_info.desc_write[2].dstSet = kq->desc_sets[i];
+		rend_info.desc_write[3].dstSet = kq->desc_sets[i];
+		vkUpdateDescriptorSets(kq->vk_ldev, 4, rend_info.desc_write, 0, 0);
 	}
 
 	return true;
 }
+
+
+cb_impl_vec(vecbufupload, kq_buffer_upload);
+cb_impl_vec(vecscenedraw, kq_scene_draw);
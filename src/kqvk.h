@@ -18,10 +18,13 @@
 extern bool kqvk_instance_add_validation_layers(VkInstanceCreateInfo instance_cinfo[static 1]);
 #endif
 
-extern bool kqvk_instance_add_extensions(VkInstanceCreateInfo instance_cinfo[static 1]);
+extern bool kqvk_instance_add_extensions(VkInstanceCreateInfo instance_cinfo[static 1], bool headless);
 
 extern bool kqvk_check_pdev_for_extension(VkPhysicalDevice pdev, const char ext[restrict static 1]);
 
+// Fills the device extension list: the required ones, and any optional ones the physical device supports.
+extern bool kqvk_device_add_extensions(kq_data kq[static 1]);
+
 extern bool kqvk_choose_pdev(kq_data kq[static 1]);
 
 extern int kqvk_reload_vulkan(VkInstance ins, VkPhysicalDevice pdev, VkDevice ldev);
@@ -68,9 +71,18 @@ extern void kqvk_buffer_copy_to_image(kq_data kq[restrict static 1], VkBuffer bu
 
 extern stbi_uc *kqvk_tex_load(const char path[restrict static 1], int desired_width, int desired_height, int desired_channels);
 
+// Uncompressed (stored deflate) RGBA8 PNG; stb only decodes.
+extern bool kqvk_png_write(const char path[restrict static 1], u32 w, u32 h, const u8 rgba[restrict static 4]);
+
 
 extern bool kqvk_create_swapchain(kq_data kq[static 1]);
 
+// Headless stand-in for the swapchain: one offscreen image and readback buffer per frame in flight.
+extern bool kqvk_create_headless_images(kq_data kq[static 1]);
+
+// Destroys the first count headless images, their memory and readback buffers, but not their views.
+extern void kqvk_destroy_headless_images(kq_data kq[static 1], u32 count);
+
 extern bool kqvk_init_shaders(kq_data kq[static 1]);
 
 extern bool kqvk_create_render_pass(kq_data kq[static 1]);
@@ -85,6 +97,110 @@ extern bool kqvk_create_cmd_pool(kq_data kq[static 1]);
 
 extern bool kqvk_create_cmd_bufs(kq_data kq[static 1]);
 
+// Allocates another instance buffer chunk for a frame in flight.
+extern bool kqvk_instance_chunk_add(kq_data kq[static 1], size_t frame);
+
+extern bool kqvk_create_instance_buffers(kq_data kq[static 1]);
+
+extern void kqvk_destroy_instance_buffers(kq_data kq[static 1]);
+
+// Space for one more instance in the current batch, moving on to the next chunk when full; 0 if out of chunks.
+extern kq_tile_instance *kqvk_batch_push(kq_data kq[static 1]);
+
+// Room for up to room instances in the current batch, moving on to the next chunk when full; 0 if out of chunks. Those
+// written are added to the batch by kqvk_batch_commit().
+extern kq_tile_instance *kqvk_batch_reserve(kq_data kq[static 1], u32 room[static 1]);
+
+extern void kqvk_batch_commit(kq_data kq[static 1], u32 count);
+
+// Records a draw for the instances pushed since the last flush.
+extern void kqvk_batch_flush(kq_data kq[static 1]);
+
+// Draws count instances from first on from a buffer other than the batch's, after flushing the batch.
+extern void kqvk_draw_instances(kq_data kq[static 1], VkBuffer buf, u32 first, u32 count);
+
+// Uploads the store's dirty blocks, as far as this frame's staging goes, growing its buffer first if it must. Returns
+// false on failure; blocks left dirty are uploaded by the next calls, starting from the first left.
+extern bool kqvk_sprites_upload(kq_data kq[restrict static 1], kq_sprite_store store[restrict static 1]);
+
+// Adds the store's instances to the damage tracking as buf holds them. Each block's entries are kept, and only worked out
+// again once it is uploaded, or the camera or scene size change. Without damage tracking, asks for frames as the store's
+// animations turn over.
+extern void kqvk_sprites_damage(kq_data kq[static 1], kq_sprite_store store[static 1]);
+
+extern bool kqvk_create_upload_buffers(kq_data kq[static 1]);
+
+extern void kqvk_destroy_upload_buffers(kq_data kq[static 1]);
+
+// Reserves staging memory for the current frame's uploads, or returns 0 if it is used up until the next frame.
+extern void *kqvk_upload_reserve(kq_data kq[static 1], VkDeviceSize size, VkDeviceSize offset[static 1]);
+
+// Bytes kqvk_upload_reserve() can still hand out this frame.
+extern VkDeviceSize kqvk_upload_available(kq_data kq[static 1]);
+
+// Records the frame's pending uploads, ends the render target passes' command buffer if one was begun, and points the
+// submit info at the command buffers to submit, in order.
+extern bool kqvk_uploads_end(kq_data kq[static 1]);
+
+// Binds the tile pipeline and its buffers and descriptor sets, and sets kq->viewport, for a pass about to be drawn.
+extern void kqvk_pass_bind(kq_data kq[static 1], VkCommandBuffer cmd_buf);
+
+// Binds set as the render target to sample (set 1), flushing the batch if a different one was bound.
+extern void kqvk_target_bind(kq_data kq[static 1], VkDescriptorSet set);
+
+// Clears a single layer image to transparent, leaving it ready for sampling.
+extern void kqvk_image_clear(kq_data kq[static 1], VkImage img);
+
+// The render target pass, sampler and descriptor pool, and the default target set. After the tiles texture.
+extern bool kqvk_targets_init(kq_data kq[static 1]);
+
+extern void kqvk_targets_stop(kq_data kq[static 1]);
+
+// Points a render target descriptor set at view.
+extern void kqvk_target_set_write(kq_data kq[static 1], VkDescriptorSet set, VkImageView view);
+
+// Begins a pass clearing target, or the frame's swapchain image if target is null; with dynamic rendering, also moves
+// the image into the attachment layout. With load, target keeps what it holds instead, and must be ready to sample.
+extern void kqvk_pass_begin(kq_data kq[static 1], VkCommandBuffer cmd_buf, const kq_render_target *target, bool load);
+
+// Ends a pass begun with kqvk_pass_begin() on the same target, leaving the image ready to be sampled, copied out or
+// presented.
+extern void kqvk_pass_end(kq_data kq[static 1], VkCommandBuffer cmd_buf, const kq_render_target *target);
+
+// The post chain's pipeline. After the render pass and the render targets.
+extern bool kqvk_post_init(kq_data kq[static 1]);
+
+extern void kqvk_post_stop(kq_data kq[static 1]);
+
+// Records the post chain as one pass over the frame's swapchain image, reading kq->post_scene.
+extern void kqvk_post_record(kq_data kq[static 1], VkCommandBuffer cmd_buf);
+
+// Sizes the damage cells for the frame's scene and empties them, and the draw log. full draws all of the scene again,
+// for when post_scene holds nothing to keep.
+extern bool kqvk_damage_begin(kq_data kq[static 1], bool full);
+
+// Hashes count instances of the scene into the cells they cover; salt stands for what they sample that can change.
+// Does nothing without damage tracking, or while a render target is active.
+extern void kqvk_damage_add(kq_data kq[static 1], u32 count, const kq_tile_instance inst[static count], u64 salt);
+
+// Compares the cells with the last frame's, and sets kq->damage_rects to the parts of post_scene to draw again.
+extern void kqvk_damage_end(kq_data kq[static 1]);
+
+// Records the logged scene draws into post_scene, over each of the damage rectangles.
+extern void kqvk_scene_record(kq_data kq[static 1], VkCommandBuffer cmd_buf);
+
+// The post chain's compute blur pipelines and descriptor sets. After kqvk_post_init().
+extern bool kqvk_blur_init(kq_data kq[static 1]);
+
+extern void kqvk_blur_stop(kq_data kq[static 1]);
+
+// Makes or frees the blur images, sized for kq->post_scene, and points the blur's sets at them. Waits for the device
+// when it changes anything in use.
+extern bool kqvk_blur_fit(kq_data kq[static 1], bool needed);
+
+// Records the downsample and the two blur passes step needs, leaving the result in blur_imgs[0] for the post pass.
+extern void kqvk_blur_record(kq_data kq[static 1], VkCommandBuffer cmd_buf, const kq_post_step step[static 1]);
+
 extern bool kqvk_create_vertex_buffer(kq_data kq[static 1]);
 
 extern bool kqvk_create_index_buffer(kq_data kq[static 1]);
@@ -99,6 +215,9 @@ extern bool kqvk_uniforms_init(kq_data kq[static 1]);
 
 extern bool kqvk_create_sync_primitives(kq_data kq[static 1]);
 
+// Not fatal on failure; frames then simply report no GPU time.
+extern void kqvk_create_timestamp_pool(kq_data kq[static 1]);
+
 
 extern bool kqvk_create_uniform_buffers(kq_data kq[static 1]);
 
@@ -111,12 +230,21 @@ extern void kqvk_uniforms_update_time(kq_data kq[static 1]);
 
 extern void kqvk_uniforms_push(kq_data kq[static 1]);
 
+// Works out uniforms.camera* from the camera and internal_viewport, the scene's drawn size for the frame.
+extern void kqvk_uniforms_camera(kq_data kq[static 1]);
+
 extern bool kqvk_create_descriptor_sets(kq_data kq[static 1]);
 
+extern u64 kqvk_now_ns(void);
+
+// Sleeps until kqvk_now_ns() reaches t, spinning for the last KQ_SLEEP_SPIN_NS of it.
+extern void kqvk_sleep_until_ns(u64 t);
+
 
 #if KQ_DEBUG
 extern vecstr *kqvk_validation_layers_vec;
 #endif
 extern vecstr *kqvk_instance_exts_vec;
+extern vecstr *kqvk_device_exts_vec;
 
 #endif /* KQVK_H_ */
@@ -0,0 +1,482 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <kq.h>
+#include <kqvk.h>
+#include <libcbase/log.h>
+
+#include "kq_scenes.h"
+
+
+#define CB_LOG_MODULE "BENCH"
+
+#define KQ_BENCH_DEFAULT_FRAMES    600U
+#define KQ_BENCH_DEFAULT_WARMUP    60U
+#define KQ_BENCH_DEFAULT_TOLERANCE 0.1
+#define KQ_BENCH_DEFAULT_BASELINE  "tools/bench_baseline.csv"
+#define KQ_BENCH_MAX_COUNTS        16U
+#define KQ_BENCH_MAX_RESULTS       256U
+
+#define KQ_BENCH_CSV_HEADER                                                                                                        \
+	"scene,count,frames,ns_per_draw,cpu_p50_us,cpu_p90_us,cpu_p99_us,gpu_p50_us,gpu_p90_us,gpu_p99_us,draw_calls,quads,rss_kib," \
+	"device_mem_kib"
+
+
+typedef struct kq_bench_result {
+	char   scene[32];
+	u32    count;
+	u32    frames;
+	double ns_per_draw;
+	double cpu_us[3]; // p50, p90, p99.
+	double gpu_us[3]; // Zeroes without GPU timestamps.
+	u32    draw_calls;
+	u32    quads;
+	u64    rss_kib;
+	u64    device_mem_kib;
+} kq_bench_result;
+
+typedef struct kq_bench_opts {
+	u32         frames;
+	u32         warmup;
+	u32         counts[KQ_BENCH_MAX_COUNTS];
+	u32         counts_num;
+	const char *scenes;
+	bool        json;
+	const char *out;
+	const char *baseline;
+	bool        write_baseline;
+	double      tolerance;
+	bool        windowed;
+	bool        render_passes;
+	u32         width;
+	u32         height;
+} kq_bench_opts;
+
+
+static kq_data kq = {0};
+
+static kq_bench_result results[KQ_BENCH_MAX_RESULTS];
+static size_t          results_num = 0;
+
+
+static void kq_bench_usage(FILE f[static 1]) {
+	fputs("Usage: kq_bench [OPTION]...\n"
+	      "Renders scripted scenes for a fixed number of frames and reports frame timings.\n"
+	      "\n"
+	      "  --frames N           measured frames per run (default 600)\n"
+	      "  --warmup N           unmeasured frames before each run (default 60)\n"
+	      "  --counts N,N,...     sprite counts to sweep (default: each scene's own count)\n"
+	      "  --scenes A,B,...     scenes to run (default: all)\n"
+	      "  --width N            headless width (default 800)\n"
+	      "  --height N           headless height (default 600)\n"
+	      "  --windowed           render to a window, presenting with IMMEDIATE if available\n"
+	      "  --render-passes      use render passes and framebuffers even where dynamic rendering is supported\n"
+	      "  --json               write JSON instead of CSV\n"
+	      "  --out PATH           write the report to PATH instead of stdout\n"
+	      "  --baseline PATH      compare against PATH (default " KQ_BENCH_DEFAULT_BASELINE ", if it exists)\n"
+	      "  --write-baseline     write the results to the baseline path instead of comparing\n"
+	      "  --tolerance F        allowed slowdown against the baseline, as a fraction (default 0.1)\n"
+	      "\n"
+	      "Exits with 2 if any result regressed past the tolerance.\n"
+	      "Scenes:",
+	      f);
+	for (size_t i = 0; i < kq_scenes_count; ++i)
+		fprintf(f, " %s", kq_scenes[i].name);
+	fputc('\n', f);
+}
+
+static bool kq_bench_parse_u32(const char s[static 1], u32 out[static 1]) {
+	char *end;
+	errno = 0;
+	const unsigned long v = strtoul(s, &end, 10);
+	if (errno || end == s || *end || v > UINT32_MAX)
+		return false;
+	*out = (u32)v;
+	return true;
+}
+
+static bool kq_bench_parse_args(int argc, char *argv[static argc], kq_bench_opts opts[static 1]) {
+	for (int i = 1; i < argc; ++i) {
+		const char *arg = argv[i];
+		const char *val = i + 1 < argc ? argv[i + 1] : 0;
+
+		if (!strcmp(arg, "--json")) {
+			opts->json = true;
+		} else if (!strcmp(arg, "--windowed")) {
+			opts->windowed = true;
+		} else if (!strcmp(arg, "--render-passes")) {
+			opts->render_passes = true;
+		} else if (!strcmp(arg, "--write-baseline")) {
+			opts->write_baseline = true;
+		} else if (!strcmp(arg, "--help") || !strcmp(arg, "-h")) {
+			kq_bench_usage(stdout);
+			exit(EXIT_SUCCESS);
+		} else if (!val) {
+			LOGM_ERROR("Unknown option or missing value: %s.", arg);
+			return false;
+		} else {
+			++i;
+			if (!strcmp(arg, "--frames")) {
+				if (!kq_bench_parse_u32(val, &opts->frames) || !opts->frames)
+					goto bad_value;
+			} else if (!strcmp(arg, "--warmup")) {
+				if (!kq_bench_parse_u32(val, &opts->warmup))
+					goto bad_value;
+			} else if (!strcmp(arg, "--width")) {
+				if (!kq_bench_parse_u32(val, &opts->width) || !opts->width)
+					goto bad_value;
+			} else if (!strcmp(arg, "--height")) {
+				if (!kq_bench_parse_u32(val, &opts->height) || !opts->height)
+					goto bad_value;
+			} else if (!strcmp(arg, "--scenes")) {
+				opts->scenes = val;
+			} else if (!strcmp(arg, "--out")) {
+				opts->out = val;
+			} else if (!strcmp(arg, "--baseline")) {
+				opts->baseline = val;
+			} else if (!strcmp(arg, "--tolerance")) {
+				char *end;
+				opts->tolerance = strtod(val, &end);
+				if (end == val || *end || opts->tolerance < 0.0)
+					goto bad_value;
+			} else if (!strcmp(arg, "--counts")) {
+				char  buf[256];
+				char *save;
+				snprintf(buf, sizeof buf, "%s", val);
+				opts->counts_num = 0;
+				for (char *tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(0, ",", &save)) {
+					if (opts->counts_num == KQ_BENCH_MAX_COUNTS || !kq_bench_parse_u32(tok, &opts->counts[opts->counts_num]))
+						goto bad_value;
+					++opts->counts_num;
+				}
+			} else {
+				LOGM_ERROR("Unknown option: %s.", arg);
+				return false;
+			}
+			continue;
+		bad_value:
+			LOGM_ERROR("Bad value for %s: \"%s\".", arg, val);
+			return false;
+		}
+	}
+	return true;
+}
+
+static int kq_bench_cmp_u64(const void *a, const void *b) {
+	const u64 x = *(const u64 *)a;
+	const u64 y = *(const u64 *)b;
+	return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of a sorted array, in microseconds.
+static double kq_bench_percentile_us(size_t n, const u64 sorted[static n], u32 p) {
+	size_t rank = (n * p + 99U) / 100U;
+	if (rank)
+		--rank;
+	return (double)sorted[rank] / 1000.0;
+}
+
+static u64 kq_bench_rss_kib(void) {
+	FILE *f = fopen("/proc/self/statm", "r");
+	if (!f)
+		return 0;
+	unsigned long long size, resident;
+	const int          n = fscanf(f, "%llu %llu", &size, &resident);
+	fclose(f);
+	if (n != 2)
+		return 0;
+	return (u64)resident * (u64)sysconf(_SC_PAGESIZE) / 1024U;
+}
+
+static bool kq_bench_run(const kq_bench_opts opts[static 1], const kq_scene scene[static 1], u32 count, kq_bench_result res[static 1]) {
+	u64 *cpu = malloc(sizeof(u64[opts->frames]));
+	u64 *gpu = malloc(sizeof(u64[opts->frames]));
+	if (!cpu || !gpu) {
+		KQ_OOM_MSG();
+		free(cpu);
+		free(gpu);
+		return false;
+	}
+
+	if (kq.headless)
+		KQresize(&kq, opts->width, opts->height);
+	kq_scenes_reset(&kq);
+
+	size_t gpu_num = 0;
+	u64    draw_ns = 0;
+	u64    quads = 0;
+	u64    first_measured = 0;
+	for (u32 frame = 0U; frame < opts->warmup + opts->frames; ++frame) {
+		if (!kq.headless) {
+			glfwPollEvents();
+			if (glfwWindowShouldClose(kq.win))
+				goto fail;
+		}
+
+		const bool measured = frame >= opts->warmup;
+		if (!KQrender_begin(&kq))
+			goto fail;
+		if (measured && !first_measured)
+			first_measured = kq.stats.frames + 1U;
+
+		// GPU results lag behind, so take them as they arrive for any frame recorded during measurement.
+		if (first_measured && kq.stats.gpu_frame >= first_measured && gpu_num < opts->frames)
+			gpu[gpu_num++] = kq.stats.gpu_frame_ns;
+
+		const u64 t0 = kqvk_now_ns();
+		if (!scene->draw(&kq, count, frame))
+			goto fail;
+		const u64 t1 = kqvk_now_ns();
+
+		if (!KQrender_end(&kq))
+			goto fail;
+
+		if (measured) {
+			draw_ns += t1 - t0;
+			quads += kq.stats.quads;
+			cpu[frame - opts->warmup] = kq.stats.cpu_frame_ns;
+		}
+	}
+
+	qsort(cpu, opts->frames, sizeof(u64), kq_bench_cmp_u64);
+	qsort(gpu, gpu_num, sizeof(u64), kq_bench_cmp_u64);
+
+	*res = (kq_bench_result){
+		.count = count,
+		.frames = opts->frames,
+		.ns_per_draw = quads ? (double)draw_ns / (double)quads : 0.0,
+		.draw_calls = kq.stats.draw_calls,
+		.quads = kq.stats.quads,
+		.rss_kib = kq_bench_rss_kib(),
+		.device_mem_kib = KQdevice_mem_usage(&kq) / 1024U,
+	};
+	snprintf(res->scene, sizeof res->scene, "%s", scene->name);
+	static const u32 pcts[3] = {50, 90, 99};
+	for (size_t i = 0; i < 3; ++i) {
+		res->cpu_us[i] = kq_bench_percentile_us(opts->frames, cpu, pcts[i]);
+		res->gpu_us[i] = gpu_num ? kq_bench_percentile_us(gpu_num, gpu, pcts[i]) : 0.0;
+	}
+
+	free(cpu);
+	free(gpu);
+	return true;
+
+fail:
+	LOGM_ERROR("Scene %s with count %" PRIu32 " failed at frame %" PRIu64 ".", scene->name, count, kq.stats.frames);
+	free(cpu);
+	free(gpu);
+	return false;
+}
+
+static void kq_bench_write_csv(FILE f[static 1]) {
+	fputs(KQ_BENCH_CSV_HEADER "\n", f);
+	for (size_t i = 0; i < results_num; ++i) {
+		const kq_bench_result *r = &results[i];
+		fprintf(f,
+		        "%s,%" PRIu32 ",%" PRIu32 ",%.2f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%" PRIu32 ",%" PRIu32 ",%" PRIu64 ",%" PRIu64 "\n",
+		        r->scene,
+		        r->count,
+		        r->frames,
+		        r->ns_per_draw,
+		        r->cpu_us[0],
+		        r->cpu_us[1],
+		        r->cpu_us[2],
+		        r->gpu_us[0],
+		        r->gpu_us[1],
+		        r->gpu_us[2],
+		        r->draw_calls,
+		        r->quads,
+		        r->rss_kib,
+		        r->device_mem_kib);
+	}
+}
+
+static void kq_bench_write_json(FILE f[static 1]) {
+	fputs("[", f);
+	for (size_t i = 0; i < results_num; ++i) {
+		const kq_bench_result *r = &results[i];
+		fprintf(f,
+		        "%s\n{\"scene\":\"%s\",\"count\":%" PRIu32 ",\"frames\":%" PRIu32 ",\"ns_per_draw\":%.2f,"
+		        "\"cpu_us\":{\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f},\"gpu_us\":{\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f},"
+		        "\"draw_calls\":%" PRIu32 ",\"quads\":%" PRIu32 ",\"rss_kib\":%" PRIu64 ",\"device_mem_kib\":%" PRIu64 "}",
+		        i ? "," : "",
+		        r->scene,
+		        r->count,
+		        r->frames,
+		        r->ns_per_draw,
+		        r->cpu_us[0],
+		        r->cpu_us[1],
+		        r->cpu_us[2],
+		        r->gpu_us[0],
+		        r->gpu_us[1],
+		        r->gpu_us[2],
+		        r->draw_calls,
+		        r->quads,
+		        r->rss_kib,
+		        r->device_mem_kib);
+	}
+	fputs("\n]\n", f);
+}
+
+static bool kq_bench_regressed(const char what[static 1], const kq_bench_result r[static 1], double cur, double base, double tolerance) {
+	// Zero means unmeasured (no GPU timestamps) on either side.
+	if (cur <= 0.0 || base <= 0.0 || cur <= base * (1.0 + tolerance))
+		return false;
+	fprintf(stderr,
+	        "REGRESSION %s/%" PRIu32 ": %s %.2f vs baseline %.2f (+%.1f%%)\n",
+	        r->scene,
+	        r->count,
+	        what,
+	        cur,
+	        base,
+	        (cur / base - 1.0) * 100.0);
+	return true;
+}
+
+// Returns the number of regressions, or -1 if the baseline could not be read.
+static int kq_bench_compare(const char path[static 1], double tolerance, bool required) {
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		if (required) {
+			LOGM_ERROR("Unable to open baseline \"%s\".", path);
+			return -1;
+		}
+		return 0;
+	}
+
+	int  regressions = 0;
+	char line[512];
+	while (fgets(line, sizeof line, f)) {
+		kq_bench_result b = {0};
+		if (sscanf(line,
+		           "%31[^,],%" SCNu32 ",%" SCNu32 ",%lf,%lf,%lf,%lf,%lf,%lf,%lf",
+		           b.scene,
+		           &b.count,
+		           &b.frames,
+		           &b.ns_per_draw,
+		           &b.cpu_us[0],
+		           &b.cpu_us[1],
+		           &b.cpu_us[2],
+		           &b.gpu_us[0],
+		           &b.gpu_us[1],
+		           &b.gpu_us[2])
+		    != 10)
+			continue; // Header, or a line from an older format.
+
+		for (size_t i = 0; i < results_num; ++i) {
+			const kq_bench_result *r = &results[i];
+			if (strcmp(r->scene, b.scene) || r->count != b.count)
+				continue;
+			regressions += kq_bench_regressed("ns_per_draw", r, r->ns_per_draw, b.ns_per_draw, tolerance);
+			regressions += kq_bench_regressed("cpu_p50_us", r, r->cpu_us[0], b.cpu_us[0], tolerance);
+			regressions += kq_bench_regressed("cpu_p99_us", r, r->cpu_us[2], b.cpu_us[2], tolerance);
+			regressions += kq_bench_regressed("gpu_p50_us", r, r->gpu_us[0], b.gpu_us[0], tolerance);
+		}
+	}
+	fclose(f);
+	return regressions;
+}
+
+int main(int argc, char *argv[]) {
+	setvbuf(stderr, 0, _IOLBF, BUFSIZ);
+	cb_log_init(stderr, CB_LOG_LEVEL_WARN, false, false);
+	cb_log_infer_use_colours();
+
+	kq_bench_opts opts = {
+		.frames = KQ_BENCH_DEFAULT_FRAMES,
+		.warmup = KQ_BENCH_DEFAULT_WARMUP,
+		.tolerance = KQ_BENCH_DEFAULT_TOLERANCE,
+		.width = KQ_HEADLESS_DEFAULT_WIDTH,
+		.height = KQ_HEADLESS_DEFAULT_HEIGHT,
+	};
+	if (!kq_bench_parse_args(argc, argv, &opts)) {
+		kq_bench_usage(stderr);
+		return EXIT_FAILURE;
+	}
+
+	const kq_scene *selected[kq_scenes_count];
+	size_t          selected_num = 0;
+	if (opts.scenes) {
+		char  buf[256];
+		char *save;
+		if ((size_t)snprintf(buf, sizeof buf, "%s", opts.scenes) >= sizeof buf) {
+			LOGM_ERROR("The scene list is longer than %zu characters.", sizeof buf - 1);
+			return EXIT_FAILURE;
+		}
+		for (char *tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(0, ",", &save)) {
+			const kq_scene *s = kq_scene_find(tok);
+			if (!s) {
+				LOGM_ERROR("Unknown scene \"%s\".", tok);
+				return EXIT_FAILURE;
+			}
+			if (selected_num == kq_scenes_count) {
+				LOGM_ERROR("More scenes listed than there are; name each once.");
+				return EXIT_FAILURE;
+			}
+			selected[selected_num++] = s;
+		}
+	} else {
+		for (size_t i = 0; i < kq_scenes_count; ++i)
+			selected[selected_num++] = &kq_scenes[i];
+	}
+	if (selected_num * (opts.counts_num ? opts.counts_num : 1U) > KQ_BENCH_MAX_RESULTS) {
+		LOGM_ERROR("More than %u scene and count pairs to run; select fewer.", KQ_BENCH_MAX_RESULTS);
+		return EXIT_FAILURE;
+	}
+
+	kq.headless = !opts.windowed;
+	kq.headless_width = opts.width;
+	kq.headless_height = opts.height;
+	kq.present_immediate = true;
+	kq.render_passes = opts.render_passes;
+	if (!KQinit(&kq)) {
+		LOGM_FATAL("Unable to initialize the renderer.");
+		return EXIT_FAILURE;
+	}
+
+	bool ok = true;
+	for (size_t s = 0; ok && s < selected_num; ++s) {
+		const u32  default_count = selected[s]->default_count;
+		const u32 *counts = opts.counts_num ? opts.counts : &default_count;
+		const u32  counts_num = opts.counts_num ? opts.counts_num : 1U;
+		for (u32 c = 0U; ok && c < counts_num; ++c) {
+			ok = kq_bench_run(&opts, selected[s], counts[c], &results[results_num]);
+			results_num += ok;
+		}
+	}
+	kq_scenes_release(&kq);
+	KQstop(&kq);
+	if (!ok)
+		return EXIT_FAILURE;
+
+	const char *out_path = opts.write_baseline ? (opts.baseline ? opts.baseline : KQ_BENCH_DEFAULT_BASELINE) : opts.out;
+	FILE       *out = out_path ? fopen(out_path, "w") : stdout;
+	if (!out) {
+		LOGM_ERROR("Unable to open \"%s\" for writing.", out_path);
+		return EXIT_FAILURE;
+	}
+	// The baseline is always CSV, so it can be compared against.
+	if (opts.json && !opts.write_baseline)
+		kq_bench_write_json(out);
+	else
+		kq_bench_write_csv(out);
+	if (out != stdout && fclose(out)) {
+		LOGM_ERROR("Failed writing \"%s\".", out_path);
+		return EXIT_FAILURE;
+	}
+	if (opts.write_baseline)
+		return EXIT_SUCCESS;
+
+	const int regressions = kq_bench_compare(opts.baseline ? opts.baseline : KQ_BENCH_DEFAULT_BASELINE, opts.tolerance, opts.baseline);
+	if (regressions < 0)
+		return EXIT_FAILURE;
+	if (regressions) {
+		fprintf(stderr, "%d regression(s) past %.0f%% tolerance.\n", regressions, opts.tolerance * 100.0);
+		return 2;
+	}
+	return EXIT_SUCCESS;
+}
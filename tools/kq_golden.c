@@ -0,0 +1,327 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <kq.h>
+#include <kq_simd.h>
+#include <kqvk.h>
+#include <libcbase/log.h>
+
+#include "kq_scenes.h"
+
+
+#define CB_LOG_MODULE "GOLDEN"
+
+#define KQ_GOLDEN_WIDTH       320U
+#define KQ_GOLDEN_HEIGHT      240U
+#define KQ_GOLDEN_REF_DIR     "tools/golden"
+#define KQ_GOLDEN_OUT_DIR     "golden_out"
+#define KQ_GOLDEN_DEFAULT_TOL 2U // Per channel, out of 255; absorbs rounding differences between drivers.
+#define KQ_GOLDEN_EXIT_NOREF  77 // Nothing failed, but some cases had no reference to compare against; "skipped" to test drivers.
+#define KQ_GOLDEN_SIMD_COUNT  1027U  // Sprites the kernels are compared over; past the last whole vector, so the tails run too.
+#define KQ_GOLDEN_SIMD_FIRST  3U     // Where they start, so no kernel's loads line up with the arrays.
+#define KQ_GOLDEN_SIMD_TOL    1e-5f  // Kernels may round differently where the compiler fuses the scalar one's multiply-adds.
+
+typedef enum kq_golden_result {
+	KQ_GOLDEN_PASS,
+	KQ_GOLDEN_FAIL,
+	KQ_GOLDEN_NOREF, // Rendered, but there is no reference to compare it against.
+} kq_golden_result;
+
+// A reference scene: what to draw, and which frame of it to capture.
+typedef struct kq_golden_case {
+	const char *scene;
+	u32         count;
+	u32         frames;
+	bool        still; // The captured frame changes nothing under damage tracking, so must draw nothing.
+} kq_golden_case;
+
+static const kq_golden_case kq_golden_cases[] = {
+	{.scene = "quads", .count = 200, .frames = 1},
+	{.scene = "tilemap", .count = 256, .frames = 1},
+	{.scene = "overdraw", .count = 8, .frames = 1},
+	{.scene = "text", .count = 8, .frames = 1},
+	{.scene = "text_zoom", .count = 4, .frames = 31},
+	{.scene = "dialogue", .count = 16, .frames = 40},
+	{.scene = "room", .count = 256, .frames = 3},
+	{.scene = "crt", .count = 256, .frames = 2},
+	{.scene = "bloom", .count = 200, .frames = 2},
+	{.scene = "pixel", .count = 256, .frames = 2},
+	{.scene = "damage", .count = 256, .frames = 3}, // The third frame draws only what moved over the second's.
+	{.scene = "damage_still", .count = 256, .frames = 4, .still = true},
+	{.scene = "sprites", .count = 200, .frames = 3},
+	{.scene = "sprites_cull", .count = 3200, .frames = 3},
+	{.scene = "sprites_dynamic", .count = 800, .frames = 2},
+	{.scene = "camera", .count = 256, .frames = 5},
+	{.scene = "anim", .count = 256, .frames = 2},
+};
+
+
+static kq_data kq = {0};
+
+
+static u32 kq_golden_rand(u32 state[static 1]) {
+	// xorshift32; the state must never be 0.
+	u32 x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+static float kq_golden_randf(u32 state[static 1], float lo, float hi) {
+	return lo + (hi - lo) * (float)(kq_golden_rand(state) >> 8) / (float)(1U << 24);
+}
+
+static bool kq_golden_instance_eq(const kq_tile_instance a[static 1], const kq_tile_instance b[static 1]) {
+	for (size_t i = 0; i < 2; ++i) {
+		if (fabsf(a->position[i] - b->position[i]) > KQ_GOLDEN_SIMD_TOL || fabsf(a->scale[i] - b->scale[i]) > KQ_GOLDEN_SIMD_TOL)
+			return false;
+	}
+	return !memcmp(a->uv_rect, b->uv_rect, sizeof a->uv_rect) && a->color == b->color && a->layer == b->layer && a->flags == b->flags &&
+	       a->anim_start == b->anim_start;
+}
+
+// Runs each sprite kernel the CPU has over the same random sprites, some hidden, free, or off screen, and checks they
+// write what the scalar one does. KQ_SIMD and the host's ISA pick only one of them for the image cases.
+static bool kq_golden_simd(void) {
+	static vec2             positions[KQ_GOLDEN_SIMD_COUNT], scales[KQ_GOLDEN_SIMD_COUNT];
+	static u32              colors[KQ_GOLDEN_SIMD_COUNT], layers[KQ_GOLDEN_SIMD_COUNT], flags[KQ_GOLDEN_SIMD_COUNT];
+	static float            anim_starts[KQ_GOLDEN_SIMD_COUNT];
+	static kq_tile_instance want[KQ_GOLDEN_SIMD_COUNT], got[KQ_GOLDEN_SIMD_COUNT];
+
+	u32 rng = 0x2545F491U;
+	for (u32 i = 0U; i < KQ_GOLDEN_SIMD_COUNT; ++i) {
+		positions[i][0] = kq_golden_randf(&rng, -2.0f, 2.0f);
+		positions[i][1] = kq_golden_randf(&rng, -2.0f, 2.0f);
+		scales[i][0] = kq_golden_randf(&rng, -0.3f, 0.3f); // Negative flips the sprite, and must cull as its extent.
+		scales[i][1] = kq_golden_randf(&rng, -0.3f, 0.3f);
+		colors[i] = kq_golden_rand(&rng);
+		layers[i] = kq_golden_rand(&rng) % 8U;
+		const u32 r = kq_golden_rand(&rng);
+		flags[i] = (r % 8U == 0U ? KQ_SPRITE_HIDDEN : 0U) | (r % 8U == 1U ? KQ_SPRITE_FREE : 0U) | (r & 8U ? KQ_INSTANCE_CLIP(r >> 8 & 7U) : 0U);
+		anim_starts[i] = kq_golden_randf(&rng, 0.0f, 10.0f);
+	}
+	const kq_sprite_store store = {
+		.positions = positions,
+		.scales = scales,
+		.colors = colors,
+		.layers = layers,
+		.flags = flags,
+		.anim_starts = anim_starts,
+		.count = KQ_GOLDEN_SIMD_COUNT,
+	};
+	const kq_sprite_xform xf = {.scale = {0.75f, -1.25f}, .offset = {0.125f, -0.25f}};
+	const u32             count = KQ_GOLDEN_SIMD_COUNT - KQ_GOLDEN_SIMD_FIRST;
+
+	kq_simd_sprites_isa_set("scalar");
+	const u32 want_n = kq_simd_sprites_cull(&store, KQ_GOLDEN_SIMD_FIRST, count, &xf, want);
+
+	bool                     ok = true;
+	static const char *const isas[] = {"sse2", "avx2"};
+	for (size_t k = 0; k < sizeof isas / sizeof isas[0]; ++k) {
+		if (!kq_simd_sprites_isa_set(isas[k])) {
+			printf("SKIP simd_%s: not on this CPU.\n", isas[k]);
+			continue;
+		}
+		const u32 got_n = kq_simd_sprites_cull(&store, KQ_GOLDEN_SIMD_FIRST, count, &xf, got);
+		u32       i = 0U;
+		while (i < want_n && i < got_n && kq_golden_instance_eq(&want[i], &got[i]))
+			++i;
+		if (got_n != want_n || i != want_n) {
+			printf("FAIL simd_%s: wrote %" PRIu32 " sprites to scalar's %" PRIu32 ", differing from %" PRIu32 " on.\n", isas[k], got_n, want_n, i);
+			ok = false;
+			continue;
+		}
+		printf("PASS simd_%s\n", isas[k]);
+	}
+	if (!kq_simd_sprites_isa_set(getenv("KQ_SIMD")))
+		kq_simd_sprites_isa_set(0);
+	return ok;
+}
+
+// Writes a copy of ref with every mismatching pixel in red and the rest dimmed to grey. Returns the mismatch count.
+static size_t kq_golden_diff(size_t   px_count,
+                             const u8 ref[restrict static px_count * 4],
+                             const u8 got[restrict static px_count * 4],
+                             u32      tol,
+                             u8       diff[restrict static px_count * 4]) {
+	size_t bad = 0;
+	for (size_t i = 0; i < px_count * 4; i += 4) {
+		bool mismatch = false;
+		for (size_t c = 0; c < 4; ++c)
+			mismatch |= (u32)abs(ref[i + c] - got[i + c]) > tol;
+
+		if (mismatch) {
+			++bad;
+			diff[i + 0] = 255;
+			diff[i + 1] = 0;
+			diff[i + 2] = 0;
+		} else {
+			const u8 grey = (u8)((ref[i + 0] + ref[i + 1] + ref[i + 2]) / 12);
+			diff[i + 0] = grey;
+			diff[i + 1] = grey;
+			diff[i + 2] = grey;
+		}
+		diff[i + 3] = 255;
+	}
+	return bad;
+}
+
+static bool kq_golden_render(const kq_golden_case c[static 1], const kq_scene scene[static 1]) {
+	KQresize(&kq, KQ_GOLDEN_WIDTH, KQ_GOLDEN_HEIGHT);
+	kq_scenes_reset(&kq);
+	for (u32 frame = 0U; frame < c->frames; ++frame) {
+		if (!KQrender_begin(&kq) || !scene->draw(&kq, c->count, frame) || !KQrender_end(&kq))
+			return false;
+	}
+	return true;
+}
+
+// Returns whether the case matched its reference, or was written to it with update.
+static kq_golden_result kq_golden_run(const kq_golden_case c[static 1], bool update, u32 tol) {
+	const kq_scene *scene = kq_scene_find(c->scene);
+	if (!scene) {
+		LOGM_ERROR("Unknown scene \"%s\".", c->scene);
+		return KQ_GOLDEN_FAIL;
+	}
+	if (!kq_golden_render(c, scene)) {
+		LOGM_ERROR("%s: rendering failed.", c->scene);
+		return KQ_GOLDEN_FAIL;
+	}
+	if (c->still && kq.stats.damage_px) {
+		printf("FAIL %s: a frame without changes drew %" PRIu32 " pixels.\n", c->scene, kq.stats.damage_px);
+		return KQ_GOLDEN_FAIL;
+	}
+
+	char ref_path[256], got_path[256], diff_path[256];
+	snprintf(ref_path, sizeof ref_path, KQ_GOLDEN_REF_DIR "/%s.png", c->scene);
+	snprintf(got_path, sizeof got_path, KQ_GOLDEN_OUT_DIR "/%s.png", c->scene);
+	snprintf(diff_path, sizeof diff_path, KQ_GOLDEN_OUT_DIR "/%s.diff.png", c->scene);
+
+	if (update) {
+		if (!KQframe_save_png(&kq, ref_path))
+			return KQ_GOLDEN_FAIL;
+		printf("UPDATED %s\n", ref_path);
+		return KQ_GOLDEN_PASS;
+	}
+
+	const u32    w = kq.headless_extent.width;
+	const u32    h = kq.headless_extent.height;
+	const size_t px_count = (size_t)w * h;
+	u8          *got = malloc(px_count * 4);
+	u8          *diff = malloc(px_count * 4);
+	if (!got || !diff) {
+		KQ_OOM_MSG();
+		free(got);
+		free(diff);
+		return KQ_GOLDEN_FAIL;
+	}
+
+	kq_golden_result result = KQ_GOLDEN_FAIL;
+	if (!KQframe_read(&kq, px_count * 4, got))
+		goto out;
+
+	struct stat ref_stat;
+	if (stat(ref_path, &ref_stat) && errno == ENOENT) {
+		printf("NOREF %s: nothing to compare against; see %s for what was drawn.\n", c->scene, got_path);
+		kqvk_png_write(got_path, w, h, got);
+		result = KQ_GOLDEN_NOREF;
+		goto out;
+	}
+	stbi_uc *ref = kqvk_tex_load(ref_path, (int)w, (int)h, STBI_rgb_alpha);
+	if (!ref) {
+		printf("FAIL %s: %s is unreadable or not %" PRIu32 "x%" PRIu32 ".\n", c->scene, ref_path, w, h);
+		kqvk_png_write(got_path, w, h, got);
+		goto out;
+	}
+
+	const size_t bad = kq_golden_diff(px_count, ref, got, tol, diff);
+	stbi_image_free(ref);
+	if (bad) {
+		printf("FAIL %s: %zu of %zu pixels differ by more than %" PRIu32 "; see %s\n", c->scene, bad, px_count, tol, diff_path);
+		kqvk_png_write(got_path, w, h, got);
+		kqvk_png_write(diff_path, w, h, diff);
+		goto out;
+	}
+
+	printf("PASS %s\n", c->scene);
+	result = KQ_GOLDEN_PASS;
+out:
+	free(got);
+	free(diff);
+	return result;
+}
+
+int main(int argc, char *argv[]) {
+	setvbuf(stderr, 0, _IOLBF, BUFSIZ);
+	cb_log_init(stderr, CB_LOG_LEVEL_WARN, false, false);
+	cb_log_infer_use_colours();
+
+	bool update = false;
+	u32  tol = KQ_GOLDEN_DEFAULT_TOL;
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--update")) {
+			update = true;
+		} else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc) {
+			char *end;
+			errno = 0;
+			const unsigned long v = strtoul(argv[++i], &end, 10);
+			if (errno || *end || v > 255) {
+				LOGM_ERROR("Bad tolerance \"%s\"; it is per channel, from 0 to 255.", argv[i]);
+				return EXIT_FAILURE;
+			}
+			tol = (u32)v;
+		} else {
+			fputs("Usage: kq_golden [--update] [--tolerance N]\n"
+			      "Renders the reference scenes headlessly and compares them against " KQ_GOLDEN_REF_DIR "/*.png.\n"
+			      "Mismatches are written to " KQ_GOLDEN_OUT_DIR "/, with a diff image marking the differing pixels in red.\n"
+			      "Cases without a reference are reported as NOREF rather than failing; if nothing failed but some were,\n"
+			      "the exit status is 77.\n",
+			      stderr);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (mkdir(update ? KQ_GOLDEN_REF_DIR : KQ_GOLDEN_OUT_DIR, 0755) && errno != EEXIST) {
+		LOGM_ERROR("Unable to create the output directory: %s.", strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	kq.headless = true;
+	kq.headless_width = KQ_GOLDEN_WIDTH;
+	kq.headless_height = KQ_GOLDEN_HEIGHT;
+	kq.headless_time = 0.0;
+	if (!KQinit(&kq)) {
+		LOGM_FATAL("Unable to initialize the renderer.");
+		return EXIT_FAILURE;
+	}
+
+	size_t failed = !kq_golden_simd(), noref = 0;
+	for (size_t i = 0; i < sizeof kq_golden_cases / sizeof kq_golden_cases[0]; ++i) {
+		switch (kq_golden_run(&kq_golden_cases[i], update, tol)) {
+		case KQ_GOLDEN_PASS:
+			break;
+		case KQ_GOLDEN_FAIL:
+			++failed;
+			break;
+		case KQ_GOLDEN_NOREF:
+			++noref;
+			break;
+		}
+	}
+
+	kq_scenes_release(&kq);
+	KQstop(&kq);
+	if (noref)
+		printf("%zu golden image case(s) have no reference in " KQ_GOLDEN_REF_DIR "/ and were not compared.\n", noref);
+	if (failed) {
+		printf("%zu golden image case(s) failed.\n", failed);
+		return EXIT_FAILURE;
+	}
+	return noref ? KQ_GOLDEN_EXIT_NOREF : EXIT_SUCCESS;
+}
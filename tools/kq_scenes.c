@@ -0,0 +1,484 @@
+#include "kq_scenes.h"
+
+#include <string.h>
+#include <tgmath.h>
+
+#include <kq.h>
+
+
+// Window sizes the resize scene cycles through, and how many frames each lasts.
+#define KQ_SCENE_RESIZE_PERIOD 4U
+static const u32 kq_scene_resize_sizes[][2] = {
+	{800, 600},
+	{1280, 720},
+	{640, 480},
+	{1920, 1080},
+	{333, 777},
+};
+
+#define KQ_SCENE_TEXT_PX 16.0f
+static const char *const kq_scene_text_lines[] = {
+	"The quick brown fox jumps over the lazy dog.",
+	"Sphinx of black quartz, judge my vow!",
+	"0123456789 +-*/=<>()[]{} .,:;!?'\"&%$#@",
+	"AV Wa To fi ffl -- kerning and ligatures.",
+};
+
+// Loaded on first use, so scenes that draw no text don't need the font.
+static kq_font kq_scene_font = {0};
+static bool    kq_scene_font_loaded = false;
+static kq_font kq_scene_sdf_font = {0};
+static bool    kq_scene_sdf_font_loaded = false;
+
+// The dialogue scene's box, and how far into the script it has got.
+#define KQ_SCENE_DIALOGUE_MAX_BYTES 2048U
+typedef struct kq_scene_line {
+	bool        speaker;
+	const char *text;
+} kq_scene_line;
+static const kq_scene_line kq_scene_script[] = {
+	{true, "Keeper: "},
+	{false, "The lamp went out an hour before you came. Nobody has climbed the stairs since, and the fog is coming in.\n"},
+	{true, "You: "},
+	{false, "Then we light it again. Where is the oil kept?\n"},
+	{true, "Keeper: "},
+	{false, "Below, past the old nets and the crates nobody opened. Mind the seventh step; it has been loose for years.\n"},
+};
+static kq_text_box kq_scene_box = {0};
+static bool        kq_scene_box_created = false;
+static u32         kq_scene_box_styles[2];
+static u32         kq_scene_script_line = 0;
+static u32         kq_scene_script_offset = 0;
+
+// The room scene's background, rendered once for the count and viewport it was made for.
+static kq_render_target kq_scene_room_target = {0};
+static bool             kq_scene_room_created = false;
+static u32              kq_scene_room_count = 0;
+
+// The sprite scenes' store, made for the count and layout it holds. Every KQ_SCENE_SPRITES_MOVER_EVERY-th sprite moves.
+#define KQ_SCENE_SPRITES_MOVER_EVERY 20U
+static kq_sprite_store kq_scene_sprite_store = {0};
+static bool            kq_scene_sprite_store_created = false;
+static u32             kq_scene_sprite_store_count = 0;
+static bool            kq_scene_sprite_store_grid = false;
+
+
+static inline u32 kq_scene_rand(u32 state[static 1]) {
+	// xorshift32; the state must never be 0.
+	u32 x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+static inline float kq_scene_randf(u32 state[static 1], float lo, float hi) {
+	return lo + (hi - lo) * (float)(kq_scene_rand(state) >> 8) / (float)(1U << 24);
+}
+
+// Sprites of random size at random positions, each sampling a random texture layer.
+static bool kq_scene_quads(kq_data kq[static 1], u32 count, u64 frame) {
+	CB_UNUSED(frame);
+	u32 rng = 0x9E3779B9U;
+	for (u32 i = 0U; i < count; ++i) {
+		const float s = kq_scene_randf(&rng, 0.02f, 0.2f);
+		const vec2  pos = {kq_scene_randf(&rng, -1.0f, 1.0f), kq_scene_randf(&rng, -1.0f, 1.0f)};
+		if (!KQdraw_quad(kq, pos, (vec2){s, s}, kq_scene_rand(&rng) % KQ_TILES_IMAGE_COUNT))
+			return false;
+	}
+	return true;
+}
+
+// A screen-filling grid of about count tiles, without gaps or overlap.
+static bool kq_scene_tilemap(kq_data kq[static 1], u32 count, u64 frame) {
+	CB_UNUSED(frame);
+	const u32   side = (u32)ceil(sqrt((double)count));
+	const float cell = 2.0f / (float)side;
+	for (u32 y = 0U; y < side; ++y) {
+		for (u32 x = 0U; x < side; ++x) {
+			const vec2 pos = {-1.0f + cell * ((float)x + 0.5f), -1.0f + cell * ((float)y + 0.5f)};
+			if (!KQdraw_quad(kq, pos, (vec2){cell, cell}, (x * 7U + y * 13U) % KQ_TILES_IMAGE_COUNT))
+				return false;
+		}
+	}
+	return true;
+}
+
+// count full-screen quads stacked on top of each other; fill rate bound.
+static bool kq_scene_overdraw(kq_data kq[static 1], u32 count, u64 frame) {
+	CB_UNUSED(frame);
+	for (u32 i = 0U; i < count; ++i) {
+		if (!KQdraw_quad(kq, (vec2){0.0f, 0.0f}, (vec2){2.0f, 2.0f}, i % KQ_TILES_IMAGE_COUNT))
+			return false;
+	}
+	return true;
+}
+
+// The quads scene, with the framebuffer changing size every few frames.
+static bool kq_scene_resize(kq_data kq[static 1], u32 count, u64 frame) {
+	if (frame % KQ_SCENE_RESIZE_PERIOD == 0) {
+		const size_t n = sizeof kq_scene_resize_sizes / sizeof kq_scene_resize_sizes[0];
+		const u32   *size = kq_scene_resize_sizes[(frame / KQ_SCENE_RESIZE_PERIOD) % n];
+		if (kq->headless)
+			KQresize(kq, size[0], size[1]);
+		else
+			glfwSetWindowSize(kq->win, (int)size[0], (int)size[1]);
+	}
+	return kq_scene_quads(kq, count, frame);
+}
+
+// count lines of text, top to bottom, wrapping back to the top once they leave the screen.
+static bool kq_scene_text(kq_data kq[static 1], u32 count, u64 frame) {
+	CB_UNUSED(frame);
+	if (!kq_scene_font_loaded) {
+		if (!KQfont_load(kq, &kq_scene_font, KQTXT_FONT, KQ_SCENE_TEXT_PX))
+			return false;
+		kq_scene_font_loaded = true;
+	}
+
+	const float  line = 2.0f * KQ_SCENE_TEXT_PX * 1.25f / kq->viewport.height;
+	const u32    rows = (u32)(2.0f / line);
+	const size_t n = sizeof kq_scene_text_lines / sizeof kq_scene_text_lines[0];
+	for (u32 i = 0U; i < count; ++i) {
+		const vec2 pos = {-0.98f, -1.0f + line * (float)(i % rows + 1U)};
+		if (!KQdraw_text(kq, &kq_scene_font, kq_scene_text_lines[i % n], pos, KQ_RGBA(255, 255, 255, 255)))
+			return false;
+	}
+	return true;
+}
+
+// count lines of SDF text, zooming between 8 and 64 px; after the first frame nothing is rasterised.
+static bool kq_scene_text_zoom(kq_data kq[static 1], u32 count, u64 frame) {
+	if (!kq_scene_sdf_font_loaded) {
+		if (!KQfont_load_sdf(kq, &kq_scene_sdf_font, KQTXT_FONT, KQ_SCENE_TEXT_PX))
+			return false;
+		kq_scene_sdf_font_loaded = true;
+	}
+
+	const float px = 8.0f + 56.0f * (0.5f - 0.5f * cos((float)(frame % 120U) * (2.0f * (float)M_PI / 120.0f)));
+	if (!KQfont_set_size(&kq_scene_sdf_font, px))
+		return false;
+
+	const float  line = 2.0f * px * 1.25f / kq->viewport.height;
+	const u32    rows = line < 2.0f ? (u32)(2.0f / line) : 1U;
+	const size_t n = sizeof kq_scene_text_lines / sizeof kq_scene_text_lines[0];
+	for (u32 i = 0U; i < count; ++i) {
+		const vec2 pos = {-0.98f, -1.0f + line * (float)(i % rows + 1U)};
+		if (!KQdraw_text(kq, &kq_scene_sdf_font, kq_scene_text_lines[i % n], pos, KQ_RGBA(255, 255, 255, 255)))
+			return false;
+	}
+	return true;
+}
+
+// Dialogue streaming into a wrapped text box, count bytes a frame, with a backspace now and then. Only the last line or
+// two are laid out each frame.
+static bool kq_scene_dialogue(kq_data kq[static 1], u32 count, u64 frame) {
+	if (!kq_scene_font_loaded) {
+		if (!KQfont_load(kq, &kq_scene_font, KQTXT_FONT, KQ_SCENE_TEXT_PX))
+			return false;
+		kq_scene_font_loaded = true;
+	}
+	if (!kq_scene_box_created) {
+		if (!KQtext_box_create(&kq_scene_box, (vec2){16.0f, 16.0f}, kq->viewport.width - 32.0f, KQ_SCENE_TEXT_PX * 1.25f, KQ_TEXT_ALIGN_LEFT))
+			return false;
+		kq_scene_box_created = true;
+		if (!KQtext_box_add_style(&kq_scene_box, &kq_scene_font, KQ_RGBA(255, 220, 96, 255), &kq_scene_box_styles[true])
+		    || !KQtext_box_add_style(&kq_scene_box, &kq_scene_font, KQ_RGBA(255, 255, 255, 255), &kq_scene_box_styles[false]))
+			return false;
+	}
+
+	// Start over on the first frame, so the scene still only depends on (count, frame).
+	if (!frame || kq_scene_box.text->size >= KQ_SCENE_DIALOGUE_MAX_BYTES) {
+		if (!KQtext_box_erase(&kq_scene_box, 0, (u32)kq_scene_box.text->size))
+			return false;
+		kq_scene_script_line = 0;
+		kq_scene_script_offset = 0;
+	}
+
+	if (frame % 37U == 36U && kq_scene_box.text->size && !KQtext_box_erase(&kq_scene_box, (u32)kq_scene_box.text->size - 1, 1))
+		return false;
+
+	const size_t lines = sizeof kq_scene_script / sizeof kq_scene_script[0];
+	for (u32 left = count; left;) {
+		const kq_scene_line *line = &kq_scene_script[kq_scene_script_line];
+		const u32            rest = (u32)strlen(line->text) - kq_scene_script_offset;
+		const u32            n = rest < left ? rest : left;
+
+		char chunk[64];
+		const u32 m = n < sizeof chunk - 1 ? n : (u32)sizeof chunk - 1;
+		memcpy(chunk, line->text + kq_scene_script_offset, m);
+		chunk[m] = '\0';
+		if (!KQtext_box_append(&kq_scene_box, chunk, kq_scene_box_styles[line->speaker]))
+			return false;
+
+		left -= m;
+		kq_scene_script_offset += m;
+		if (kq_scene_script_offset == strlen(line->text)) {
+			kq_scene_script_line = (u32)((kq_scene_script_line + 1) % lines);
+			kq_scene_script_offset = 0;
+		}
+	}
+
+	return KQtext_box_draw(kq, &kq_scene_box);
+}
+
+// A static background of count layered tiles and decals, rendered into a target once and drawn as one sprite every frame,
+// with a few sprites moving over it.
+static bool kq_scene_room(kq_data kq[static 1], u32 count, u64 frame) {
+	const u32 w = (u32)kq->viewport.width, h = (u32)kq->viewport.height;
+	if (kq_scene_room_created && (kq_scene_room_target.width != w || kq_scene_room_target.height != h)) {
+		KQtarget_destroy(kq, &kq_scene_room_target);
+		kq_scene_room_created = false;
+	}
+	if (!kq_scene_room_created) {
+		if (!KQtarget_create(kq, &kq_scene_room_target, w, h))
+			return false;
+		kq_scene_room_created = true;
+	}
+	if (kq_scene_room_count != count)
+		KQtarget_invalidate(&kq_scene_room_target);
+
+	if (!kq_scene_room_target.valid) {
+		if (!KQtarget_begin(kq, &kq_scene_room_target) || !kq_scene_tilemap(kq, count, 0) || !kq_scene_quads(kq, count / 4U, 0) || !KQtarget_end(kq))
+			return false;
+		kq_scene_room_count = count;
+	}
+
+	if (!KQdraw_target(kq, &kq_scene_room_target, (vec2){0.0f, 0.0f}, (vec2){1.0f, 1.0f}, KQ_RGBA(255, 255, 255, 255)))
+		return false;
+	for (u32 i = 0U; i < 4U; ++i) {
+		const float t = (float)frame * 0.05f + (float)i * 1.5f;
+		if (!KQdraw_quad(kq, (vec2){0.6f * cos(t), 0.6f * sin(t)}, (vec2){0.1f, 0.1f}, i % KQ_TILES_IMAGE_COUNT))
+			return false;
+	}
+	return true;
+}
+
+// The tilemap scene through a CRT look: graded, with scanlines and a vignette. The chain is one pass whatever count is.
+static bool kq_scene_crt(kq_data kq[static 1], u32 count, u64 frame) {
+	static const kq_post_step chain[] = {
+		{.effect = KQ_POST_GRADE, .params = {0.7f, 1.15f, 1.1f}},
+		{.effect = KQ_POST_SCANLINES, .params = {0.35f, 2.0f}},
+		{.effect = KQ_POST_VIGNETTE, .params = {0.6f, 0.45f, 0.55f}},
+	};
+	if (!KQpost_set(kq, sizeof chain / sizeof chain[0], chain))
+		return false;
+	return kq_scene_tilemap(kq, count, frame);
+}
+
+// The quads scene blooming, and on odd frames also blurred behind a menu panel; the blur runs at a fraction of the
+// resolution, in compute.
+static bool kq_scene_bloom(kq_data kq[static 1], u32 count, u64 frame) {
+	const kq_post_step bloom[] = {
+		{.effect = KQ_POST_BLOOM, .params = {0.8f, 12.0f, 0.5f}},
+		{.effect = KQ_POST_VIGNETTE, .params = {0.4f, 0.6f, 0.4f}},
+	};
+	const kq_post_step menu[] = {
+		{.effect = KQ_POST_BLUR, .params = {1.0f, 16.0f}},
+		{.effect = KQ_POST_GRADE, .params = {0.5f, 0.9f, 0.7f}},
+	};
+	if (!(frame % 2U ? KQpost_set(kq, sizeof menu / sizeof menu[0], menu) : KQpost_set(kq, sizeof bloom / sizeof bloom[0], bloom)))
+		return false;
+	return kq_scene_quads(kq, count, frame);
+}
+
+// The tilemap scene drawn at 160 x 100 and scaled up by whole multiples, as pixel art would be.
+static bool kq_scene_pixel(kq_data kq[static 1], u32 count, u64 frame) {
+	if (!KQinternal_res_set(kq, 160U, 100U, KQ_SCALE_NEAREST))
+		return false;
+	return kq_scene_tilemap(kq, count, frame);
+}
+
+// The overdraw scene with its resolution lowered while the GPU takes longer than 2 ms a frame. The only scene whose
+// draws depend on the GPU, so it is for benchmarks, not references. Without GPU timestamps it runs at full resolution.
+static bool kq_scene_dynres(kq_data kq[static 1], u32 count, u64 frame) {
+	if (!kq->internal_budget_ns && kq->timestamp_pool) {
+		KQinternal_res_set(kq, 0U, 0U, KQ_SCALE_SHARP_BILINEAR);
+		KQinternal_res_budget(kq, 2000000U, 0.25f);
+	}
+	return kq_scene_overdraw(kq, count, frame);
+}
+
+// The tilemap scene with a sprite crossing it, under damage tracking, so only the cells around the sprite are drawn again.
+static bool kq_scene_damage(kq_data kq[static 1], u32 count, u64 frame) {
+	KQdamage_tracking_set(kq, true);
+	if (!kq_scene_tilemap(kq, count, frame))
+		return false;
+	const vec2 pos = {-0.9f + 0.05f * (float)(frame % 37U), 0.2f};
+	return KQdraw_quad(kq, pos, (vec2){0.1f, 0.1f}, 1U);
+}
+
+// The damage scene with its sprite stopping at the third frame, so from the fourth on nothing changes and nothing is drawn.
+static bool kq_scene_damage_still(kq_data kq[static 1], u32 count, u64 frame) {
+	return kq_scene_damage(kq, count, frame < 2U ? frame : 2U);
+}
+
+// Fills the sprite store with count sprites spread over [-spread, spread], indexed in a grid if asked for, unless it
+// already holds just those.
+static bool kq_scene_sprite_store_fill(kq_data kq[static 1], u32 count, float spread, bool grid) {
+	if (kq_scene_sprite_store_created && (kq_scene_sprite_store_count != count || kq_scene_sprite_store_grid != grid)) {
+		KQsprites_destroy(kq, &kq_scene_sprite_store);
+		kq_scene_sprite_store_created = false;
+	}
+	if (!kq_scene_sprite_store_created) {
+		if (!KQsprites_create(&kq_scene_sprite_store))
+			return false;
+		kq_scene_sprite_store_created = true;
+		kq_scene_sprite_store_count = count;
+		kq_scene_sprite_store_grid = grid;
+		if (grid && !KQsprites_grid_enable(&kq_scene_sprite_store, 0.25f))
+			return false;
+
+		u32 rng = 0x9E3779B9U;
+		for (u32 i = 0U; i < count; ++i) {
+			const float s = kq_scene_randf(&rng, 0.02f, 0.2f);
+			const vec2  pos = {kq_scene_randf(&rng, -spread, spread), kq_scene_randf(&rng, -spread, spread)};
+			u32         handle;
+			if (!KQsprite_add(&kq_scene_sprite_store, pos, (vec2){s, s}, kq_scene_rand(&rng) % KQ_TILES_IMAGE_COUNT, &handle))
+				return false;
+		}
+	}
+	return true;
+}
+
+// Movers circle a point of their own within [-spread, spread], so where they are depends on the frame alone.
+static void kq_scene_sprite_store_move(u32 count, u64 frame, float spread) {
+	for (u32 i = 0U; i < count; i += KQ_SCENE_SPRITES_MOVER_EVERY) {
+		const float a = 0.2f * (float)frame + (float)i;
+		const float c = spread * (-0.8f + 1.6f * (float)(i * 2654435761U >> 16 & 0xFFFFU) / 65535.0f);
+		KQsprite_move(&kq_scene_sprite_store, i, (vec2){c + 0.1f * cos(a), -c + 0.1f * sin(a)});
+	}
+}
+
+// The quads scene kept in a retained sprite store, with one sprite in 20 moving; only the blocks holding those are
+// uploaded again each frame.
+static bool kq_scene_sprites(kq_data kq[static 1], u32 count, u64 frame) {
+	if (!kq_scene_sprite_store_fill(kq, count, 1.0f, false))
+		return false;
+	kq_scene_sprite_store_move(count, frame, 1.0f);
+	return KQsprites_draw(kq, &kq_scene_sprite_store);
+}
+
+// The sprites scene spread over 16 times the viewport and indexed in a grid, so draws cull most of it, with the sprite
+// under a wandering cursor outlined as a hover would be.
+static bool kq_scene_sprites_cull(kq_data kq[static 1], u32 count, u64 frame) {
+	if (!kq_scene_sprite_store_fill(kq, count, 4.0f, true))
+		return false;
+	kq_scene_sprite_store_move(count, frame, 4.0f);
+	if (!KQsprites_draw(kq, &kq_scene_sprite_store))
+		return false;
+
+	const vec2 cursor = {0.6f * sin(0.05f * (float)frame), 0.6f * cos(0.07f * (float)frame)};
+	const u32  hover = KQsprites_query_point(&kq_scene_sprite_store, cursor);
+	if (hover == KQ_SPRITE_NONE)
+		return true;
+	const float *pos = kq_scene_sprite_store.positions[hover];
+	const float *scale = kq_scene_sprite_store.scales[hover];
+	return KQdraw_quad(kq, pos, (vec2){scale[0] * 1.1f, scale[1] * 1.1f}, 0U);
+}
+
+// The sprites scene over four times the viewport, every sprite transformed by a panning camera and culled by the SIMD
+// kernels each frame rather than uploaded.
+static bool kq_scene_sprites_dynamic(kq_data kq[static 1], u32 count, u64 frame) {
+	if (!kq_scene_sprite_store_fill(kq, count, 2.0f, false))
+		return false;
+	const float           t = 0.03f * (float)frame;
+	const kq_sprite_xform xf = {.scale = {0.75f, 0.75f}, .offset = {sin(t), 0.5f * cos(t)}};
+	return KQsprites_draw_transformed(kq, &kq_scene_sprite_store, &xf);
+}
+
+// The tilemap scene as a world under a camera that pans, zooms and turns, snapped to pixels; the tiles are never touched.
+static bool kq_scene_camera(kq_data kq[static 1], u32 count, u64 frame) {
+	const float     t = 0.05f * (float)frame;
+	const kq_camera camera = {.pos = {0.3f * sin(t), 0.2f * cos(t)}, .zoom = 1.5f + 0.25f * sin(0.7f * t), .rotation = 0.1f * t, .snap = true};
+	KQcamera_set(kq, &camera);
+	return kq_scene_tilemap(kq, count, frame);
+}
+
+// The tilemap scene with every tile animated by the GPU: stepping through the texture layers, swaying across the texture,
+// or flaring up once. The draws are the same every frame, each tile's phase set by its start time; only the frame's time
+// moves the animations, so under kq_golden's fixed time the phases alone pick the frames shown.
+static bool kq_scene_anim(kq_data kq[static 1], u32 count, u64 frame) {
+	CB_UNUSED(frame);
+	static const kq_anim_clip clips[] = {
+		{.layer_step = 1U, .frames = KQ_TILES_IMAGE_COUNT, .fps = 4.0f, .mode = KQ_ANIM_LOOP},
+		{.uv_step = {0.25f, 0.0f}, .frames = 4U, .fps = 6.0f, .mode = KQ_ANIM_PINGPONG},
+		{.layer_step = 1U, .frames = KQ_TILES_IMAGE_COUNT, .fps = 2.0f, .mode = KQ_ANIM_ONCE},
+	};
+	const u32 clips_count = sizeof clips / sizeof clips[0];
+	for (u32 c = 0U; c < clips_count; ++c) {
+		if (!KQanim_clip_set(kq, c, &clips[c]))
+			return false;
+	}
+
+	const u32   side = (u32)ceil(sqrt((double)count));
+	const float cell = 2.0f / (float)side;
+	for (u32 y = 0U; y < side; ++y) {
+		for (u32 x = 0U; x < side; ++x) {
+			const vec2  pos = {-1.0f + cell * ((float)x + 0.5f), -1.0f + cell * ((float)y + 0.5f)};
+			const u32   clip = (x * 7U + y * 13U) % clips_count;
+			const u32   layer = clips[clip].layer_step ? 0U : (x + y) % KQ_TILES_IMAGE_COUNT; // Stepping layers start at 0.
+			const float start = -0.125f * (float)((x * 5U + y * 3U) % 16U);
+			if (!KQdraw_quad_animated(kq, pos, (vec2){cell, cell}, layer, clip, start))
+				return false;
+		}
+	}
+	return true;
+}
+
+const kq_scene kq_scenes[] = {
+	{.name = "quads", .draw = kq_scene_quads, .default_count = 1000},
+	{.name = "tilemap", .draw = kq_scene_tilemap, .default_count = 4096},
+	{.name = "overdraw", .draw = kq_scene_overdraw, .default_count = 64},
+	{.name = "resize", .draw = kq_scene_resize, .default_count = 1000},
+	{.name = "text", .draw = kq_scene_text, .default_count = 64},
+	{.name = "text_zoom", .draw = kq_scene_text_zoom, .default_count = 16},
+	{.name = "dialogue", .draw = kq_scene_dialogue, .default_count = 4},
+	{.name = "room", .draw = kq_scene_room, .default_count = 4096},
+	{.name = "crt", .draw = kq_scene_crt, .default_count = 4096},
+	{.name = "bloom", .draw = kq_scene_bloom, .default_count = 1000},
+	{.name = "pixel", .draw = kq_scene_pixel, .default_count = 4096},
+	{.name = "dynres", .draw = kq_scene_dynres, .default_count = 64},
+	{.name = "damage", .draw = kq_scene_damage, .default_count = 4096},
+	{.name = "damage_still", .draw = kq_scene_damage_still, .default_count = 4096},
+	{.name = "sprites", .draw = kq_scene_sprites, .default_count = 20000},
+	{.name = "sprites_cull", .draw = kq_scene_sprites_cull, .default_count = 100000},
+	{.name = "sprites_dynamic", .draw = kq_scene_sprites_dynamic, .default_count = 100000},
+	{.name = "camera", .draw = kq_scene_camera, .default_count = 4096},
+	{.name = "anim", .draw = kq_scene_anim, .default_count = 4096},
+};
+const size_t kq_scenes_count = sizeof kq_scenes / sizeof kq_scenes[0];
+
+const kq_scene *kq_scene_find(const char name[static 1]) {
+	for (size_t i = 0; i < kq_scenes_count; ++i) {
+		if (!strcmp(kq_scenes[i].name, name))
+			return &kq_scenes[i];
+	}
+	return 0;
+}
+
+void kq_scenes_reset(kq_data kq[static 1]) {
+	KQpost_set(kq, 0, 0);
+	KQinternal_res_set(kq, 0U, 0U, KQ_SCALE_NEAREST);
+	KQinternal_res_budget(kq, 0U, 1.0f);
+	KQdamage_tracking_set(kq, false);
+	KQcamera_set(kq, &(kq_camera){.zoom = 1.0f});
+}
+
+void kq_scenes_release(kq_data kq[static 1]) {
+	if (kq_scene_room_created)
+		KQtarget_destroy(kq, &kq_scene_room_target);
+	kq_scene_room_created = false;
+	if (kq_scene_sprite_store_created)
+		KQsprites_destroy(kq, &kq_scene_sprite_store);
+	kq_scene_sprite_store_created = false;
+	if (kq_scene_box_created)
+		KQtext_box_destroy(kq, &kq_scene_box);
+	kq_scene_box_created = false;
+	if (kq_scene_font_loaded)
+		KQfont_destroy(&kq_scene_font);
+	if (kq_scene_sdf_font_loaded)
+		KQfont_destroy(&kq_scene_sdf_font);
+	kq_scene_font_loaded = false;
+	kq_scene_sdf_font_loaded = false;
+}
@@ -0,0 +1,33 @@
+#ifndef KQ_SCENES_H_
+#define KQ_SCENES_H_
+
+#include <stdbool.h>
+
+#include <kq.h>
+#include <libcbase/common.h>
+
+// Scripted scenes shared by kq_bench and kq_golden. Every scene but dynres is a pure function of (count, frame), so the
+// same arguments always record the same draws. Scenes that set a post chain, internal resolution or damage tracking set
+// it every frame, so it applies from their second frame on; kq_scenes_reset() clears it before the next scene runs.
+
+typedef bool kq_scene_draw_fn(kq_data kq[static 1], u32 count, u64 frame);
+
+typedef struct kq_scene {
+	const char       *name;
+	kq_scene_draw_fn *draw;
+	u32               default_count;
+} kq_scene;
+
+extern const kq_scene kq_scenes[];
+extern const size_t   kq_scenes_count;
+
+extern const kq_scene *kq_scene_find(const char name[static 1]);
+
+// Undoes renderer state a scene may have left set, such as a post chain, damage tracking or the camera. Call before
+// running a scene.
+extern void kq_scenes_reset(kq_data kq[static 1]);
+
+// Frees what scenes loaded lazily, such as fonts. Call before KQstop().
+extern void kq_scenes_release(kq_data kq[static 1]);
+
+#endif /* KQ_SCENES_H_ */